@@ -1,5 +1,6 @@
 ﻿# include <Siv3D.hpp> // OpenSiv3D v0.6.4
 # include "Multiplayer_Photon.hpp"
+# include "NetworkProfilerOverlay.hpp"
 # include "PHOTON_APP_ID.SECRET"
 
 // ユーザ定義型
@@ -10,10 +11,26 @@ struct MyData
 	Point pos;
 
 	// シリアライズに対応させるためのメンバ関数を定義する
+	// sendPackedEvent() では、pos の各成分は範囲に必要な 13 ビットで送信される
 	template <class Archive>
 	void SIV3D_SERIALIZE(Archive& archive)
 	{
-		archive(word, pos);
+		archive(word, Packed::Range<-4096, 4095>(pos));
+	}
+};
+
+// 大きな配列を送るユーザ定義型
+struct ParticleData
+{
+	Array<Vec2> positions;
+
+	Array<double> scales;
+
+	// PackedWriter では、positions の各成分は 2 バイトの固定小数点数（0～4095.9375 を 1/16 刻みの 65,536 段階）、scales は半精度浮動小数点数で書き込まれる
+	template <class Archive>
+	void SIV3D_SERIALIZE(Archive& archive)
+	{
+		archive(Packed::Quantize<0.0, 4095.9375, 0.0625>(positions), Packed::Half(scales));
 	}
 };
 
@@ -27,6 +44,8 @@ namespace EventCode {
 		CustomDataTest3,
 		CustomDataTest4,
 		FallbackTest,
+		PackedDataTest,
+		PackedArrayTest,
 	};
 }
 
@@ -38,6 +57,21 @@ public:
 	{
 		init(std::string(SIV3D_OBFUSCATE(PHOTON_APP_ID)), U"1.0", Console, Verbose::Yes, ConnectionProtocol::Default);
 
+		setRegionCache(U"photon_region_cache.json");
+
+		enableAutoReconnect();
+
+		// 大量に受信しても描画が止まらないように、1 フレームに処理するイベントの時間を制限する
+		enableReceiveQueue(1024, 2ms);
+		setReceivePolicy(EventCode::IntEvent, ReceivePolicy::KeepLatest);
+
+		// 後から参加したプレイヤーには、ホストがルームの状態をまとめて送る
+		enableJoinSnapshot();
+
+		// 送信量を制限し、プライオリティインデックス 0 のイベントを優先する
+		enableSendScheduler(64 * 1024);
+		setSendChannelWeight(0, 4.0);
+
 		RegisterEventCallback(EventCode::IntEvent, &MyNetwork::onIntEvent);
 		RegisterEventCallback(EventCode::StringEvent, &MyNetwork::onStringEvent);
 		RegisterEventCallback(EventCode::StringEvent2, &MyNetwork::onStringEvent2);
@@ -45,6 +79,8 @@ public:
 		RegisterEventCallback(EventCode::CustomDataTest2, &MyNetwork::onCustomDataTest2);
 		RegisterEventCallback(EventCode::CustomDataTest3, &MyNetwork::onCustomDataTest3);
 		RegisterEventCallback(EventCode::CustomDataTest4, &MyNetwork::onCustomDataTest4);
+		RegisterPackedEventCallback(EventCode::PackedDataTest, &MyNetwork::onPackedDataTest);
+		RegisterPackedEventCallback(EventCode::PackedArrayTest, &MyNetwork::onPackedArrayTest);
 	}
 
 	Optional<LocalPlayer> getLocalPlayerByName(StringView userName) const
@@ -92,12 +128,78 @@ private:
 		debugLog(U"<<< CustomDataTest4 を受信: {}"_fmt(a));
 	}
 
+	void onPackedDataTest([[maybe_unused]] LocalPlayerID sender, MyData data, bool flag) {
+		debugLog(U"<<< PackedDataTest を受信: {}, {}, {}"_fmt(data.word, data.pos, flag));
+	}
+
+	void onPackedArrayTest([[maybe_unused]] LocalPlayerID sender, const ParticleData& data) {
+		debugLog(U"<<< PackedArrayTest を受信: {} particles"_fmt(data.positions.size()));
+	}
+
 	// シリアライズデータを受信したときに呼ばれる関数をオーバーライドしてカスタマイズする
 	void customEventAction([[maybe_unused]] const LocalPlayerID playerID, const uint8 eventCode, [[maybe_unused]] Deserializer<MemoryViewReader>& reader) override
 	{
 		debugLog(U"<<< {} を受信"_fmt(eventCode));
 	}
 
+	void onConnectionDegraded(const ConnectionQualityStats& stats) override
+	{
+		debugLog(U"onConnectionDegraded: rtt p90 {}ms"_fmt(stats.roundTripP90Millisec));
+	}
+
+	void onConnectionRecovered(const ConnectionQualityStats& stats) override
+	{
+		debugLog(U"onConnectionRecovered: rtt p90 {}ms"_fmt(stats.roundTripP90Millisec));
+	}
+
+	void onReconnecting(const int32 attempt, const Milliseconds delay) override
+	{
+		debugLog(U"onReconnecting: attempt {} in {}ms"_fmt(attempt, delay.count()));
+	}
+
+	void onReconnected() override
+	{
+		debugLog(U"onReconnected");
+	}
+
+	void onReconnectFailed() override
+	{
+		debugLog(U"onReconnectFailed");
+	}
+
+	void onRoomListResponse(const Array<RoomInfo>& rooms) override
+	{
+		debugLog(U"onRoomListResponse: {} rooms"_fmt(rooms.size()));
+		for (const auto& room : rooms)
+		{
+			debugLog(U"- {} ({} / {}), level: {}"_fmt(room.name, room.playerCount, room.maxPlayers, room.filterProperties.contains(0) ? room.filterProperties.at(0) : 0));
+		}
+	}
+
+	void onStreamProgress(const StreamProgress& progress) override
+	{
+		debugLog(U"onStreamProgress: {} #{} {} / {} bytes"_fmt((progress.sending ? U"send" : U"receive"), progress.streamID, progress.transferredBytes, progress.totalBytes));
+	}
+
+	void onStreamFailed(const StreamProgress& progress) override
+	{
+		debugLog(U"onStreamFailed: #{} (player {})"_fmt(progress.streamID, progress.playerID));
+	}
+
+	void writeJoinSnapshot(const Array<LocalPlayerID>& newPlayerIDs, Serializer<MemoryWriter>& writer) override
+	{
+		writer(getCurrentRoomName(), static_cast<uint64>(getLocalPlayers().size()));
+		debugLog(U"writeJoinSnapshot: {}"_fmt(newPlayerIDs));
+	}
+
+	void applyJoinSnapshot(const LocalPlayerID hostPlayerID, Deserializer<MemoryViewReader>& reader) override
+	{
+		String roomName;
+		uint64 numPlayers = 0;
+		reader(roomName, numPlayers);
+		debugLog(U"applyJoinSnapshot: from {}, room: {}, players: {}"_fmt(hostPlayerID, roomName, numPlayers));
+	}
+
 	void onRoomListUpdate() override
 	{
 		debugLog(U"onRoomListUpdate:");
@@ -121,6 +223,10 @@ void Main()
 
 	MyNetwork network{};
 
+	NetworkProfilerOverlay profiler{};
+
+	bool showProfiler = false;
+
 	TextEditState text{};
 
 	Font font{ 20 };
@@ -136,6 +242,7 @@ void Main()
 	{
 		network.update();
 
+		profiler.update(network);
 
 		int x = initX;
 		int y = initY;
@@ -143,11 +250,18 @@ void Main()
 		SimpleGUI::TextBox(text, { x, y }, ButtonWidth);
 
 # if not SIV3D_PLATFORM(WEB)
-		font(U"bytesIn: {}"_fmt(
-			network.getBytesIn()
+		font(U"in: {:.1f} KB/s ({:.0f} pkt/s)"_fmt(
+			network.getTrafficRates().last1s.bytesInPerSec / 1024.0,
+			network.getTrafficRates().last1s.packetsInPerSec
+		)).drawAt(Rect{ x += offsetX, y, ButtonWidth, 40 }.center());
+
+		font(U"out: {:.1f} KB/s ({:.0f} pkt/s)"_fmt(
+			network.getTrafficRates().last1s.bytesOutPerSec / 1024.0,
+			network.getTrafficRates().last1s.packetsOutPerSec
 		)).drawAt(Rect{ x += offsetX, y, ButtonWidth, 40 }.center());
 
-		font(U"bytesOut: {}"_fmt(
+		font(U"total: {} / {} bytes"_fmt(
+			network.getBytesIn(),
 			network.getBytesOut()
 		)).drawAt(Rect{ x += offsetX, y, ButtonWidth, 40 }.center());
 # endif
@@ -174,7 +288,7 @@ void Main()
 
 		if (SimpleGUI::Button(U"reconnect", { x = initX, y += offsetY }, ButtonWidth))
 		{
-			network.reconnectAndRejoin();
+			network.reconnect();
 		}
 
 		if (SimpleGUI::Button(U"stats", { x += offsetX, y }, ButtonWidth))
@@ -182,6 +296,14 @@ void Main()
 			network.debugLog(U"serverTime: {}ms"_fmt(Format(network.getServerTimeMillisec())));
 			network.debugLog(U"serverTimeOffset: {}ms"_fmt(Format(network.getServerTimeOffsetMillisec())));
 			network.debugLog(U"ping: {}ms"_fmt(Format(network.getPingMillisec())));
+			network.debugLog(U"sharedTime: {}us"_fmt(network.getSharedTimeMicrosec()));
+			network.debugLog(U"clockDrift: {:.1f}ppm, jitter: {}us"_fmt(network.getClockSyncStats().driftPPM, network.getClockSyncStats().jitterMicrosec));
+			network.debugLog(U"rtt p50/p90/p99: {}/{}/{}ms, resent: {}/s, degraded: {}"_fmt(network.getConnectionQuality().roundTripP50Millisec,
+				network.getConnectionQuality().roundTripP90Millisec, network.getConnectionQuality().roundTripP99Millisec,
+				network.getConnectionQuality().resentReliableCommandsPerSec, network.getConnectionQuality().degraded));
+			network.debugLog(U"send queue: {} events ({} bytes), deferred: {}"_fmt(network.getSendSchedulerStats().queuedEvents,
+				network.getSendSchedulerStats().queuedBytes, network.getSendSchedulerStats().deferredUpdates));
+			network.debugLog(U"receive queue: {} events, dropped: {}"_fmt(network.getReceiveQueueStats().queued, network.getReceiveQueueStats().droppedEvents));
 		}
 
 		if (SimpleGUI::Button(U"getPingInterval", { x += offsetX, y }, ButtonWidth))
@@ -237,6 +359,25 @@ void Main()
 			network.joinRandomRoom();
 		}
 
+		// SQL ロビーの列 0 にレベル（1～100）、列 1 にページングで使うルームごとの値を設定したルーム
+		if (SimpleGUI::Button(U"createRoom (SQL lobby)", { x += offsetX, y }, ButtonWidth))
+		{
+			network.createRoom(
+				text.text,
+				RoomCreateOption().maxPlayers(2).lobby(U"sql").filterProperties({ { 0, Random(1, 100) }, { 1, Random(0, 0x7FFF'FFFF) } })
+			);
+		}
+
+		if (SimpleGUI::Button(U"requestRoomList", { x += offsetX, y }, ButtonWidth))
+		{
+			network.requestRoomList(LobbyQuery{ U"sql" }.between(0, 1, 50).orderBy(0).thenBy(1));
+		}
+
+		if (SimpleGUI::Button(U"nextRoomListPage", { x += offsetX, y }, ButtonWidth))
+		{
+			network.requestNextRoomListPage();
+		}
+
 		if (SimpleGUI::Button(U"joinEventTargetGroup 1", { x = initX, y += offsetY }, ButtonWidth))
 		{
 			network.joinEventTargetGroup(1);
@@ -369,6 +510,61 @@ void Main()
 			}
 		}
 
+		if (SimpleGUI::Button(U"sendCachedEvent key 1", { x = initX, y += offsetY }, ButtonWidth))
+		{
+			network.sendCachedEvent(MultiplayerEvent(EventCode::StringEvent, ReceiverOption::Others_CacheUntilLeaveRoom), 1, U"key 1: {}"_fmt(Time::GetSec()));
+		}
+
+		if (SimpleGUI::Button(U"sendCachedEvent key 2", { x += offsetX, y }, ButtonWidth))
+		{
+			network.sendCachedEvent(MultiplayerEvent(EventCode::StringEvent, ReceiverOption::Others_CacheUntilLeaveRoom), 2, U"key 2: {}"_fmt(Time::GetSec()));
+		}
+
+		if (SimpleGUI::Button(U"removeCachedEvent key 1", { x += offsetX, y }, ButtonWidth))
+		{
+			network.removeCachedEvent(EventCode::StringEvent, 1);
+		}
+
+		if (SimpleGUI::Button(U"getCachedEventKeys", { x += offsetX, y }, ButtonWidth))
+		{
+			network.debugLog(U"getCachedEventKeys: {} ({} events in the room cache)"_fmt(network.getCachedEventKeys(EventCode::StringEvent), network.getNumRoomCachedEvents(EventCode::StringEvent)));
+		}
+
+		if (SimpleGUI::Button(U"sendStream To", { x = initX, y += offsetY }, ButtonWidth))
+		{
+			auto target = network.getLocalPlayerByName(text.text);
+			if (target)
+			{
+				// 約 800 KB のデータを分割して送る
+				network.sendStream(target.value().localID, EventCode::CustomDataTest4, Array<double>(100'000, 0.5));
+			}
+		}
+
+		if (SimpleGUI::Button(U"sendPackedEvent", { x += offsetX, y }, ButtonWidth))
+		{
+			network.sendPackedEvent({ EventCode::PackedDataTest }, MyData{ .word = U"Siv3D", .pos = Cursor::Pos() }, true);
+		}
+
+		if (SimpleGUI::Button(U"sendStream Packed To", { x += offsetX, y }, ButtonWidth))
+		{
+			auto target = network.getLocalPlayerByName(text.text);
+			if (target)
+			{
+				// 10,000 個の粒子を約 60 KB に詰めて、1 つのイベントには大きすぎるので分割して送る
+				ParticleData particles;
+				particles.positions = Array<Vec2>::Generate(10'000, []() { return RandomVec2(Scene::Rect()); });
+				particles.scales = Array<double>::Generate(10'000, []() { return Random(0.5, 2.0); });
+
+				PackedWriter packed;
+				packed(particles);
+				const auto& bytes = packed.finish();
+
+				Serializer<MemoryWriter> writer;
+				writer->write(bytes.data(), static_cast<int64>(bytes.size()));
+				network.sendStream(target.value().localID, EventCode::PackedArrayTest, writer);
+			}
+		}
+
 		if (SimpleGUI::Button(U"getSelf", { x = initX, y += offsetY }, ButtonWidth))
 		{
 			auto player = network.getLocalPlayer();
@@ -495,6 +691,29 @@ void Main()
 			network.debugLog(U"SetIsOpenInCurrentRoom: false");
 			network.setIsVisibleInCurrentRoom(false);
 		}
+
+		if (SimpleGUI::Button(U"startRecording", { x = initX, y += offsetY }, ButtonWidth))
+		{
+			network.debugLog(U"startRecording: {}"_fmt(network.startRecording(U"session.mprec")));
+		}
+
+		if (SimpleGUI::Button(U"stopRecording", { x += offsetX, y }, ButtonWidth))
+		{
+			network.stopRecording();
+		}
+
+		if (SimpleGUI::Button(U"replay (max speed)", { x += offsetX, y }, ButtonWidth, (not network.isRecording())))
+		{
+			// 記録したコールバックを、接続していない別のインスタンスで再生する
+			MultiplayerReplay replay{ U"session.mprec" };
+			MyNetwork offline{};
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+			const size_t count = replay.playAll(offline);
+			offline.flushLog();
+			network.debugLog(U"replay: {} records, {}us"_fmt(count, stopwatch.us()));
+		}
+
+		SimpleGUI::CheckBox(showProfiler, U"profiler", { x += offsetX, y }, ButtonWidth);
 		
 		{
 			font(network.getClientState()).drawAt(Rect{ x = initX, y += offsetY, ButtonWidth, 40 }.center());
@@ -530,5 +749,10 @@ void Main()
 				network.getIsVisibleInCurrentRoom()
 			)).drawAt(Rect{ x += offsetX, y, ButtonWidth, 40 }.center());
 		}
+
+		if (showProfiler)
+		{
+			profiler.draw(Vec2{ (Scene::Width() - profiler.size().x - 10), (Scene::Height() - profiler.size().y - 10) });
+		}
 	}
 }
@@ -18,6 +18,9 @@
 
 # define NOMINMAX
 # include <LoadBalancing-cpp/inc/Client.h>
+# include <condition_variable>
+# include <deque>
+# include <mutex>
 # include "Multiplayer_Photon.hpp"
 
 namespace s3d::detail {
@@ -25,8 +28,7 @@ namespace s3d::detail {
 	{
 		if (errorCode)
 		{
-			photon.debugLog(U"- [Multiplayer_Photon] errorCode: ", errorCode);
-			photon.debugLog(U"- [Multiplayer_Photon] errorString: ", errorString);
+			photon.log(LogLevel::Warning, U"- [Multiplayer_Photon] errorCode: ", errorCode, U", errorString: ", errorString);
 		}
 	}
 }
@@ -87,23 +89,79 @@ namespace s3d
 			return ExitGames::Common::ValueObject<ExitGames::Common::JString>(obj).getDataCopy();
 		}
 
-		[[nodiscard]]
-		static RoomPropertyTable PhotonHashtableToStringHashTable(const ExitGames::Common::Hashtable& data)
+		static void PhotonHashtableToStringHashTable(const ExitGames::Common::Hashtable& data, RoomPropertyTable& result)
 		{
-			RoomPropertyTable result{};
+			result.clear();
 
 			const auto& keys = data.getKeys();
 
 			for (uint32 i = 0; i < keys.getSize(); ++i)
 			{
 				const ExitGames::Common::JString key = ObjectToJString(keys[i]);
+
+				// SQL ロビーの列（C0～C9）などは含めない
+				if (key.length() != 1)
+				{
+					continue;
+				}
+
 				const ExitGames::Common::JString value = ObjectToJString(*data.getValue(key));
 				result[static_cast<uint8>(key.charAt(0))] = detail::ToString(value);
 			}
+		}
+
+		[[nodiscard]]
+		static RoomPropertyTable PhotonHashtableToStringHashTable(const ExitGames::Common::Hashtable& data)
+		{
+			RoomPropertyTable result{};
+			PhotonHashtableToStringHashTable(data, result);
+			return result;
+		}
+
+		/// @brief SQL ロビーの列の名前を返します。
+		[[nodiscard]]
+		static String LobbyFilterColumnName(const uint8 column)
+		{
+			if (9 < column)
+			{
+				throw Error{ U"[Multiplayer_Photon] Lobby filter column must be in a range of 0 to 9" };
+			}
+
+			return (U"C" + Format(column));
+		}
+
+		[[nodiscard]]
+		static LobbyFilterPropertyTable ToLobbyFilterPropertyTable(const ExitGames::Common::Hashtable& data)
+		{
+			LobbyFilterPropertyTable result{};
+
+			for (uint8 column = 0; column <= 9; ++column)
+			{
+				const auto* value = data.getValue(ToJString(LobbyFilterColumnName(column)));
+
+				if (value && (value->getType() == ExitGames::Common::TypeCode::INTEGER))
+				{
+					result[column] = ExitGames::Common::ValueObject<int32>(*value).getDataCopy();
+				}
+			}
 
 			return result;
 		}
 
+		[[nodiscard]]
+		static RoomInfo ToRoomInfo(const ExitGames::LoadBalancing::Room& room)
+		{
+			return RoomInfo
+			{
+				.name = ToString(room.getName()),
+				.playerCount = room.getPlayerCount(),
+				.maxPlayers = room.getMaxPlayers(),
+				.isOpen = room.getIsOpen(),
+				.properties = PhotonHashtableToStringHashTable(room.getCustomProperties()),
+				.filterProperties = ToLobbyFilterPropertyTable(room.getCustomProperties()),
+			};
+		}
+
 		[[nodiscard]]
 		static ExitGames::Common::Hashtable ToPhotonHashtable(const RoomPropertyTable& table)
 		{
@@ -124,7 +182,30 @@ namespace s3d
 			roomOptions.setMaxPlayers(static_cast<uint8>(option.maxPlayers()));
 			roomOptions.setIsVisible(option.isVisible());
 			roomOptions.setIsOpen(option.isOpen());
-			roomOptions.setCustomRoomProperties(ToPhotonHashtable(option.properties()));
+			auto customRoomProperties = ToPhotonHashtable(option.properties());
+
+			if (not option.filterProperties().empty())
+			{
+				ExitGames::Common::JVector<ExitGames::Common::JString> propsListedInLobby;
+
+				for (const auto& [column, value] : option.filterProperties())
+				{
+					const auto name = ToJString(LobbyFilterColumnName(column));
+					customRoomProperties.put(name, value);
+					propsListedInLobby.addElement(name);
+				}
+
+				roomOptions.setPropsListedInLobby(propsListedInLobby);
+			}
+
+			roomOptions.setCustomRoomProperties(customRoomProperties);
+
+			if (not option.lobby().isEmpty())
+			{
+				roomOptions.setLobbyName(ToJString(option.lobby()));
+				roomOptions.setLobbyType(ExitGames::LoadBalancing::LobbyType::SQL_LOBBY);
+			}
+
 			roomOptions.setPublishUserID(option.publishUserId());
 			if (option.rejoinGracePeriod())
 			{
@@ -142,6 +223,126 @@ namespace s3d
 		{
 			LogIfError(photon, errorCode, ToString(errorString));
 		}
+
+		/// @brief ライブラリ内部で使うイベントのイベントコード（ユーザが使えるのは 1～199）
+		inline constexpr uint8 SystemEventCode = 0;
+
+		/// @brief ライブラリ内部で使うイベントの種類。イベントデータの先頭 1 バイトに書き込まれる
+		enum class SystemEvent : uint8
+		{
+			HostCheckpoint = 1,
+			HostSuccessor,
+			JoinSnapshot,
+			StreamChunk,
+			StreamAck,
+			StreamCancel,
+		};
+
+		/// @brief sendCachedEvent() のイベントデータ（Hashtable）のキー。ルームのキャッシュから削除するときのフィルタにも使う
+		/// @remark CachedEventKey を持たないイベントは、複数のイベントをまとめたスナップショット
+		inline constexpr nByte CachedEventKey = 0;
+
+		inline constexpr nByte CachedEventData = 1;
+
+		/// @brief イベントを送信したプレイヤーの ID
+		inline constexpr nByte CachedEventOwner = 2;
+
+		/// @brief SQL ロビーから 1 回の要求で返されるルームの最大数
+		inline constexpr uint32 RoomListPageSize = 100;
+
+		/// @brief ホスト移行のために ping を公開するプレイヤープロパティのキー
+		[[nodiscard]]
+		static ExitGames::Common::JString HostMigrationPingKey()
+		{
+			return L"s3d.ping";
+		}
+
+		[[nodiscard]]
+		static int32 GetPublishedPing(const ExitGames::LoadBalancing::Player& player)
+		{
+			const auto* value = player.getCustomProperties().getValue(HostMigrationPingKey());
+
+			if (not value)
+			{
+				return Largest<int32>;
+			}
+
+			return ExitGames::Common::ValueObject<int32>(*value).getDataCopy();
+		}
+
+		static void WriteRoomInfoList(Serializer<MemoryWriter>& writer, const Array<RoomInfo>& rooms)
+		{
+			writer(static_cast<uint32>(rooms.size()));
+
+			for (const auto& room : rooms)
+			{
+				writer(room.name, room.playerCount, room.maxPlayers, room.isOpen);
+
+				writer(static_cast<uint32>(room.properties.size()));
+				for (const auto& [key, value] : room.properties)
+				{
+					writer(key, value);
+				}
+
+				writer(static_cast<uint32>(room.filterProperties.size()));
+				for (const auto& [column, value] : room.filterProperties)
+				{
+					writer(column, value);
+				}
+			}
+		}
+
+		[[nodiscard]]
+		static Array<RoomInfo> ReadRoomInfoList(Deserializer<MemoryViewReader>& reader)
+		{
+			uint32 numRooms = 0;
+			reader(numRooms);
+
+			Array<RoomInfo> rooms(numRooms);
+
+			for (auto& room : rooms)
+			{
+				reader(room.name, room.playerCount, room.maxPlayers, room.isOpen);
+
+				uint32 numProperties = 0;
+				reader(numProperties);
+				for (uint32 i = 0; i < numProperties; ++i)
+				{
+					uint8 key = 0;
+					String value;
+					reader(key, value);
+					room.properties.emplace(key, std::move(value));
+				}
+
+				uint32 numFilterProperties = 0;
+				reader(numFilterProperties);
+				for (uint32 i = 0; i < numFilterProperties; ++i)
+				{
+					uint8 column = 0;
+					int32 value = 0;
+					reader(column, value);
+					room.filterProperties.emplace(column, value);
+				}
+			}
+
+			return rooms;
+		}
+
+		/// @brief デシリアライザの残りのデータを読み込みます。
+		[[nodiscard]]
+		static Blob ReadRemaining(Deserializer<MemoryViewReader>& reader)
+		{
+			const int64 size = (reader->size() - reader->getPos());
+
+			if (size <= 0)
+			{
+				return{};
+			}
+
+			Blob blob(static_cast<size_t>(size));
+			reader->read(blob.data(), size);
+			return blob;
+		}
 	}
 }
 
@@ -158,17 +359,40 @@ namespace s3d
 
 		void onAvailableRegions(const ExitGames::Common::JVector<ExitGames::Common::JString>& availableRegions, [[maybe_unused]] const ExitGames::Common::JVector<ExitGames::Common::JString>& availableRegionServers) override
 		{
-			const String target = m_context.m_requestedRegion->lowercased();
+			const String& target = *m_context.m_requestedRegion;
+
+			// "region/cluster" の形式でクラスタも指定できる
+			// リージョンは大文字・小文字を区別せずに比べ、クラスタは指定されたとおりに渡す
+			const size_t separator = target.indexOf(U'/');
+			const String targetRegion = target.substr(0, separator);
+			const String targetCluster = ((separator == String::npos) ? String{} : target.substr(separator));
 
 			for (unsigned i = 0; i < availableRegions.getSize(); ++i)
 			{
-				if (detail::ToString(availableRegions[i]) == target)
+				const String region = detail::ToString(availableRegions[i]);
+
+				if (region.case_insensitive_equals(targetRegion))
 				{
-					m_context.m_client->selectRegion(availableRegions[i]);
+					m_context.m_client->selectRegion(detail::ToJString(region + targetCluster));
 					return;
 				}
 			}
 
+			// 指定されたリージョンが無い場合、保存されている最速のリージョンがあればそれを優先する
+			if (const auto cached = m_context.loadRegionCache())
+			{
+				for (unsigned i = 0; i < availableRegions.getSize(); ++i)
+				{
+					if (detail::ToString(availableRegions[i]) == *cached)
+					{
+						m_context.log(LogLevel::Warning, U"[Multiplayer_Photon] region `", target, U"` is not available. Using the cached best region `", *cached, U"`");
+						m_context.m_client->selectRegion(availableRegions[i]);
+						return;
+					}
+				}
+			}
+
+			m_context.log(LogLevel::Warning, U"[Multiplayer_Photon] region `", target, U"` is not available. Using `", [&]() { return detail::ToString(availableRegions[0]); }, U"`");
 			m_context.m_client->selectRegion(availableRegions[0]);
 		}
 
@@ -179,9 +403,17 @@ namespace s3d
 
 		void connectionErrorReturn(const int errorCode) override
 		{
-			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::connectionErrorReturn() [サーバへの接続が失敗したときに呼ばれる]");
-			m_context.debugLog(U"- [Multiplayer_Photon] errorCode: ", errorCode);
+			m_context.log(LogLevel::Error, U"[Multiplayer_Photon] Multiplayer_Photon::connectionErrorReturn() [サーバへの接続が失敗したときに呼ばれる]");
+			m_context.log(LogLevel::Error, U"- [Multiplayer_Photon] errorCode: ", errorCode);
+
+			if (m_context.m_usingCachedRegion)
+			{
+				m_context.clearRegionCache();
+			}
+			m_context.record(detail::RecordKind::ConnectionError, static_cast<int32>(errorCode));
 			m_context.connectionErrorReturn(errorCode);
+
+			m_context.scheduleReconnect();
 		}
 
 		void clientErrorReturn([[maybe_unused]] const int errorCode) override
@@ -202,8 +434,10 @@ namespace s3d
 		// 誰か（自分を含む）がルームに参加したら呼ばれるコールバック
 		void joinRoomEventAction([[maybe_unused]] const int playerID, const ExitGames::Common::JVector<int>& playerIDs, const ExitGames::LoadBalancing::Player& player) override
 		{
-			Array<LocalPlayerID> ids(playerIDs.getSize());
+			auto& ids = m_context.m_frameBuffers.playerIDs;
 			{
+				ids.resize(playerIDs.getSize());
+
 				for (unsigned i = 0; i < playerIDs.getSize(); ++i)
 				{
 					ids[i] = playerIDs[i];
@@ -225,7 +459,66 @@ namespace s3d
 
 			if (isSelf)
 			{
+				const bool sameRoom = (m_context.m_lastJoinedRoomName == m_context.getCurrentRoomName());
 				m_context.m_lastJoinedRoomName = m_context.getCurrentRoomName();
+				m_context.m_rejoinOnReconnect = true;
+				m_context.m_receivedCachedEventKeys.clear();
+
+				// 新しいルームではイベントターゲットグループへの参加がリセットされる
+				m_context.m_spatialInterestGroups.fill(false);
+
+				if (m_context.m_restoreOnRejoin)
+				{
+					m_context.restoreAfterRejoin();
+				}
+				else
+				{
+					m_context.m_eventTargetGroups.fill(false);
+
+					// 前のルームで受信したイベントは処理しない
+					if (m_context.m_receiveQueue)
+					{
+						m_context.m_receiveQueue->queue.clear();
+					}
+
+					m_context.resetEventCacheMirror(sameRoom);
+
+					// 前のルームでの転送は続けられない
+					m_context.abortStreams(-1);
+
+					if (m_context.m_sendScheduler)
+					{
+						m_context.m_sendScheduler->channels.clear();
+						m_context.m_sendScheduler->stats.queuedEvents = 0;
+						m_context.m_sendScheduler->stats.queuedBytes = 0;
+					}
+				}
+
+				if (m_context.m_hostMigration)
+				{
+					m_context.m_hostMigration = detail::HostMigrationState{ .checkpointInterval = m_context.m_hostMigration->checkpointInterval };
+				}
+
+				if (m_context.m_joinSnapshot)
+				{
+					m_context.m_joinSnapshot = detail::JoinSnapshotState{ .chunkSize = m_context.m_joinSnapshot->chunkSize };
+				}
+			}
+			else
+			{
+				if (m_context.m_hostMigration)
+				{
+					// 後から参加したプレイヤーにも後継者を通知する
+					m_context.m_hostMigration->successorDirty = true;
+				}
+
+				if (m_context.m_joinSnapshot && m_context.isHost())
+				{
+					m_context.m_joinSnapshot->pendingPlayers << playerID;
+				}
+
+				// ルームに再参加したプレイヤーが切断中に受信できなかったチャンクを送信し直す
+				m_context.rewindStreams(playerID);
 			}
 
 			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::joinRoomEventAction() [誰か（自分を含む）が現在のルームに参加したときに呼ばれる]");
@@ -233,6 +526,8 @@ namespace s3d
 			m_context.debugLog(U"- [Multiplayer_Photon] isSelf [自分自身の参加？]: ", isSelf);
 			m_context.debugLog(U"- [Multiplayer_Photon] playerIDs [ルームの参加者一覧]: ", ids);
 
+			m_context.record(detail::RecordKind::JoinRoomEvent, localPlayer.localID, localPlayer.userName, localPlayer.userID, localPlayer.isHost, localPlayer.isActive, ids, isSelf);
+
 			m_context.joinRoomEventAction(localPlayer, ids, isSelf);
 		}
 
@@ -243,28 +538,106 @@ namespace s3d
 			m_context.debugLog(U"- [Multiplayer_Photon] playerID: ", playerID);
 			m_context.debugLog(U"- [Multiplayer_Photon] isInactive: ", isInactive);
 
+			if (m_context.m_hostMigration && (m_context.m_hostMigration->successor == playerID))
+			{
+				m_context.m_hostMigration->successor = -1;
+				m_context.m_hostMigration->successorDirty = true;
+			}
+
+			// 送信の途中でホストが退出した場合、受信したチャンクは使えない
+			if (m_context.m_joinSnapshot && (m_context.m_joinSnapshot->receivingFrom == playerID))
+			{
+				m_context.m_joinSnapshot->receivingFrom = -1;
+				m_context.m_joinSnapshot->data.clear();
+			}
+
+			// 再参加する可能性がある場合は、転送を中止しない
+			if (not isInactive)
+			{
+				m_context.abortStreams(playerID);
+			}
+
+			m_context.record(detail::RecordKind::LeaveRoomEvent, static_cast<LocalPlayerID>(playerID), isInactive);
+
+			// 退出したプレイヤーが退出前に送信したイベントを、退出の通知より先に処理する
+			m_context.dispatchReceivedEventsFrom(playerID);
+
 			m_context.leaveRoomEventAction(playerID, isInactive);
 		}
 
 		// ルームで他人が sendEvent したら呼ばれるコールバック
 		void customEventAction(const int playerID, const nByte eventCode, const ExitGames::Common::Object& _data) override
 		{
+			// sendCachedEvent() で送信されたイベント
+			if (_data.getType() == ExitGames::Common::TypeCode::HASHTABLE)
+			{
+				customCachedEventAction(playerID, eventCode, *ExitGames::Common::ValueObject<ExitGames::Common::Hashtable>{ _data }.getDataAddress());
+				return;
+			}
+
 			const ExitGames::Common::ValueObject<uint8*> data{ _data };
-			const auto size = data.getSizes()[0];
 
-			Deserializer<MemoryViewReader> reader{ data.getDataCopy(), size };
+			// コピーせずに受信したバッファをそのまま読む
+			m_context.receiveCustomEvent(playerID, eventCode, *data.getDataAddress(), data.getSizes()[0]);
+		}
+
+		void customCachedEventAction(const int playerID, const nByte eventCode, const ExitGames::Common::Hashtable& table)
+		{
+			const auto* dataObject = table.getValue(detail::CachedEventData);
+
+			if ((not dataObject) || (dataObject->getType() != ExitGames::Common::TypeCode::BYTE))
+			{
+				return;
+			}
+
+			const ExitGames::Common::ValueObject<uint8*> data{ *dataObject };
+			const uint8* bytes = *data.getDataAddress();
+			const size_t size = data.getSizes()[0];
+
+			auto& receivedKeys = m_context.m_receivedCachedEventKeys[eventCode];
+
+			if (const auto* keyObject = table.getValue(detail::CachedEventKey))
+			{
+				const int32 key = ExitGames::Common::ValueObject<int32>{ *keyObject }.getDataCopy();
+				m_context.onCachedEventReplaced(playerID, eventCode, key);
+				receivedKeys.insert(key);
 
-			if (m_context.m_table.contains(eventCode)) {
-				auto& receiver = m_context.m_table[eventCode];
-				(receiver.second)(m_context, receiver.first, playerID, reader);
+				m_context.receiveCustomEvent(playerID, eventCode, bytes, size);
+				return;
 			}
-			else {
-				m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::customEventAction(Deserializer<MemoryReader>)");
-				m_context.debugLog(U"- [Multiplayer_Photon] playerID: ", playerID);
-				m_context.debugLog(U"- [Multiplayer_Photon] eventCode: ", eventCode);
-				m_context.debugLog(U"- [Multiplayer_Photon] data: ", size, U" bytes (serialized)");
 
-				m_context.customEventAction(playerID, eventCode, reader);
+			// スナップショット: (キー, サイズ, データ) の並び
+			// スナップショットは後から参加したプレイヤーのためのもの。受信済みのキーは、同じかより新しい値を処理しているので飛ばす
+			Deserializer<MemoryViewReader> reader{ bytes, size };
+			uint32 count = 0;
+			reader(count);
+
+			for (uint32 i = 0; i < count; ++i)
+			{
+				if (size < (static_cast<uint64>(reader->getPos()) + sizeof(int32) + sizeof(uint64)))
+				{
+					m_context.log(LogLevel::Warning, U"[Multiplayer_Photon] Received a broken event cache snapshot. eventCode: ", eventCode);
+					return;
+				}
+
+				int32 key = 0;
+				uint64 entrySize = 0;
+				reader(key, entrySize);
+
+				const int64 pos = reader->getPos();
+
+				if ((size - static_cast<uint64>(pos)) < entrySize)
+				{
+					m_context.log(LogLevel::Warning, U"[Multiplayer_Photon] Received a broken event cache snapshot. eventCode: ", eventCode);
+					return;
+				}
+
+				if (receivedKeys.insert(key).second)
+				{
+					m_context.receiveCustomEvent(playerID, eventCode, (bytes + pos), static_cast<size_t>(entrySize));
+				}
+
+				reader->setPos(pos + static_cast<int64>(entrySize));
 			}
 		}
 
@@ -272,12 +645,45 @@ namespace s3d
 		void connectReturn(const int errorCode, const ExitGames::Common::JString& errorString, const ExitGames::Common::JString& region, const ExitGames::Common::JString& cluster) override
 		{
 			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::connectReturn()");
-			m_context.debugLog(U"- [Multiplayer_Photon] region: ", detail::ToString(region));
-			m_context.debugLog(U"- [Multiplayer_Photon] cluster: ", detail::ToString(cluster));
+			m_context.debugLog(U"- [Multiplayer_Photon] region: ", [&]() { return detail::ToString(region); });
+			m_context.debugLog(U"- [Multiplayer_Photon] cluster: ", [&]() { return detail::ToString(cluster); });
 
 			detail::LogIfError(m_context, errorCode, detail::ToString(errorString));
 
+			if (errorCode == 0)
+			{
+				m_context.m_lastRegion = detail::ToString(region);
+				m_context.m_lastCluster = detail::ToString(cluster);
+
+				// 保存されたリージョンに接続できたので、この後の切断ではキャッシュを消さない
+				m_context.m_usingCachedRegion = false;
+
+				// SDK が全リージョンに ping を送って選んだ結果を保存する
+				if (not m_context.m_clientSelectsRegion)
+				{
+					m_context.saveRegionCache(*m_context.m_lastRegion);
+				}
+			}
+			else if (m_context.m_usingCachedRegion)
+			{
+				m_context.clearRegionCache();
+			}
+
+			m_context.record(detail::RecordKind::Connect, static_cast<int32>(errorCode), detail::ToString(errorString), detail::ToString(region), detail::ToString(cluster));
+
 			m_context.connectReturn(errorCode, detail::ToString(errorString), detail::ToString(region), detail::ToString(cluster));
+
+			if (m_context.isReconnecting())
+			{
+				if (errorCode != 0)
+				{
+					m_context.scheduleReconnect();
+				}
+				else if (not m_context.m_restoreOnRejoin) // ルームに再参加する場合は joinRoomEventAction() で終了する
+				{
+					m_context.finishReconnect(true);
+				}
+			}
 		}
 
 		// disconnect() の結果を通知するコールバック
@@ -285,7 +691,14 @@ namespace s3d
 		{
 			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::disconnectReturn() [サーバから切断されたときに呼ばれる]");
 
+			m_context.record(detail::RecordKind::Disconnect);
+
 			m_context.disconnectReturn();
+
+			if (not m_context.m_disconnectRequested)
+			{
+				m_context.scheduleReconnect();
+			}
 		}
 
 		void leaveRoomReturn(const int errorCode, const ExitGames::Common::JString& errorString) override
@@ -294,6 +707,8 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::LeaveRoom, static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.leaveRoomReturn(errorCode, detail::ToString(errorString));
 		}
 
@@ -304,7 +719,17 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::JoinRoom, static_cast<LocalPlayerID>(playerID), static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.joinRoomReturn(playerID, errorCode, detail::ToString(errorString));
+
+			// 再参加しようとしたルームが無くなっている
+			if ((errorCode != 0) && m_context.m_restoreOnRejoin)
+			{
+				m_context.m_restoreOnRejoin = false;
+				m_context.m_rejoinOnReconnect = false;
+				m_context.finishReconnect(false);
+			}
 		}
 
 		void joinRandomRoomReturn(const int playerID, [[maybe_unused]] const ExitGames::Common::Hashtable& roomProperties, [[maybe_unused]] const ExitGames::Common::Hashtable& playerProperties, const int errorCode, const ExitGames::Common::JString& errorString) override
@@ -314,6 +739,8 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::JoinRandomRoom, static_cast<LocalPlayerID>(playerID), static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.joinRandomRoomReturn(playerID, errorCode, detail::ToString(errorString));
 		}
 
@@ -324,6 +751,8 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::CreateRoom, static_cast<LocalPlayerID>(playerID), static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.createRoomReturn(playerID, errorCode, detail::ToString(errorString));
 		}
 
@@ -334,6 +763,8 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::JoinOrCreateRoom, static_cast<LocalPlayerID>(playerID), static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.joinOrCreateRoomReturn(playerID, errorCode, detail::ToString(errorString));
 		}
 
@@ -344,6 +775,8 @@ namespace s3d
 
 			detail::LogIfError(m_context, errorCode, errorString);
 
+			m_context.record(detail::RecordKind::JoinRandomOrCreateRoom, static_cast<LocalPlayerID>(playerID), static_cast<int32>(errorCode), detail::ToString(errorString));
+
 			m_context.joinRandomOrCreateRoomReturn(playerID, errorCode, detail::ToString(errorString));
 		}
 
@@ -351,12 +784,72 @@ namespace s3d
 		{
 			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::onRoomListUpdate()");
 
+			m_context.record(detail::RecordKind::RoomListUpdate);
+
 			m_context.onRoomListUpdate();
 		}
 
+		// requestRoomList() の結果を通知するコールバック
+		void onGetRoomListResponse(const ExitGames::Common::JVector<ExitGames::Common::Helpers::SharedPointer<ExitGames::LoadBalancing::Room>>& roomList, [[maybe_unused]] const ExitGames::Common::JVector<ExitGames::Common::JString>& roomNameList) override
+		{
+			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::onGetRoomListResponse()");
+			m_context.debugLog(U"- [Multiplayer_Photon] rooms: ", roomList.getSize());
+
+			Array<RoomInfo> rooms(roomList.getSize());
+
+			for (uint32 i = 0; i < roomList.getSize(); ++i)
+			{
+				rooms[i] = detail::ToRoomInfo(*roomList[i]);
+			}
+
+			// 続きは、このページで最後に並ぶ (並べた列の値, 一意な列の値) より後から取得する
+			// 受け取ったルームの順番は SQL の並び順と同じとは限らないので、ページ全体から探す
+			// 1 ページ分に満たない場合は、続きが無い
+			m_context.m_nextRoomPageAfter.reset();
+
+			if (m_context.m_lastRoomQuery
+				&& m_context.m_lastRoomQuery->orderColumn()
+				&& m_context.m_lastRoomQuery->uniqueColumn()
+				&& (detail::RoomListPageSize <= roomList.getSize()))
+			{
+				const uint8 orderColumn = *m_context.m_lastRoomQuery->orderColumn();
+				const uint8 uniqueColumn = *m_context.m_lastRoomQuery->uniqueColumn();
+				const bool descending = m_context.m_lastRoomQuery->isDescending();
+
+				for (const auto& room : rooms)
+				{
+					const auto itValue = room.filterProperties.find(orderColumn);
+					const auto itUnique = room.filterProperties.find(uniqueColumn);
+
+					if ((itValue == room.filterProperties.end()) || (itUnique == room.filterProperties.end()))
+					{
+						continue;
+					}
+
+					const std::pair<int32, int32> key{ itValue->second, itUnique->second };
+					auto& cursor = m_context.m_nextRoomPageAfter;
+
+					if ((not cursor) || (descending ? (key < *cursor) : (*cursor < key)))
+					{
+						cursor = key;
+					}
+				}
+			}
+
+			if (m_context.isRecording())
+			{
+				Serializer<MemoryWriter> writer;
+				detail::WriteRoomInfoList(writer, rooms);
+				m_context.writeRecord(detail::RecordKind::RoomListResponse, writer->getBlob());
+			}
+
+			m_context.onRoomListResponse(rooms);
+		}
+
 		void onRoomPropertiesChange(const ExitGames::Common::Hashtable& changes_) override
 		{
-			auto changes = detail::PhotonHashtableToStringHashTable(changes_);
+			auto& changes = m_context.m_frameBuffers.properties;
+			detail::PhotonHashtableToStringHashTable(changes_, changes);
 
 			if (changes.size() == 0)
 			{
@@ -364,7 +857,21 @@ namespace s3d
 			}
 
 			m_context.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::onRoomPropertiesChange()");
-			m_context.debugLog(U"- [Multiplayer_Photon] changes: {}"_fmt(Format(changes)));
+			m_context.debugLog(U"- [Multiplayer_Photon] changes: ", [&]() { return Format(changes); });
+
+			if (m_context.isRecording())
+			{
+				Array<uint8> keys;
+				Array<String> values;
+
+				for (const auto& [key, value] : changes)
+				{
+					keys << key;
+					values << value;
+				}
+
+				m_context.record(detail::RecordKind::RoomPropertiesChange, keys, values);
+			}
 
 			m_context.onRoomPropertiesChange(changes);
 		}
@@ -375,6 +882,10 @@ namespace s3d
 			m_context.debugLog(U"- [Multiplayer_Photon] netHostID: {}"_fmt(newHostID));
 			m_context.debugLog(U"- [Multiplayer_Photon] oldHostID: {}"_fmt(oldHostID));
 
+			m_context.onHostMigration(newHostID, oldHostID);
+
+			m_context.record(detail::RecordKind::HostChange, static_cast<LocalPlayerID>(newHostID), static_cast<LocalPlayerID>(oldHostID));
+
 			m_context.onHostChange(newHostID, oldHostID);
 		}
 
@@ -386,7 +897,7 @@ namespace s3d
 	};
 }
 
-// RoomCreateOption, TargetGroup, MultiplayerEvent
+// RoomCreateOption, LobbyQuery, TargetGroup, MultiplayerEvent, SpatialInterestOption
 namespace s3d {
 
 	// RoomCreateOption
@@ -472,20 +983,199 @@ namespace s3d {
 		return m_roomDestroyGracePeriod;
 	}
 
-	// TargetGroup
-
-	TargetGroup::TargetGroup(uint8 targetGroup) noexcept
-		: m_targetGroup(targetGroup)
+	RoomCreateOption& RoomCreateOption::lobby(const StringView lobbyName)
 	{
+		m_lobbyName = lobbyName;
+		return *this;
 	}
 
-	uint8 TargetGroup::value() const noexcept
+	RoomCreateOption& RoomCreateOption::filterProperties(const LobbyFilterPropertyTable& filterProperties)
 	{
-		return m_targetGroup;
-	}
-
-	// MultiplayerEvent
-
+		for (const auto& [column, value] : filterProperties)
+		{
+			if (9 < column)
+			{
+				throw Error{ U"[Multiplayer_Photon] Lobby filter column must be in a range of 0 to 9" };
+			}
+		}
+
+		m_filterProperties = filterProperties;
+		return *this;
+	}
+
+	const String& RoomCreateOption::lobby() const noexcept
+	{
+		return m_lobbyName;
+	}
+
+	const LobbyFilterPropertyTable& RoomCreateOption::filterProperties() const noexcept
+	{
+		return m_filterProperties;
+	}
+
+	// LobbyQuery
+
+	LobbyQuery::LobbyQuery(const StringView lobbyName)
+		: m_lobbyName{ lobbyName } {}
+
+	LobbyQuery& LobbyQuery::equal(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} = {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::notEqual(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} <> {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::less(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} < {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::lessEqual(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} <= {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::greater(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} > {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::greaterEqual(const uint8 column, const int32 value)
+	{
+		m_conditions << U"{} >= {}"_fmt(detail::LobbyFilterColumnName(column), value);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::between(const uint8 column, const int32 min, const int32 max)
+	{
+		m_conditions << U"{} BETWEEN {} AND {}"_fmt(detail::LobbyFilterColumnName(column), min, max);
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::anyOf(const uint8 column, const Array<int32>& values)
+	{
+		if (values.isEmpty())
+		{
+			// 一致するルームは無い
+			m_conditions << U"1 = 0";
+			return *this;
+		}
+
+		const String name = detail::LobbyFilterColumnName(column);
+		m_conditions << values.map([&](const int32 value) { return U"{} = {}"_fmt(name, value); }).join(U" OR ", U"", U"");
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::is(const uint8 column, const bool value)
+	{
+		return equal(column, (value ? 1 : 0));
+	}
+
+	LobbyQuery& LobbyQuery::where(const StringView condition)
+	{
+		m_conditions << String{ condition };
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::orderBy(const uint8 column, const bool descending)
+	{
+		if (9 < column)
+		{
+			throw Error{ U"[Multiplayer_Photon] Lobby filter column must be in a range of 0 to 9" };
+		}
+
+		m_orderColumn = column;
+		m_descending = descending;
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::thenBy(const uint8 uniqueColumn)
+	{
+		if (9 < uniqueColumn)
+		{
+			throw Error{ U"[Multiplayer_Photon] Lobby filter column must be in a range of 0 to 9" };
+		}
+
+		m_uniqueColumn = uniqueColumn;
+		return *this;
+	}
+
+	LobbyQuery& LobbyQuery::after(const int32 value, const int32 uniqueValue)
+	{
+		m_after = std::pair{ value, uniqueValue };
+		return *this;
+	}
+
+	const String& LobbyQuery::lobbyName() const noexcept
+	{
+		return m_lobbyName;
+	}
+
+	const Optional<uint8>& LobbyQuery::orderColumn() const noexcept
+	{
+		return m_orderColumn;
+	}
+
+	const Optional<uint8>& LobbyQuery::uniqueColumn() const noexcept
+	{
+		return m_uniqueColumn;
+	}
+
+	bool LobbyQuery::isDescending() const noexcept
+	{
+		return m_descending;
+	}
+
+	String LobbyQuery::toSQL() const
+	{
+		Array<String> conditions = m_conditions;
+
+		if (m_orderColumn && m_uniqueColumn && m_after)
+		{
+			// 並べた列の値が同じルームは、一意な列の値で前後を決める
+			const String column = detail::LobbyFilterColumnName(*m_orderColumn);
+			const String uniqueColumn = detail::LobbyFilterColumnName(*m_uniqueColumn);
+			const StringView op = (m_descending ? U"<" : U">");
+			conditions << U"{0} {1} {2} OR ({0} = {2} AND {3} {1} {4})"_fmt(column, op, m_after->first, uniqueColumn, m_after->second);
+		}
+
+		String sql = (conditions.isEmpty() ? String{ U"1 = 1" } : conditions.map([](const String& condition) { return (U"(" + condition + U")"); }).join(U" AND ", U"", U""));
+
+		if (m_orderColumn)
+		{
+			sql += U" ORDER BY {}{}"_fmt(detail::LobbyFilterColumnName(*m_orderColumn), (m_descending ? U" DESC" : U" ASC"));
+
+			if (m_uniqueColumn)
+			{
+				sql += U", {}{}"_fmt(detail::LobbyFilterColumnName(*m_uniqueColumn), (m_descending ? U" DESC" : U" ASC"));
+			}
+		}
+
+		return sql;
+	}
+
+	// TargetGroup
+
+	TargetGroup::TargetGroup(uint8 targetGroup) noexcept
+		: m_targetGroup(targetGroup)
+	{
+	}
+
+	uint8 TargetGroup::value() const noexcept
+	{
+		return m_targetGroup;
+	}
+
+	// MultiplayerEvent
+
 	MultiplayerEvent::MultiplayerEvent(uint8 eventCode, ReceiverOption receiverOption, uint8 priorityIndex)
 		: m_eventCode(eventCode)
 		, m_receiverOption(receiverOption)
@@ -543,6 +1233,98 @@ namespace s3d {
 	{
 		return m_targetList;
 	}
+
+	// SpatialInterestOption
+
+	SpatialInterestOption& SpatialInterestOption::origin(const Vec2& origin)
+	{
+		m_origin = origin;
+		return *this;
+	}
+
+	SpatialInterestOption& SpatialInterestOption::cellSize(const double cellSize)
+	{
+		if (not (0.0 < cellSize))
+		{
+			throw Error{ U"[Multiplayer_Photon] CellSize must be greater than 0" };
+		}
+		m_cellSize = cellSize;
+		return *this;
+	}
+
+	SpatialInterestOption& SpatialInterestOption::gridSize(const int32 columns, const int32 rows)
+	{
+		if ((columns < 1) or (rows < 1) or (255 < (columns * rows)))
+		{
+			throw Error{ U"[Multiplayer_Photon] The number of cells must be in a range of 1 to 255" };
+		}
+		m_columns = columns;
+		m_rows = rows;
+		return *this;
+	}
+
+	SpatialInterestOption& SpatialInterestOption::subscribeRadius(const double radius)
+	{
+		m_subscribeRadius = Max(radius, 0.0);
+		return *this;
+	}
+
+	SpatialInterestOption& SpatialInterestOption::hysteresis(const double hysteresis)
+	{
+		m_hysteresis = Max(hysteresis, 0.0);
+		return *this;
+	}
+
+	const Vec2& SpatialInterestOption::origin() const noexcept
+	{
+		return m_origin;
+	}
+
+	double SpatialInterestOption::cellSize() const noexcept
+	{
+		return m_cellSize;
+	}
+
+	int32 SpatialInterestOption::columns() const noexcept
+	{
+		return m_columns;
+	}
+
+	int32 SpatialInterestOption::rows() const noexcept
+	{
+		return m_rows;
+	}
+
+	double SpatialInterestOption::subscribeRadius() const noexcept
+	{
+		return m_subscribeRadius;
+	}
+
+	double SpatialInterestOption::hysteresis() const noexcept
+	{
+		return m_hysteresis;
+	}
+
+	int32 SpatialInterestOption::num_cells() const noexcept
+	{
+		return (m_columns * m_rows);
+	}
+
+	uint8 SpatialInterestOption::groupAt(const Vec2& pos) const noexcept
+	{
+		const Vec2 local = ((pos - m_origin) / m_cellSize);
+		const int32 column = Clamp(static_cast<int32>(Math::Floor(local.x)), 0, (m_columns - 1));
+		const int32 row = Clamp(static_cast<int32>(Math::Floor(local.y)), 0, (m_rows - 1));
+		return static_cast<uint8>(1 + (row * m_columns) + column);
+	}
+
+	RectF SpatialInterestOption::cellRect(const uint8 targetGroup) const noexcept
+	{
+		const int32 index = (targetGroup - 1);
+		const int32 column = (index % m_columns);
+		const int32 row = (index / m_columns);
+		return{ (m_origin + Vec2{ column, row } * m_cellSize), m_cellSize };
+	}
 }
 
 // Multiplayer_Photon
@@ -572,6 +1354,10 @@ namespace s3d {
 	Multiplayer_Photon::~Multiplayer_Photon()
 	{
 		disconnect();
+
+		setLogThreadEnabled(false);
+
+		flushLog();
 	}
 
 	void Multiplayer_Photon::init(const std::string_view secretPhotonAppID, const StringView photonAppVersion, const Verbose verbose, const ConnectionProtocol protocol)
@@ -611,18 +1397,75 @@ namespace s3d
 	bool Multiplayer_Photon::connect(const StringView userName_, const Optional<String>& region)
 	{
 		m_requestedRegion = region;
+		m_lastUserName = userName_;
+		m_usingCachedRegion = false;
+
+		if (not m_requestedRegion)
+		{
+			if (const auto cached = loadRegionCache())
+			{
+				m_requestedRegion = cached;
+				m_usingCachedRegion = true;
+			}
+		}
+
+		// リージョンの選択方法はクライアントの作成時に決まるので、同じ方法で切断済みのクライアントだけを使い回す
+		const bool selectsRegion = m_requestedRegion.has_value();
+		const bool reuseClient = (m_client && (m_clientSelectsRegion == selectsRegion) && (getClientState() == ClientState::Disconnected));
 
-		m_client.reset();
+		if (not reuseClient)
+		{
+			m_client.reset();
+		}
+
+		// 新しいクライアントではサーバ時刻を同期し直す（共有時刻は巻き戻さない）
+		{
+			detail::ClockSyncState clockSync;
+			clockSync.interval = m_clockSync.interval;
+			clockSync.lastSharedMicrosec = m_clockSync.lastSharedMicrosec;
+			m_clockSync = clockSync;
+		}
+
+		// 接続品質は新しい接続で測り直す（しきい値は引き継ぐ）
+		{
+			detail::ConnectionQualityState connectionQuality;
+			connectionQuality.thresholds = m_connectionQuality.thresholds;
+			m_connectionQuality = connectionQuality;
+		}
+
+		if (not reuseClient)
+		{
+			// 新しいクライアントのカウンタは 0 から始まる（累計は引き継ぐ）
+			m_trafficMeter.lastBytesIn = 0;
+			m_trafficMeter.lastBytesOut = 0;
+			m_trafficMeter.lastPacketsIn = 0;
+			m_trafficMeter.lastPacketsOut = 0;
+
+			m_client = std::make_unique<ExitGames::LoadBalancing::Client>(*m_listener, detail::ToJString(m_secretPhotonAppID), detail::ToJString(m_photonAppVersion),
+			  ExitGames::LoadBalancing::ClientConstructOptions{ FromEnum(m_connectionProtocol), false, (selectsRegion ? ExitGames::LoadBalancing::RegionSelectionMode::SELECT : ExitGames::LoadBalancing::RegionSelectionMode::BEST) });
+			m_clientSelectsRegion = selectsRegion;
+
+			m_client->setTrafficStatsEnabled(true);
+		}
+
+		m_client->setAutoJoinLobby(m_autoJoinLobby);
+
+		// 再接続しても同じプレイヤーとして扱われるように、ユーザ ID は一度だけ作成する
+		if (m_userID.isEmpty())
+		{
+			m_userID = (m_lastUserName + Format(static_cast<uint32>(Time::GetMillisecSinceEpoch())));
+		}
 
-		m_client = std::make_unique<ExitGames::LoadBalancing::Client>(*m_listener, detail::ToJString(m_secretPhotonAppID), detail::ToJString(m_photonAppVersion),
-		  ExitGames::LoadBalancing::ClientConstructOptions{ FromEnum(m_connectionProtocol), false, (m_requestedRegion ? ExitGames::LoadBalancing::RegionSelectionMode::SELECT : ExitGames::LoadBalancing::RegionSelectionMode::BEST) });
+		m_rejoinOnReconnect = false;
+		m_restoreOnRejoin = false;
+		m_disconnectRequested = false;
 
 		const auto userName = detail::ToJString(userName_);
-		const auto userID = ExitGames::LoadBalancing::AuthenticationValues{}.setUserID(userName + static_cast<uint32>(Time::GetMillisecSinceEpoch()));
+		const auto userID = ExitGames::LoadBalancing::AuthenticationValues{}.setUserID(detail::ToJString(m_userID));
 
 		if (not m_client->connect({ userID, userName }))
 		{
-			debugLog(U"[Multiplayer_Photon] ExitGmae::LoadBalancing::Client::connect() failed.");
+			log(LogLevel::Error, U"[Multiplayer_Photon] ExitGmae::LoadBalancing::Client::connect() failed.");
 			return false;
 		}
 
@@ -631,87 +1474,284 @@ namespace s3d
 		return true;
 	}
 
-	void Multiplayer_Photon::disconnect()
+	bool Multiplayer_Photon::reconnect()
 	{
-		if (not m_client)
+		if ((not m_client) || (getClientState() != ClientState::Disconnected))
 		{
-			return;
+			return false;
 		}
 
-		m_client->disconnect();
+		// ゲームサーバのアドレスと認証トークンはクライアントが保持しているので、ネームサーバとマスターサーバを経由せずに戻れる
+		if (m_rejoinOnReconnect && m_client->reconnectAndRejoin())
+		{
+			m_restoreOnRejoin = true;
+			return true;
+		}
 
-		m_client->service();
-	}
+		Optional<String> region = m_requestedRegion;
 
-	void Multiplayer_Photon::update()
-	{
-		if (not m_client)
+		if (m_lastRegion)
 		{
-			return;
+			region = (m_lastCluster.isEmpty() ? *m_lastRegion : (*m_lastRegion + U'/' + m_lastCluster));
 		}
 
-		m_client->service();
+		return connect(m_lastUserName, region);
 	}
 
-	bool Multiplayer_Photon::isActive() const
+	const String& Multiplayer_Photon::getUserID() const noexcept
 	{
-		return getClientState() != ClientState::Disconnected;
+		return m_userID;
 	}
 
-	ClientState Multiplayer_Photon::getClientState() const
+	void Multiplayer_Photon::setUserID(const StringView userID)
 	{
-		if (not m_client)
-		{
-			return ClientState::Disconnected;
-		}
-
-		using namespace ExitGames::LoadBalancing::PeerStates;
-
-		switch (m_client->getState()) {
-		case Uninitialized:
-		case PeerCreated:
-			return ClientState::Disconnected;
-		case ConnectingToNameserver:
-		case ConnectedToNameserver:
-		case DisconnectingFromNameserver:
-		case Connecting:
-		case Connected:
-		case WaitingForCustomAuthenticationNextStepCall:
-		case Authenticated:
-			return ClientState::ConnectingToLobby;
-		case JoinedLobby:
-			return ClientState::InLobby;
-		case DisconnectingFromMasterserver:
-		case ConnectingToGameserver:
-		case ConnectedToGameserver:
-		case AuthenticatedOnGameServer:
-		case Joining:
-			return ClientState::JoiningRoom;
-		case Joined:
-			return ClientState::InRoom;
-		case Leaving:
-		case Left:
-		case DisconnectingFromGameserver:
-		case ConnectingToMasterserver:
-		case ConnectedComingFromGameserver:
-		case AuthenticatedComingFromGameserver:
-			return ClientState::LeavingRoom;
-		case Disconnecting:
-		case Disconnected:
-			return ClientState::Disconnecting;
-		default:
-			return ClientState::Disconnected;
-		}
+		m_userID = userID;
 	}
 
-	bool Multiplayer_Photon::isDisconnected() const
+	const Optional<String>& Multiplayer_Photon::getLastRegion() const noexcept
 	{
-		return getClientState() == ClientState::Disconnected;
+		return m_lastRegion;
 	}
 
-	bool Multiplayer_Photon::isConnectingToLobby() const
+	void Multiplayer_Photon::setRegionCache(const FilePathView path, const Duration expiry)
 	{
-		return getClientState() == ClientState::ConnectingToLobby;
+		m_regionCachePath = FilePath{ path };
+		m_regionCacheExpiry = expiry;
+	}
+
+	void Multiplayer_Photon::clearRegionCache()
+	{
+		if (m_regionCachePath && FileSystem::Exists(*m_regionCachePath))
+		{
+			FileSystem::Remove(*m_regionCachePath);
+		}
+	}
+
+	Optional<String> Multiplayer_Photon::loadRegionCache() const
+	{
+		if ((not m_regionCachePath) || (not FileSystem::Exists(*m_regionCachePath)))
+		{
+			return none;
+		}
+
+		const JSON json = JSON::Load(*m_regionCachePath);
+
+		if ((not json)
+			|| (not json.hasElement(U"region")) || (not json[U"region"].isString())
+			|| (not json.hasElement(U"savedAt")) || (not json[U"savedAt"].isNumber())
+			|| (not json.hasElement(U"appVersion")) || (json[U"appVersion"].getString() != m_photonAppVersion))
+		{
+			return none;
+		}
+
+		const int64 elapsedMillisec = (static_cast<int64>(Time::GetMillisecSinceEpoch()) - json[U"savedAt"].get<int64>());
+
+		if ((elapsedMillisec < 0) || (static_cast<int64>(m_regionCacheExpiry.count() * 1000) < elapsedMillisec))
+		{
+			return none;
+		}
+
+		return json[U"region"].getString();
+	}
+
+	void Multiplayer_Photon::saveRegionCache(const StringView region) const
+	{
+		if (not m_regionCachePath)
+		{
+			return;
+		}
+
+		JSON json;
+		json[U"region"] = region;
+		json[U"appVersion"] = m_photonAppVersion;
+		json[U"savedAt"] = static_cast<int64>(Time::GetMillisecSinceEpoch());
+
+		if (not json.save(*m_regionCachePath))
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Failed to save the region cache: ", *m_regionCachePath);
+		}
+	}
+
+	void Multiplayer_Photon::disconnect()
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		m_disconnectRequested = true;
+
+		if (m_autoReconnect)
+		{
+			m_autoReconnect = detail::AutoReconnectState{ .option = m_autoReconnect->option };
+		}
+
+		if (m_receiveQueue)
+		{
+			m_receiveQueue->queue.clear();
+		}
+
+		m_client->disconnect();
+
+		m_client->service();
+	}
+
+	void Multiplayer_Photon::update()
+	{
+		if (not m_client)
+		{
+			flushLog();
+			return;
+		}
+
+		const uint64 updateBegin = Time::GetMicrosec();
+		m_updateCallbackMicrosec = 0;
+
+		m_frameBuffers.clear();
+
+		updateSpatialInterest();
+
+		// 送信したイベントは、この後の service() でサーバに送られる
+		updateSendScheduler();
+
+		uint64 serviceMicrosec = 0;
+		uint64 serviceCallbackMicrosec = 0;
+		{
+			MULTIPLAYER_PHOTON_TRACE_SCOPE(m_trace.get(), U"service", -1);
+
+			// 受信キューが一杯の間は、Photon の受信キューからイベントを取り出さない
+			// ただし、入退室の通知などがいつまでも遅れないように、止めるのは一定の時間まで
+			bool backpressure = false;
+
+			if (m_receiveQueue && m_receiveQueue->queue.isFull())
+			{
+				auto& state = *m_receiveQueue;
+				const uint64 now = Time::GetMillisec();
+
+				if (not state.backpressureBeginMillisec)
+				{
+					state.backpressureBeginMillisec = now;
+				}
+
+				if ((now - *state.backpressureBeginMillisec) < detail::ReceiveQueueState::MaxBackpressureMillisec)
+				{
+					backpressure = true;
+					++state.stats.backpressureUpdates;
+				}
+				else
+				{
+					++state.stats.forcedUpdates;
+				}
+			}
+			else if (m_receiveQueue)
+			{
+				m_receiveQueue->backpressureBeginMillisec.reset();
+			}
+
+			const uint64 serviceBegin = Time::GetMicrosec();
+			m_client->service(not backpressure);
+			serviceMicrosec = (Time::GetMicrosec() - serviceBegin);
+			serviceCallbackMicrosec = m_updateCallbackMicrosec;
+		}
+
+		dispatchReceiveQueue();
+
+		updateAutoReconnect();
+
+		updateEventCache();
+
+		updateTrafficMeter();
+
+		updateConnectionQuality();
+
+		updateClockSync();
+
+		updateHostMigration();
+
+		updateJoinSnapshot();
+
+		updateStreams();
+
+		if (0 < m_eventTrafficReportInterval.count())
+		{
+			const uint64 now = Time::GetMillisec();
+
+			if ((m_lastEventTrafficReportMillisec + static_cast<uint64>(m_eventTrafficReportInterval.count())) <= now)
+			{
+				m_lastEventTrafficReportMillisec = now;
+				onEventTrafficReport(getEventTrafficStats());
+			}
+		}
+
+		// コールバックは service() の中から呼ばれる
+		m_lastUpdateTiming = UpdateTimingStats{
+			.totalMicrosec = (Time::GetMicrosec() - updateBegin),
+			.serviceMicrosec = (serviceMicrosec - Min(serviceCallbackMicrosec, serviceMicrosec)),
+			.callbackMicrosec = m_updateCallbackMicrosec,
+		};
+
+		flushLog();
+	}
+
+	bool Multiplayer_Photon::isActive() const
+	{
+		return getClientState() != ClientState::Disconnected;
+	}
+
+	ClientState Multiplayer_Photon::getClientState() const
+	{
+		if (not m_client)
+		{
+			return ClientState::Disconnected;
+		}
+
+		using namespace ExitGames::LoadBalancing::PeerStates;
+
+		switch (m_client->getState()) {
+		case Uninitialized:
+		case PeerCreated:
+			return ClientState::Disconnected;
+		case ConnectingToNameserver:
+		case ConnectedToNameserver:
+		case DisconnectingFromNameserver:
+		case Connecting:
+		case Connected:
+		case WaitingForCustomAuthenticationNextStepCall:
+		case Authenticated:
+			return ClientState::ConnectingToLobby;
+		case JoinedLobby:
+			return ClientState::InLobby;
+		case DisconnectingFromMasterserver:
+		case ConnectingToGameserver:
+		case ConnectedToGameserver:
+		case AuthenticatedOnGameServer:
+		case Joining:
+			return ClientState::JoiningRoom;
+		case Joined:
+			return ClientState::InRoom;
+		case Leaving:
+		case Left:
+		case DisconnectingFromGameserver:
+		case ConnectingToMasterserver:
+		case ConnectedComingFromGameserver:
+		case AuthenticatedComingFromGameserver:
+			return ClientState::LeavingRoom;
+		case Disconnecting:
+		case Disconnected:
+			return ClientState::Disconnecting;
+		default:
+			return ClientState::Disconnected;
+		}
+	}
+
+	bool Multiplayer_Photon::isDisconnected() const
+	{
+		return getClientState() == ClientState::Disconnected;
+	}
+
+	bool Multiplayer_Photon::isConnectingToLobby() const
+	{
+		return getClientState() == ClientState::ConnectingToLobby;
 	}
 
 	bool Multiplayer_Photon::isInLobby() const
@@ -758,21 +1798,47 @@ namespace s3d
 
 		for (uint32 i = 0; i < roomList.getSize(); ++i)
 		{
-			const auto room = roomList[i];
+			results[i] = detail::ToRoomInfo(*roomList[i]);
+		}
 
-			RoomInfo roomInfo
-			{
-				.name = detail::ToString(room->getName()),
-				.playerCount = room->getPlayerCount(),
-				.maxPlayers = room->getMaxPlayers(),
-				.isOpen = room->getIsOpen(),
-				.properties = detail::PhotonHashtableToStringHashTable(room->getCustomProperties()),
-			};
+		return results;
+	}
+
+	void Multiplayer_Photon::setAutoJoinLobby(const bool enabled)
+	{
+		m_autoJoinLobby = enabled;
+	}
+
+	bool Multiplayer_Photon::requestRoomList(const LobbyQuery& query)
+	{
+		if (not m_client)
+		{
+			return false;
+		}
 
-			results[i] = std::move(roomInfo);
+		if (query.lobbyName().isEmpty())
+		{
+			log(LogLevel::Error, U"[Multiplayer_Photon] requestRoomList() requires the name of an SQL lobby");
+			return false;
 		}
 
-		return results;
+		m_lastRoomQuery = query;
+		m_nextRoomPageAfter.reset();
+
+		return m_client->opGetRoomList(detail::ToJString(query.lobbyName()), detail::ToJString(query.toSQL()));
+	}
+
+	bool Multiplayer_Photon::requestNextRoomListPage()
+	{
+		if ((not m_client) || (not m_lastRoomQuery) || (not m_nextRoomPageAfter))
+		{
+			return false;
+		}
+
+		LobbyQuery query = *m_lastRoomQuery;
+		query.after(m_nextRoomPageAfter->first, m_nextRoomPageAfter->second);
+
+		return requestRoomList(query);
 	}
 
 	Array<RoomName> Multiplayer_Photon::getRoomNameList() const
@@ -814,6 +1880,33 @@ namespace s3d
 		return m_client->getServerTimeOffset();
 	}
 
+	int64 Multiplayer_Photon::getSharedTimeMicrosec() const
+	{
+		if (not m_clockSync.stats.synchronized)
+		{
+			return 0;
+		}
+
+		const int64 localMicrosec = static_cast<int64>(Time::GetMicrosec());
+		const int64 offsetMicrosec = (m_clockSync.baseOffsetMicrosec
+			+ static_cast<int64>(std::llround(m_clockSync.drift * static_cast<double>(localMicrosec - m_clockSync.baseLocalMicrosec))));
+
+		// 推定値が過去に戻った場合も、共有時刻は巻き戻さない
+		const int64 sharedMicrosec = Max((localMicrosec + offsetMicrosec), m_clockSync.lastSharedMicrosec);
+		m_clockSync.lastSharedMicrosec = sharedMicrosec;
+		return sharedMicrosec;
+	}
+
+	ClockSyncStats Multiplayer_Photon::getClockSyncStats() const noexcept
+	{
+		return m_clockSync.stats;
+	}
+
+	void Multiplayer_Photon::setClockSyncInterval(const Milliseconds interval)
+	{
+		m_clockSync.interval = Max(interval, Milliseconds{ 50 });
+	}
+
 	int32 Multiplayer_Photon::getPingMillisec() const
 	{
 		if (not m_client)
@@ -844,24 +1937,100 @@ namespace s3d
 		return m_client->setTimePingInterval(intervalMillisec);
 	}
 
-	int32 Multiplayer_Photon::getBytesIn() const
+	uint64 Multiplayer_Photon::getBytesIn() const noexcept
 	{
-		if (not m_client)
-		{
-			return 0;
-		}
+		return m_trafficMeter.total.bytesIn;
+	}
 
-		return m_client->getBytesIn();
+	uint64 Multiplayer_Photon::getBytesOut() const noexcept
+	{
+		return m_trafficMeter.total.bytesOut;
 	}
 
-	int32 Multiplayer_Photon::getBytesOut() const
+	uint64 Multiplayer_Photon::getPacketsIn() const noexcept
 	{
-		if (not m_client)
+		return m_trafficMeter.total.packetsIn;
+	}
+
+	uint64 Multiplayer_Photon::getPacketsOut() const noexcept
+	{
+		return m_trafficMeter.total.packetsOut;
+	}
+
+	const TrafficRates& Multiplayer_Photon::getTrafficRates() const noexcept
+	{
+		return m_trafficMeter.rates;
+	}
+
+	void Multiplayer_Photon::updateTrafficMeter()
+	{
+		auto& meter = m_trafficMeter;
+
+		// Photon のカウンタは int32 で折り返すので、32 ビットの差分として積算する
+		// 折り返した場合は負の値になるため、0 以上のまま減った場合は再接続などでカウンタが 0 から数え直されたものとする
+		const auto accumulate = [](uint64& total, int32& last, const int32 current)
 		{
-			return 0;
+			if ((0 <= current) && (current < last))
+			{
+				total += static_cast<uint32>(current);
+			}
+			else
+			{
+				total += (static_cast<uint32>(current) - static_cast<uint32>(last));
+			}
+
+			last = current;
+		};
+
+		accumulate(meter.total.bytesIn, meter.lastBytesIn, m_client->getBytesIn());
+		accumulate(meter.total.bytesOut, meter.lastBytesOut, m_client->getBytesOut());
+		accumulate(meter.total.packetsIn, meter.lastPacketsIn, m_client->getTrafficStatsIncoming().getTotalPacketCount());
+		accumulate(meter.total.packetsOut, meter.lastPacketsOut, m_client->getTrafficStatsOutgoing().getTotalPacketCount());
+
+		const uint64 now = Time::GetMillisec();
+		meter.total.millisec = now;
+
+		constexpr size_t MaxSamples = detail::TrafficMeterState::MaxSamples;
+		const auto newestIndex = [&]() { return ((meter.nextSample + MaxSamples - 1) % MaxSamples); };
+
+		if (meter.samples.isEmpty() or ((meter.samples[newestIndex()].millisec + detail::TrafficMeterState::SampleIntervalMillisec) <= now))
+		{
+			if (meter.samples.size() < MaxSamples)
+			{
+				meter.samples << meter.total;
+			}
+			else
+			{
+				meter.samples[meter.nextSample] = meter.total;
+			}
+
+			meter.nextSample = ((meter.nextSample + 1) % MaxSamples);
 		}
 
-		return m_client->getBytesOut();
+		const auto rateOver = [&](const uint64 windowMillisec)
+		{
+			const size_t steps = Min<size_t>((windowMillisec / detail::TrafficMeterState::SampleIntervalMillisec), (meter.samples.size() - 1));
+			const auto& oldest = meter.samples[(newestIndex() + MaxSamples - steps) % MaxSamples];
+			const uint64 elapsedMillisec = (now - oldest.millisec);
+
+			if (elapsedMillisec == 0)
+			{
+				return TrafficRate{};
+			}
+
+			const double scale = (1000.0 / elapsedMillisec);
+
+			return TrafficRate{
+				.bytesInPerSec = ((meter.total.bytesIn - oldest.bytesIn) * scale),
+				.bytesOutPerSec = ((meter.total.bytesOut - oldest.bytesOut) * scale),
+				.packetsInPerSec = ((meter.total.packetsIn - oldest.packetsIn) * scale),
+				.packetsOutPerSec = ((meter.total.packetsOut - oldest.packetsOut) * scale),
+			};
+		};
+
+		meter.rates.last1s = rateOver(1'000);
+		meter.rates.last10s = rateOver(10'000);
+		meter.rates.last60s = rateOver(60'000);
 	}
 
 	int32 Multiplayer_Photon::getCountGamesRunning() const
@@ -924,6 +2093,22 @@ namespace s3d
 		return m_client->opJoinRandomRoom(detail::ToPhotonHashtable(propertyFilter), static_cast<uint8>(expectedMaxPlayers), static_cast<nByte>(matchmakingMode));
 	}
 
+	bool Multiplayer_Photon::joinRandomRoom(const LobbyQuery& query, const int32 expectedMaxPlayers, const MatchmakingMode matchmakingMode)
+	{
+		if (not m_client)
+		{
+			return false;
+		}
+
+		if (not InRange(expectedMaxPlayers, 0, 255))
+		{
+			return false;
+		}
+
+		return m_client->opJoinRandomRoom({}, static_cast<uint8>(expectedMaxPlayers), static_cast<nByte>(matchmakingMode),
+			detail::ToJString(query.lobbyName()), ExitGames::LoadBalancing::LobbyType::SQL_LOBBY, detail::ToJString(query.toSQL()));
+	}
+
 	bool Multiplayer_Photon::joinRandomOrCreateRoom(const int32 maxPlayers, const RoomNameView roomName)
 	{
 		if (not m_client)
@@ -982,210 +2167,3648 @@ namespace s3d
 			return false;
 		}
 
-		if (not InRange(maxPlayers, 0, 255))
+		if (not InRange(maxPlayers, 0, 255))
+		{
+			return false;
+		}
+
+		const auto roomOption = ExitGames::LoadBalancing::RoomOptions()
+			.setMaxPlayers(static_cast<uint8>(maxPlayers))
+			.setPublishUserID(true);
+
+		return m_client->opCreateRoom(detail::ToJString(roomName), roomOption);
+	}
+
+	bool Multiplayer_Photon::createRoom(RoomNameView roomName, const RoomCreateOption& option)
+	{
+		if (not m_client)
+		{
+			return false;
+		}
+
+		return m_client->opCreateRoom(detail::ToJString(roomName), detail::ToRoomOptions(option));
+	}
+
+	void Multiplayer_Photon::leaveRoom(bool willComeBack)
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		m_rejoinOnReconnect = willComeBack;
+
+		m_client->opLeaveRoom(willComeBack);
+	}
+
+	bool Multiplayer_Photon::reconnectAndRejoin()
+	{
+		if (not m_client)
+		{
+			return false;
+		}
+
+		auto state = getClientState();
+
+		if (state == ClientState::InLobby)
+		{
+			constexpr bool rejoin = true;
+			m_restoreOnRejoin = m_client->opJoinRoom(detail::ToJString(m_lastJoinedRoomName), rejoin);
+			return m_restoreOnRejoin;
+		}
+
+		if (state == ClientState::Disconnected)
+		{
+			m_restoreOnRejoin = m_client->reconnectAndRejoin();
+			return m_restoreOnRejoin;
+		}
+
+		return false;
+	}
+
+	void Multiplayer_Photon::joinEventTargetGroup(uint8 targetGroup)
+	{
+		joinEventTargetGroup(Array<uint8>{ targetGroup });
+	}
+
+	void Multiplayer_Photon::joinEventTargetGroup(const Array<uint8>& targetGroups)
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		if (targetGroups.isEmpty())
+		{
+			return;
+		}
+
+		for (const auto targetGroup : targetGroups)
+		{
+			if (not InRange(static_cast<int>(targetGroup), 1, 255)) {
+				throw Error{ U"[Multiplayer_Photon] targetGroups must be in a range of 1 to 255" };
+			}
+		}
+
+		for (const auto targetGroup : targetGroups)
+		{
+			m_eventTargetGroups[targetGroup] = true;
+		}
+
+		auto joinGroups = ExitGames::Common::JVector<nByte>(targetGroups.data(), static_cast<uint32>(targetGroups.size()));
+		m_client->opChangeGroups(nullptr, &joinGroups);
+	}
+
+	void Multiplayer_Photon::joinAllEventTargetGroups()
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		m_eventTargetGroups.fill(true);
+		m_eventTargetGroups[0] = false;
+
+		auto emptyJVector = ExitGames::Common::JVector<nByte>();
+
+		m_client->opChangeGroups(nullptr, &emptyJVector);
+	}
+
+	void Multiplayer_Photon::leaveEventTargetGroup(const uint8 targetGroup)
+	{
+		leaveEventTargetGroup(Array<uint8>{ targetGroup });
+	}
+
+	void Multiplayer_Photon::leaveEventTargetGroup(const Array<uint8>& targetGroups)
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		if (targetGroups.isEmpty())
+		{
+			return;
+		}
+
+		for (const auto targetGroup : targetGroups)
+		{
+			if (not InRange(static_cast<int>(targetGroup), 1, 255)) {
+				throw Error{ U"[Multiplayer_Photon] targetGroups must be in a range of 1 to 255" };
+			}
+		}
+
+		for (const auto targetGroup : targetGroups)
+		{
+			m_eventTargetGroups[targetGroup] = false;
+		}
+
+		// 空間インタレスト管理によって参加しているグループには、参加したままにする
+		const Array<uint8> groups = targetGroups.filter([this](const uint8 targetGroup) { return (not m_spatialInterestGroups[targetGroup]); });
+
+		if (groups.isEmpty())
+		{
+			return;
+		}
+
+		auto leaveGroups = ExitGames::Common::JVector<nByte>(groups.data(), static_cast<uint32>(groups.size()));
+		m_client->opChangeGroups(&leaveGroups, nullptr);
+	}
+
+	void Multiplayer_Photon::leaveAllEventTargetGroups()
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		m_eventTargetGroups.fill(false);
+		m_spatialInterestGroups.fill(false);
+
+		auto emptyJVector = ExitGames::Common::JVector<nByte>();
+
+		m_client->opChangeGroups(&emptyJVector, nullptr);
+	}
+
+	void Multiplayer_Photon::setSpatialInterest(const SpatialInterestOption& option)
+	{
+		leaveSpatialInterestGroups();
+
+		m_spatialInterest = option;
+	}
+
+	void Multiplayer_Photon::clearSpatialInterest()
+	{
+		leaveSpatialInterestGroups();
+
+		m_spatialInterest.reset();
+	}
+
+	void Multiplayer_Photon::setInterestPosition(const Vec2& position)
+	{
+		m_interestPosition = position;
+	}
+
+	bool Multiplayer_Photon::hasSpatialInterest() const noexcept
+	{
+		return m_spatialInterest.has_value();
+	}
+
+	TargetGroup Multiplayer_Photon::getInterestTargetGroup(const Vec2& position) const
+	{
+		if (not m_spatialInterest)
+		{
+			throw Error{ U"[Multiplayer_Photon] Spatial interest is not enabled" };
+		}
+
+		return TargetGroup{ m_spatialInterest->groupAt(position) };
+	}
+
+	Array<uint8> Multiplayer_Photon::getInterestTargetGroups() const
+	{
+		Array<uint8> results;
+
+		for (size_t i = 1; i < m_spatialInterestGroups.size(); ++i)
+		{
+			if (m_spatialInterestGroups[i])
+			{
+				results << static_cast<uint8>(i);
+			}
+		}
+
+		return results;
+	}
+
+	void Multiplayer_Photon::updateSpatialInterest()
+	{
+		if ((not m_spatialInterest) or (not m_interestPosition))
+		{
+			return;
+		}
+
+		if (not m_client->getIsInGameRoom())
+		{
+			return;
+		}
+
+		const SpatialInterestOption& option = *m_spatialInterest;
+		const Vec2 pos = *m_interestPosition;
+		const double enterDistance = option.subscribeRadius();
+		const double exitDistance = (option.subscribeRadius() + option.hysteresis());
+
+		auto& joinGroups = m_frameBuffers.joinGroups;
+		auto& leaveGroups = m_frameBuffers.leaveGroups;
+		joinGroups.clear();
+		leaveGroups.clear();
+
+		for (int32 i = 1; i <= option.num_cells(); ++i)
+		{
+			const uint8 group = static_cast<uint8>(i);
+			const RectF cell = option.cellRect(group);
+			const Vec2 nearest{ Clamp(pos.x, cell.x, (cell.x + cell.w)), Clamp(pos.y, cell.y, (cell.y + cell.h)) };
+			const double distance = pos.distanceFrom(nearest);
+
+			if (m_spatialInterestGroups[group])
+			{
+				if (exitDistance < distance)
+				{
+					leaveGroups << group;
+				}
+			}
+			else if (distance <= enterDistance)
+			{
+				joinGroups << group;
+			}
+		}
+
+		if (joinGroups.isEmpty() and leaveGroups.isEmpty())
+		{
+			return;
+		}
+
+		// joinEventTargetGroup() で参加しているグループは、サーバ上では参加したままにする
+		const Array<uint8> requestLeaveGroups = leaveGroups.filter([this](const uint8 group) { return (not m_eventTargetGroups[group]); });
+		const Array<uint8> requestJoinGroups = joinGroups.filter([this](const uint8 group) { return (not m_eventTargetGroups[group]); });
+
+		if (requestJoinGroups or requestLeaveGroups)
+		{
+			// 参加と退出を 1 回のリクエストにまとめる（nullptr は変更なし、空の JVector は全てのグループを意味する）
+			auto joinJVector = ExitGames::Common::JVector<nByte>(requestJoinGroups.data(), static_cast<uint32>(requestJoinGroups.size()));
+			auto leaveJVector = ExitGames::Common::JVector<nByte>(requestLeaveGroups.data(), static_cast<uint32>(requestLeaveGroups.size()));
+
+			// リクエストを送信できなかった場合は、次の update() でやり直す
+			if (not m_client->opChangeGroups((requestLeaveGroups.isEmpty() ? nullptr : &leaveJVector), (requestJoinGroups.isEmpty() ? nullptr : &joinJVector)))
+			{
+				return;
+			}
+		}
+
+		for (const auto group : leaveGroups)
+		{
+			m_spatialInterestGroups[group] = false;
+		}
+
+		for (const auto group : joinGroups)
+		{
+			m_spatialInterestGroups[group] = true;
+		}
+	}
+
+	void Multiplayer_Photon::leaveSpatialInterestGroups()
+	{
+		// joinEventTargetGroup() で参加しているグループからは退出しない
+		const Array<uint8> groups = getInterestTargetGroups().filter([this](const uint8 group) { return (not m_eventTargetGroups[group]); });
+
+		m_spatialInterestGroups.fill(false);
+
+		if (groups.isEmpty() or (not m_client) or (not m_client->getIsInGameRoom()))
+		{
+			return;
+		}
+
+		auto leaveJVector = ExitGames::Common::JVector<nByte>(groups.data(), static_cast<uint32>(groups.size()));
+		m_client->opChangeGroups(&leaveJVector, nullptr);
+	}
+}
+
+/// Multiplayer_Photon (log)
+namespace s3d
+{
+	namespace detail
+	{
+		bool LogRing::push(const StringView text) noexcept
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+			const size_t next = ((tail + 1) % Capacity);
+
+			if (next == m_head.load(std::memory_order_acquire))
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			auto& record = m_records[tail];
+			const size_t length = Min(text.size(), LogRecord::MaxLength);
+			std::copy_n(text.data(), length, record.text.data());
+
+			if (LogRecord::MaxLength < text.size())
+			{
+				record.text[LogRecord::MaxLength - 1] = U'…';
+			}
+
+			record.length = static_cast<uint16>(length);
+
+			m_tail.store(next, std::memory_order_release);
+			return true;
+		}
+
+		const LogRecord* LogRing::front() const noexcept
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+
+			if (head == m_tail.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+
+			return &m_records[head];
+		}
+
+		void LogRing::pop() noexcept
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+			m_head.store(((head + 1) % Capacity), std::memory_order_release);
+		}
+
+		uint64 LogRing::takeDropped() noexcept
+		{
+			return m_dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	bool Multiplayer_Photon::isLogEnabled(const LogLevel level) const noexcept
+	{
+		return (m_verbose and m_logger and (level != LogLevel::None) and (m_logLevel <= level));
+	}
+
+	LogLevel Multiplayer_Photon::getLogLevel() const noexcept
+	{
+		return m_logLevel;
+	}
+
+	void Multiplayer_Photon::setLogLevel(const LogLevel level) noexcept
+	{
+		m_logLevel = level;
+	}
+
+	void Multiplayer_Photon::flushLog() const
+	{
+		if (m_logThreadRunning.load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		drainLog();
+	}
+
+	void Multiplayer_Photon::setLogThreadEnabled(const bool enabled)
+	{
+		if (enabled == m_logThread.joinable())
+		{
+			return;
+		}
+
+		if (enabled)
+		{
+			// スレッドが動いている間にリングバッファを作成しないように、先に作成しておく
+			if (not m_logRing)
+			{
+				m_logRing = std::make_unique<detail::LogRing>();
+			}
+
+			m_logThreadRunning.store(true, std::memory_order_release);
+			m_logThread = std::thread{ [this]()
+				{
+					while (m_logThreadRunning.load(std::memory_order_acquire))
+					{
+						drainLog();
+						std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+					}
+				} };
+		}
+		else
+		{
+			m_logThreadRunning.store(false, std::memory_order_release);
+			m_logThread.join();
+		}
+	}
+
+	void Multiplayer_Photon::pushLog(const StringView text) const
+	{
+		if (not m_logger)
+		{
+			return;
+		}
+
+		if (not m_logRing)
+		{
+			m_logRing = std::make_unique<detail::LogRing>();
+		}
+
+		if (m_logThreadRunning.load(std::memory_order_acquire))
+		{
+			m_logRing->push(text);
+			return;
+		}
+
+		// 出力するスレッドが無い場合は、一杯になったら記録済みのログを出力して空ける
+		if (not m_logRing->push(text))
+		{
+			static_cast<void>(m_logRing->takeDropped());
+			drainLog();
+			m_logRing->push(text);
+		}
+	}
+
+	void Multiplayer_Photon::drainLog() const
+	{
+		if ((not m_logger) || (not m_logRing))
+		{
+			return;
+		}
+
+		while (const auto* record = m_logRing->front())
+		{
+			m_logger(StringView{ record->text.data(), record->length });
+			m_logRing->pop();
+		}
+
+		if (const uint64 dropped = m_logRing->takeDropped())
+		{
+			m_logger(U"[Multiplayer_Photon] {} log entries were dropped"_fmt(dropped));
+		}
+	}
+}
+
+/// Multiplayer_Photon (recording), MultiplayerReplay
+namespace s3d
+{
+	namespace detail
+	{
+		/// @brief 記録ファイルの先頭に書き込む識別子
+		static constexpr std::array<char, 8> RecordingMagic{ 'S', '3', 'D', 'M', 'P', 'R', 'E', 'C' };
+
+		static constexpr uint32 RecordingVersion = 1;
+
+		/// @brief レコードのヘッダのサイズ（ペイロードのサイズ 4 バイト, 時刻 8 バイト, 種類 1 バイト）
+		static constexpr int64 RecordHeaderSize = (sizeof(uint32) + sizeof(uint64) + sizeof(uint8));
+	}
+
+	bool Multiplayer_Photon::startRecording(const FilePathView path)
+	{
+		stopRecording();
+
+		if (not m_recordWriter.open(path))
+		{
+			log(LogLevel::Error, U"[Multiplayer_Photon] startRecording() failed to open ", path);
+			return false;
+		}
+
+		m_recordWriter.write(detail::RecordingMagic.data(), detail::RecordingMagic.size());
+		m_recordWriter.write(detail::RecordingVersion);
+		m_recordingBeginMicrosec = Time::GetMicrosec();
+
+		return true;
+	}
+
+	void Multiplayer_Photon::stopRecording()
+	{
+		m_recordWriter.close();
+	}
+
+	bool Multiplayer_Photon::isRecording() const noexcept
+	{
+		return m_recordWriter.isOpen();
+	}
+
+	bool Multiplayer_Photon::startTrace([[maybe_unused]] const size_t maxEvents)
+	{
+# if MULTIPLAYER_PHOTON_TRACE
+		m_trace = std::make_unique<detail::TraceBuffer>();
+		m_trace->maxEvents = maxEvents;
+		m_trace->events.reserve(Min<size_t>(maxEvents, 65536));
+		return true;
+# else
+		log(LogLevel::Warning, U"[Multiplayer_Photon] startTrace() requires MULTIPLAYER_PHOTON_TRACE to be defined as 1");
+		return false;
+# endif
+	}
+
+	bool Multiplayer_Photon::stopTrace(const FilePathView path)
+	{
+		if (not m_trace)
+		{
+			return false;
+		}
+
+		const std::unique_ptr<detail::TraceBuffer> trace = std::move(m_trace);
+
+		TextWriter writer{ path };
+
+		if (not writer)
+		{
+			log(LogLevel::Error, U"[Multiplayer_Photon] stopTrace() failed to open ", path);
+			return false;
+		}
+
+		// Trace Event Format の Complete Event (ph: "X") として書き出す
+		writer.writeln(U"{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":", trace->numDropped, U"},\"traceEvents\":[");
+
+		for (size_t i = 0; i < trace->events.size(); ++i)
+		{
+			const auto& event = trace->events[i];
+
+			writer.write(U"{\"name\":\"", event.name, U"\",\"cat\":\"Multiplayer_Photon\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":",
+				event.beginMicrosec, U",\"dur\":", event.durationMicrosec);
+
+			if (0 <= event.eventCode)
+			{
+				writer.write(U",\"args\":{\"eventCode\":", event.eventCode, U"}");
+			}
+
+			writer.writeln(((i + 1) < trace->events.size()) ? U"}," : U"}");
+		}
+
+		writer.writeln(U"]}");
+
+		return true;
+	}
+
+	bool Multiplayer_Photon::isTracing() const noexcept
+	{
+		return static_cast<bool>(m_trace);
+	}
+
+	void Multiplayer_Photon::writeRecord(const detail::RecordKind kind, const Blob& payload)
+	{
+		if (not m_recordWriter)
+		{
+			return;
+		}
+
+		m_recordWriter.write(static_cast<uint32>(payload.size()));
+		m_recordWriter.write(static_cast<uint64>(Time::GetMicrosec() - m_recordingBeginMicrosec));
+		m_recordWriter.write(FromEnum(kind));
+		m_recordWriter.write(payload.data(), static_cast<int64>(payload.size()));
+	}
+
+	MultiplayerReplay::MultiplayerReplay(const FilePathView path)
+	{
+		open(path);
+	}
+
+	bool MultiplayerReplay::open(const FilePathView path)
+	{
+		close();
+
+		if (not m_reader.open(path))
+		{
+			return false;
+		}
+
+		std::array<char, 8> magic{};
+		uint32 version = 0;
+
+		if ((m_reader.read(magic.data(), magic.size()) != static_cast<int64>(magic.size()))
+			|| (magic != detail::RecordingMagic)
+			|| (not m_reader.read(version))
+			|| (version != detail::RecordingVersion))
+		{
+			close();
+			return false;
+		}
+
+		// 記録中に終了した場合、最後のレコードは途中までしか書き込まれていないことがある
+		const int64 fileSize = m_reader.size();
+		int64 pos = m_reader.getPos();
+
+		while ((pos + detail::RecordHeaderSize) <= fileSize)
+		{
+			uint32 size = 0;
+			uint64 timeMicrosec = 0;
+			uint8 kind = 0;
+
+			m_reader.read(size);
+			m_reader.read(timeMicrosec);
+			m_reader.read(kind);
+
+			const int64 offset = (pos + detail::RecordHeaderSize);
+
+			if (fileSize < (offset + size))
+			{
+				break;
+			}
+
+			m_index << IndexEntry{ .offset = offset, .timeMicrosec = timeMicrosec, .size = size, .kind = ToEnum<detail::RecordKind>(kind) };
+
+			pos = (offset + size);
+			m_reader.setPos(pos);
+		}
+
+		return true;
+	}
+
+	void MultiplayerReplay::close()
+	{
+		m_reader.close();
+		m_index.clear();
+		m_next = 0;
+		m_positionMicrosec = 0.0;
+		m_lastUpdateMicrosec.reset();
+	}
+
+	bool MultiplayerReplay::isOpen() const noexcept
+	{
+		return m_reader.isOpen();
+	}
+
+	size_t MultiplayerReplay::num_records() const noexcept
+	{
+		return m_index.size();
+	}
+
+	uint64 MultiplayerReplay::lengthMicrosec() const noexcept
+	{
+		return (m_index.isEmpty() ? 0 : m_index.back().timeMicrosec);
+	}
+
+	uint64 MultiplayerReplay::positionMicrosec() const noexcept
+	{
+		return static_cast<uint64>(m_positionMicrosec);
+	}
+
+	bool MultiplayerReplay::isFinished() const noexcept
+	{
+		return (m_index.size() <= m_next);
+	}
+
+	void MultiplayerReplay::seek(const uint64 timeMicrosec)
+	{
+		// レコードの時刻は単調増加なので二分探索できる
+		const auto it = std::lower_bound(m_index.begin(), m_index.end(), timeMicrosec,
+			[](const IndexEntry& entry, const uint64 time) { return (entry.timeMicrosec < time); });
+
+		m_next = static_cast<size_t>(std::distance(m_index.begin(), it));
+		m_positionMicrosec = static_cast<double>(timeMicrosec);
+		m_lastUpdateMicrosec.reset();
+	}
+
+	size_t MultiplayerReplay::update(Multiplayer_Photon& target, const double speed)
+	{
+		const uint64 now = Time::GetMicrosec();
+
+		if (m_lastUpdateMicrosec)
+		{
+			m_positionMicrosec += ((now - *m_lastUpdateMicrosec) * Max(speed, 0.0));
+		}
+
+		m_lastUpdateMicrosec = now;
+
+		size_t count = 0;
+
+		while ((m_next < m_index.size()) && (m_index[m_next].timeMicrosec <= m_positionMicrosec))
+		{
+			dispatch(target, m_index[m_next++]);
+			++count;
+		}
+
+		return count;
+	}
+
+	size_t MultiplayerReplay::playUntil(Multiplayer_Photon& target, const uint64 timeMicrosec)
+	{
+		size_t count = 0;
+
+		while ((m_next < m_index.size()) && (m_index[m_next].timeMicrosec <= timeMicrosec))
+		{
+			dispatch(target, m_index[m_next++]);
+			++count;
+		}
+
+		m_positionMicrosec = Max(m_positionMicrosec, static_cast<double>(timeMicrosec));
+		m_lastUpdateMicrosec.reset();
+
+		return count;
+	}
+
+	size_t MultiplayerReplay::playAll(Multiplayer_Photon& target)
+	{
+		return playUntil(target, Largest<uint64>);
+	}
+
+	void MultiplayerReplay::dispatch(Multiplayer_Photon& target, const IndexEntry& entry)
+	{
+		m_buffer.resize(entry.size);
+		m_reader.setPos(entry.offset);
+		m_reader.read(m_buffer.data(), entry.size);
+
+		Deserializer<MemoryViewReader> reader{ m_buffer.data(), m_buffer.size() };
+
+		switch (entry.kind)
+		{
+		case detail::RecordKind::CustomEvent:
+			{
+				LocalPlayerID playerID = 0;
+				uint8 eventCode = 0;
+				reader(playerID, eventCode);
+
+				if (eventCode == detail::SystemEventCode)
+				{
+					return;
+				}
+
+				const size_t pos = static_cast<size_t>(reader->getPos());
+				const size_t size = (m_buffer.size() - pos);
+				Deserializer<MemoryViewReader> eventReader{ (m_buffer.data() + pos), size };
+
+				target.dispatchCustomEvent(playerID, eventCode, eventReader, size);
+				return;
+			}
+		case detail::RecordKind::ConnectionError:
+			{
+				int32 errorCode = 0;
+				reader(errorCode);
+				target.connectionErrorReturn(errorCode);
+				return;
+			}
+		case detail::RecordKind::Connect:
+			{
+				int32 errorCode = 0;
+				String errorString, region, cluster;
+				reader(errorCode, errorString, region, cluster);
+				target.connectReturn(errorCode, errorString, region, cluster);
+				return;
+			}
+		case detail::RecordKind::Disconnect:
+			target.disconnectReturn();
+			return;
+		case detail::RecordKind::LeaveRoom:
+			{
+				int32 errorCode = 0;
+				String errorString;
+				reader(errorCode, errorString);
+				target.leaveRoomReturn(errorCode, errorString);
+				return;
+			}
+		case detail::RecordKind::JoinRoom:
+		case detail::RecordKind::JoinRandomRoom:
+		case detail::RecordKind::CreateRoom:
+		case detail::RecordKind::JoinOrCreateRoom:
+		case detail::RecordKind::JoinRandomOrCreateRoom:
+			{
+				LocalPlayerID playerID = 0;
+				int32 errorCode = 0;
+				String errorString;
+				reader(playerID, errorCode, errorString);
+
+				switch (entry.kind)
+				{
+				case detail::RecordKind::JoinRoom:
+					target.joinRoomReturn(playerID, errorCode, errorString);
+					break;
+				case detail::RecordKind::JoinRandomRoom:
+					target.joinRandomRoomReturn(playerID, errorCode, errorString);
+					break;
+				case detail::RecordKind::CreateRoom:
+					target.createRoomReturn(playerID, errorCode, errorString);
+					break;
+				case detail::RecordKind::JoinOrCreateRoom:
+					target.joinOrCreateRoomReturn(playerID, errorCode, errorString);
+					break;
+				default:
+					target.joinRandomOrCreateRoomReturn(playerID, errorCode, errorString);
+					break;
+				}
+				return;
+			}
+		case detail::RecordKind::JoinRoomEvent:
+			{
+				LocalPlayer player;
+				Array<LocalPlayerID> playerIDs;
+				bool isSelf = false;
+				reader(player.localID, player.userName, player.userID, player.isHost, player.isActive, playerIDs, isSelf);
+				target.joinRoomEventAction(player, playerIDs, isSelf);
+				return;
+			}
+		case detail::RecordKind::LeaveRoomEvent:
+			{
+				LocalPlayerID playerID = 0;
+				bool isInactive = false;
+				reader(playerID, isInactive);
+				target.leaveRoomEventAction(playerID, isInactive);
+				return;
+			}
+		case detail::RecordKind::RoomListUpdate:
+			target.onRoomListUpdate();
+			return;
+		case detail::RecordKind::RoomPropertiesChange:
+			{
+				Array<uint8> keys;
+				Array<String> values;
+				reader(keys, values);
+
+				RoomPropertyTable changes;
+
+				for (size_t i = 0; i < Min(keys.size(), values.size()); ++i)
+				{
+					changes.emplace(keys[i], values[i]);
+				}
+
+				target.onRoomPropertiesChange(changes);
+				return;
+			}
+		case detail::RecordKind::HostChange:
+			{
+				LocalPlayerID newHostPlayerID = 0, oldHostPlayerID = 0;
+				reader(newHostPlayerID, oldHostPlayerID);
+				target.onHostChange(newHostPlayerID, oldHostPlayerID);
+				return;
+			}
+		case detail::RecordKind::RoomListResponse:
+			target.onRoomListResponse(detail::ReadRoomInfoList(reader));
+			return;
+		}
+	}
+}
+
+/// Multiplayer_Photon::sendEvent
+namespace s3d
+{
+	namespace detail
+	{
+		void FrameBuffers::clear()
+		{
+			sendWriter->clear();
+			packedWriter.clear();
+			packedBuffer.clear();
+			playerIDs.clear();
+			properties.clear();
+			joinGroups.clear();
+			leaveGroups.clear();
+		}
+
+		[[nodiscard]]
+		static ExitGames::LoadBalancing::RaiseEventOptions MakeRaiseEventOptions(const Optional<Array<LocalPlayerID>>& targets)
+		{
+			ExitGames::LoadBalancing::RaiseEventOptions options{};
+
+			if (targets)
+			{
+				options.setTargetPlayers(targets->data(), static_cast<short>(targets->size()));
+			}
+
+			return options;
+		}
+
+		[[nodiscard]]
+		static ExitGames::LoadBalancing::RaiseEventOptions MakeRaiseEventOptions(const MultiplayerEvent& eventInfo)
+		{
+			uint8 receiver = ExitGames::Lite::ReceiverGroup::OTHERS;
+			uint8 caching = ExitGames::Lite::EventCache::DO_NOT_CACHE;
+
+			switch (eventInfo.receiverOption())
+			{
+			case ReceiverOption::Others:
+				break;
+			case ReceiverOption::Others_CacheUntilLeaveRoom:
+				caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE;
+				break;
+			case ReceiverOption::Others_CacheForever:
+				caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE_GLOBAL;
+				break;
+			case ReceiverOption::All:
+				receiver = ExitGames::Lite::ReceiverGroup::ALL;
+				break;
+			case ReceiverOption::All_CacheUntilLeaveRoom:
+				receiver = ExitGames::Lite::ReceiverGroup::ALL;
+				caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE;
+				break;
+			case ReceiverOption::All_CacheForever:
+				receiver = ExitGames::Lite::ReceiverGroup::ALL;
+				caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE_GLOBAL;
+				break;
+			case ReceiverOption::Host:
+				receiver = ExitGames::Lite::ReceiverGroup::MASTER_CLIENT;
+				break;
+			}
+
+			return MakeRaiseEventOptions(eventInfo.targetList())
+				.setChannelID(eventInfo.priorityIndex())
+				.setInterestGroup(eventInfo.targetGroup())
+				.setReceiverGroup(receiver)
+				.setEventCaching(caching);
+		}
+	}
+
+	static constexpr bool Reliable = true;
+
+	void Multiplayer_Photon::sendEvent(const MultiplayerEvent& eventInfo, const Serializer<MemoryWriter>& writer)
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		// ルームに再参加するまで保持する
+		if (isReconnecting() && m_rejoinOnReconnect && (not m_client->getIsInGameRoom()))
+		{
+			auto& outbox = m_autoReconnect->outbox;
+
+			if (m_autoReconnect->option.outboxCapacity <= outbox.size())
+			{
+				if (outbox.isEmpty())
+				{
+					++m_autoReconnect->droppedEvents;
+					return;
+				}
+
+				outbox.pop_front();
+				++m_autoReconnect->droppedEvents;
+			}
+
+			outbox.push_back(detail::PendingEvent{ eventInfo, writer->getBlob() });
+			return;
+		}
+
+		submitEvent(eventInfo, writer->getBlob());
+	}
+
+	void Multiplayer_Photon::raiseEvent(const MultiplayerEvent& eventInfo, const Blob& blob)
+	{
+		const auto eventOptions = detail::MakeRaiseEventOptions(eventInfo);
+
+		const size_t size = blob.size();
+		const uint8* src = static_cast<const uint8*>(static_cast<const void*>(blob.data()));
+
+		auto& counters = (*m_eventTraffic)[eventInfo.eventCode()];
+		counters.sentCount.fetch_add(1, std::memory_order_relaxed);
+		counters.sentBytes.fetch_add(size, std::memory_order_relaxed);
+
+		m_client->opRaiseEvent(Reliable, src, static_cast<unsigned int>(size), eventInfo.eventCode(), eventOptions);
+	}
+
+	void Multiplayer_Photon::sendSystemEvent(const Serializer<MemoryWriter>& writer, const Array<LocalPlayerID>& targets, const uint8 priorityIndex)
+	{
+		if (not m_client)
+		{
+			return;
+		}
+
+		const auto eventOptions = (targets.isEmpty() ? detail::MakeRaiseEventOptions(none) : detail::MakeRaiseEventOptions(targets))
+			.setChannelID(priorityIndex);
+
+		const auto& blob = writer->getBlob();
+		const uint8* src = static_cast<const uint8*>(static_cast<const void*>(blob.data()));
+
+		auto& counters = (*m_eventTraffic)[detail::SystemEventCode];
+		counters.sentCount.fetch_add(1, std::memory_order_relaxed);
+		counters.sentBytes.fetch_add(blob.size(), std::memory_order_relaxed);
+
+		m_client->opRaiseEvent(Reliable, src, static_cast<unsigned int>(blob.size()), detail::SystemEventCode, eventOptions);
+	}
+
+	Array<EventTrafficStats> Multiplayer_Photon::getEventTrafficStats() const
+	{
+		Array<EventTrafficStats> results;
+
+		for (size_t i = 0; i < m_eventTraffic->size(); ++i)
+		{
+			const auto& counters = (*m_eventTraffic)[i];
+
+			const EventTrafficStats stats
+			{
+				.eventCode = static_cast<uint8>(i),
+				.sentCount = counters.sentCount.load(std::memory_order_relaxed),
+				.receivedCount = counters.receivedCount.load(std::memory_order_relaxed),
+				.sentBytes = counters.sentBytes.load(std::memory_order_relaxed),
+				.receivedBytes = counters.receivedBytes.load(std::memory_order_relaxed),
+				.serializeMicrosec = counters.serializeMicrosec.load(std::memory_order_relaxed),
+				.deserializeMicrosec = counters.deserializeMicrosec.load(std::memory_order_relaxed),
+				.callbackMicrosec = counters.callbackMicrosec.load(std::memory_order_relaxed),
+				.droppedCount = counters.droppedCount.load(std::memory_order_relaxed),
+			};
+
+			if (stats.sentCount or stats.receivedCount or stats.droppedCount)
+			{
+				results << stats;
+			}
+		}
+
+		return results;
+	}
+
+	void Multiplayer_Photon::resetEventTrafficStats()
+	{
+		for (auto& counters : *m_eventTraffic)
+		{
+			counters.sentCount.store(0, std::memory_order_relaxed);
+			counters.receivedCount.store(0, std::memory_order_relaxed);
+			counters.sentBytes.store(0, std::memory_order_relaxed);
+			counters.receivedBytes.store(0, std::memory_order_relaxed);
+			counters.serializeMicrosec.store(0, std::memory_order_relaxed);
+			counters.deserializeMicrosec.store(0, std::memory_order_relaxed);
+			counters.callbackMicrosec.store(0, std::memory_order_relaxed);
+			counters.droppedCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Multiplayer_Photon::setEventTrafficReportInterval(const Milliseconds interval)
+	{
+		m_eventTrafficReportInterval = Max(interval, Milliseconds{ 0 });
+		m_lastEventTrafficReportMillisec = Time::GetMillisec();
+	}
+
+	namespace detail
+	{
+		void ReceiveQueue::setCapacity(const size_t capacity)
+		{
+			m_capacity = capacity;
+
+			// 破棄されたイベントを詰めるときに、少なくとも容量分の空きができるようにする
+			reserveSlots(capacity * 2);
+		}
+
+		ReceiveQueue::PushResult ReceiveQueue::push(const LocalPlayerID playerID, const uint8 eventCode, const ReceivePolicy policy, const uint8* data, const size_t size, uint8& droppedEventCode)
+		{
+			const uint64 key = LatestKey(playerID, eventCode);
+
+			if (policy == ReceivePolicy::KeepLatest)
+			{
+				if (auto it = m_latest.find(key); it != m_latest.end())
+				{
+					if (ReceivedEvent* pending = find(it->second))
+					{
+						pending->data.create(data, size);
+						return PushResult::Replaced;
+					}
+				}
+			}
+
+			PushResult result = PushResult::Queued;
+
+			if (isFull())
+			{
+				ReceivedEvent* oldest = nullptr;
+
+				for (size_t i = 0; i < m_count; ++i)
+				{
+					ReceivedEvent& entry = m_slots[(m_head + i) % m_slots.size()];
+
+					if ((not entry.dropped) && (entry.policy != ReceivePolicy::NeverDrop))
+					{
+						oldest = &entry;
+						break;
+					}
+				}
+
+				if (oldest)
+				{
+					if (oldest->policy == ReceivePolicy::KeepLatest)
+					{
+						m_latest.erase(LatestKey(oldest->playerID, oldest->eventCode));
+					}
+
+					oldest->dropped = true;
+					--m_live;
+					droppedEventCode = oldest->eventCode;
+					result = PushResult::DroppedOldest;
+				}
+				else if (policy != ReceivePolicy::NeverDrop)
+				{
+					return PushResult::DroppedIncoming;
+				}
+
+				// ReceivePolicy::NeverDrop のイベントは容量を超えてもキューに入れるが、上限を超えた場合は破棄する
+				if ((m_capacity * MaxOverflowFactor) <= m_live)
+				{
+					return PushResult::DroppedIncoming;
+				}
+			}
+
+			if (m_count == m_slots.size())
+			{
+				if (m_live < m_count)
+				{
+					// 破棄されたイベントを詰める（バッファを使い回すために入れ替える）
+					size_t dst = 0;
+
+					for (size_t i = 0; i < m_count; ++i)
+					{
+						ReceivedEvent& entry = m_slots[(m_head + i) % m_slots.size()];
+
+						if (not entry.dropped)
+						{
+							std::swap(m_slots[(m_head + dst) % m_slots.size()], entry);
+							++dst;
+						}
+					}
+
+					m_count = dst;
+				}
+				else
+				{
+					reserveSlots(Max<size_t>((m_slots.size() * 2), 16));
+				}
+			}
+
+			ReceivedEvent& entry = m_slots[(m_head + m_count) % m_slots.size()];
+			entry.sequence = m_nextSequence++;
+			entry.playerID = playerID;
+			entry.eventCode = eventCode;
+			entry.policy = policy;
+			entry.dropped = false;
+			entry.data.create(data, size);
+
+			++m_count;
+			++m_live;
+
+			if (policy == ReceivePolicy::KeepLatest)
+			{
+				m_latest[key] = entry.sequence;
+			}
+
+			return result;
+		}
+
+		bool ReceiveQueue::pop(LocalPlayerID& playerID, uint8& eventCode, Blob& data)
+		{
+			while (m_count)
+			{
+				ReceivedEvent& entry = m_slots[m_head];
+				m_head = ((m_head + 1) % m_slots.size());
+				--m_count;
+
+				if (entry.dropped)
+				{
+					continue;
+				}
+
+				--m_live;
+
+				if (entry.policy == ReceivePolicy::KeepLatest)
+				{
+					m_latest.erase(LatestKey(entry.playerID, entry.eventCode));
+				}
+
+				playerID = entry.playerID;
+				eventCode = entry.eventCode;
+				std::swap(data, entry.data);
+				return true;
+			}
+
+			return false;
+		}
+
+		bool ReceiveQueue::popFrom(const LocalPlayerID playerID, uint8& eventCode, Blob& data)
+		{
+			for (size_t i = 0; i < m_count; ++i)
+			{
+				ReceivedEvent& entry = m_slots[(m_head + i) % m_slots.size()];
+
+				if (entry.dropped || (entry.playerID != playerID))
+				{
+					continue;
+				}
+
+				// 取り出した要素は、破棄された要素として後で詰める
+				entry.dropped = true;
+				--m_live;
+
+				if (entry.policy == ReceivePolicy::KeepLatest)
+				{
+					m_latest.erase(LatestKey(entry.playerID, entry.eventCode));
+				}
+
+				eventCode = entry.eventCode;
+				std::swap(data, entry.data);
+				return true;
+			}
+
+			return false;
+		}
+
+		void ReceiveQueue::clear()
+		{
+			m_head = 0;
+			m_count = 0;
+			m_live = 0;
+			m_latest.clear();
+		}
+
+		size_t ReceiveQueue::size() const noexcept
+		{
+			return m_live;
+		}
+
+		bool ReceiveQueue::isFull() const noexcept
+		{
+			return (m_capacity <= m_live);
+		}
+
+		ReceivedEvent* ReceiveQueue::find(const uint64 sequence) noexcept
+		{
+			// キューの中の sequence は昇順に並んでいる
+			size_t first = 0;
+			size_t last = m_count;
+
+			while (first < last)
+			{
+				const size_t mid = ((first + last) / 2);
+
+				if (m_slots[(m_head + mid) % m_slots.size()].sequence < sequence)
+				{
+					first = (mid + 1);
+				}
+				else
+				{
+					last = mid;
+				}
+			}
+
+			if (first == m_count)
+			{
+				return nullptr;
+			}
+
+			ReceivedEvent& entry = m_slots[(m_head + first) % m_slots.size()];
+
+			if ((entry.sequence != sequence) || entry.dropped)
+			{
+				return nullptr;
+			}
+
+			return &entry;
+		}
+
+		void ReceiveQueue::reserveSlots(const size_t numSlots)
+		{
+			if (numSlots <= m_slots.size())
+			{
+				return;
+			}
+
+			Array<ReceivedEvent> slots(numSlots);
+
+			for (size_t i = 0; i < m_count; ++i)
+			{
+				slots[i] = std::move(m_slots[(m_head + i) % m_slots.size()]);
+			}
+
+			m_slots = std::move(slots);
+			m_head = 0;
+		}
+
+		uint64 ReceiveQueue::LatestKey(const LocalPlayerID playerID, const uint8 eventCode) noexcept
+		{
+			return ((static_cast<uint64>(static_cast<uint32>(playerID)) << 8) | eventCode);
+		}
+	}
+
+	void Multiplayer_Photon::enableReceiveQueue(const size_t capacity, const Microseconds dispatchBudget)
+	{
+		if (capacity == 0)
+		{
+			throw Error{ U"[Multiplayer_Photon] capacity must be greater than 0" };
+		}
+
+		if (not m_receiveQueue)
+		{
+			m_receiveQueue.emplace();
+		}
+
+		m_receiveQueue->queue.setCapacity(capacity);
+		m_receiveQueue->dispatchBudget = Max(dispatchBudget, Microseconds{ 0 });
+	}
+
+	void Multiplayer_Photon::disableReceiveQueue()
+	{
+		if (not m_receiveQueue)
+		{
+			return;
+		}
+
+		dispatchReceiveQueue(true);
+
+		m_receiveQueue.reset();
+	}
+
+	bool Multiplayer_Photon::hasReceiveQueue() const noexcept
+	{
+		return m_receiveQueue.has_value();
+	}
+
+	void Multiplayer_Photon::setReceivePolicy(const uint8 eventCode, const ReceivePolicy policy)
+	{
+		m_receivePolicies[eventCode] = policy;
+	}
+
+	ReceivePolicy Multiplayer_Photon::getReceivePolicy(const uint8 eventCode) const noexcept
+	{
+		return m_receivePolicies[eventCode];
+	}
+
+	ReceiveQueueStats Multiplayer_Photon::getReceiveQueueStats() const noexcept
+	{
+		if (not m_receiveQueue)
+		{
+			return{};
+		}
+
+		ReceiveQueueStats stats = m_receiveQueue->stats;
+		stats.queued = m_receiveQueue->queue.size();
+		return stats;
+	}
+
+	void Multiplayer_Photon::enqueueReceivedEvent(const LocalPlayerID playerID, const uint8 eventCode, const uint8* data, const size_t size)
+	{
+		auto& state = *m_receiveQueue;
+		uint8 droppedEventCode = 0;
+
+		switch (state.queue.push(playerID, eventCode, m_receivePolicies[eventCode], data, size, droppedEventCode))
+		{
+		case detail::ReceiveQueue::PushResult::Queued:
+			break;
+		case detail::ReceiveQueue::PushResult::Replaced:
+			++state.stats.replacedEvents;
+			(*m_eventTraffic)[eventCode].droppedCount.fetch_add(1, std::memory_order_relaxed);
+			break;
+		case detail::ReceiveQueue::PushResult::DroppedOldest:
+			++state.stats.droppedEvents;
+			(*m_eventTraffic)[droppedEventCode].droppedCount.fetch_add(1, std::memory_order_relaxed);
+			break;
+		case detail::ReceiveQueue::PushResult::DroppedIncoming:
+			++state.stats.droppedEvents;
+			(*m_eventTraffic)[eventCode].droppedCount.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+
+		state.stats.peakQueued = Max(state.stats.peakQueued, state.queue.size());
+	}
+
+	void Multiplayer_Photon::dispatchReceiveQueue(const bool all)
+	{
+		if (not m_receiveQueue)
+		{
+			return;
+		}
+
+		const uint64 dispatchBegin = Time::GetMicrosec();
+		const uint64 budget = static_cast<uint64>(m_receiveQueue->dispatchBudget.count());
+
+		LocalPlayerID playerID = 0;
+		uint8 eventCode = 0;
+
+		// 少なくとも 1 件は処理する
+		do
+		{
+			if (not m_receiveQueue->queue.pop(playerID, eventCode, m_receivedEventData))
+			{
+				return;
+			}
+
+			Deserializer<MemoryViewReader> reader{ m_receivedEventData.data(), m_receivedEventData.size() };
+
+			dispatchCustomEvent(playerID, eventCode, reader, m_receivedEventData.size());
+
+			// コールバックの中で受信キューが無効にされた場合
+			if (not m_receiveQueue)
+			{
+				return;
+			}
+		} while (all || ((Time::GetMicrosec() - dispatchBegin) < budget));
+
+		if (m_receiveQueue->queue.size())
+		{
+			++m_receiveQueue->stats.deferredUpdates;
+		}
+	}
+
+	void Multiplayer_Photon::dispatchReceivedEventsFrom(const LocalPlayerID playerID)
+	{
+		uint8 eventCode = 0;
+
+		while (m_receiveQueue && m_receiveQueue->queue.popFrom(playerID, eventCode, m_receivedEventData))
+		{
+			Deserializer<MemoryViewReader> reader{ m_receivedEventData.data(), m_receivedEventData.size() };
+
+			dispatchCustomEvent(playerID, eventCode, reader, m_receivedEventData.size());
+		}
+	}
+
+	void Multiplayer_Photon::receiveCustomEvent(const LocalPlayerID playerID, const uint8 eventCode, const uint8* data, const size_t size)
+	{
+		if (isRecording() && (eventCode != detail::SystemEventCode))
+		{
+			Serializer<MemoryWriter> writer;
+			writer(playerID, eventCode);
+			writer->write(data, size);
+			writeRecord(detail::RecordKind::CustomEvent, writer->getBlob());
+		}
+
+		// ライブラリ内部で使うイベントは受信キューに入れない
+		if (m_receiveQueue && (eventCode != detail::SystemEventCode))
+		{
+			enqueueReceivedEvent(playerID, eventCode, data, size);
+			return;
+		}
+
+		Deserializer<MemoryViewReader> reader{ data, size };
+
+		dispatchCustomEvent(playerID, eventCode, reader, size);
+	}
+
+	void Multiplayer_Photon::dispatchCustomEvent(const LocalPlayerID playerID, const uint8 eventCode, Deserializer<MemoryViewReader>& reader, const size_t size)
+	{
+		auto& counters = (*m_eventTraffic)[eventCode];
+		counters.receivedCount.fetch_add(1, std::memory_order_relaxed);
+		counters.receivedBytes.fetch_add(size, std::memory_order_relaxed);
+
+		MULTIPLAYER_PHOTON_TRACE_SCOPE(m_trace.get(), U"dispatch", eventCode);
+
+		const uint64 dispatchBegin = Time::GetMicrosec();
+		m_lastDeserializeMicrosec = 0;
+
+		if (eventCode == detail::SystemEventCode)
+		{
+			onSystemEvent(playerID, reader);
+		}
+		else if (m_table && (eventCode < m_table->size()) && (*m_table)[eventCode].second) {
+			const auto& receiver = (*m_table)[eventCode];
+			(receiver.second)(*this, receiver.first, playerID, eventCode, reader);
+		}
+		else {
+			debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::customEventAction(Deserializer<MemoryReader>) playerID: ", playerID, U", eventCode: ", eventCode, U", data: ", size, U" bytes (serialized)");
+
+			MULTIPLAYER_PHOTON_TRACE_SCOPE(m_trace.get(), U"callback", eventCode);
+			customEventAction(playerID, eventCode, reader);
+		}
+
+		// 登録されたコールバックの場合、デシリアライズの時間は EventWrapperImpl が記録する
+		const uint64 dispatchMicrosec = (Time::GetMicrosec() - dispatchBegin);
+		m_updateCallbackMicrosec += dispatchMicrosec;
+		const uint64 deserializeMicrosec = Min(m_lastDeserializeMicrosec, dispatchMicrosec);
+		counters.deserializeMicrosec.fetch_add(deserializeMicrosec, std::memory_order_relaxed);
+		counters.callbackMicrosec.fetch_add((dispatchMicrosec - deserializeMicrosec), std::memory_order_relaxed);
+	}
+
+	void Multiplayer_Photon::onSystemEvent(const LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader)
+	{
+		uint8 type = 0;
+		reader(type);
+
+		switch (ToEnum<detail::SystemEvent>(type))
+		{
+		case detail::SystemEvent::HostCheckpoint:
+			{
+				// ホスト以外のプレイヤーから届いたチェックポイントは無視する
+				if ((not m_hostMigration) or (playerID != getHostLocalPlayerID()))
+				{
+					return;
+				}
+
+				uint32 sequence = 0;
+				bool compressed = false;
+				reader(sequence, compressed);
+
+				// 古いチェックポイントが後から届いた場合は無視する
+				if ((m_hostMigration->checkpointHost == playerID) and (sequence <= m_hostMigration->checkpointSequence))
+				{
+					return;
+				}
+
+				m_hostMigration->checkpoint = detail::ReadRemaining(reader);
+				m_hostMigration->checkpointCompressed = compressed;
+				m_hostMigration->checkpointSequence = sequence;
+				m_hostMigration->checkpointHost = playerID;
+				m_hostMigration->successor = getLocalPlayerID();
+				return;
+			}
+		case detail::SystemEvent::HostSuccessor:
+			{
+				// 後継者を指名できるのはホストだけ
+				if ((not m_hostMigration) or (playerID != getHostLocalPlayerID()))
+				{
+					return;
+				}
+
+				LocalPlayerID successor = -1;
+				reader(successor);
+				m_hostMigration->successor = successor;
+
+				if (successor != getLocalPlayerID())
+				{
+					m_hostMigration->checkpoint.clear();
+					m_hostMigration->checkpointHost = -1;
+				}
+				return;
+			}
+		case detail::SystemEvent::JoinSnapshot:
+			receiveJoinSnapshotChunk(playerID, reader);
+			return;
+		case detail::SystemEvent::StreamChunk:
+			receiveStreamChunk(playerID, reader);
+			return;
+		case detail::SystemEvent::StreamAck:
+			receiveStreamAck(playerID, reader);
+			return;
+		case detail::SystemEvent::StreamCancel:
+			receiveStreamCancel(playerID, reader);
+			return;
+		default:
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Unknown system event: ", type);
+			return;
+		}
+	}
+}
+
+/// Multiplayer_Photon (clock sync)
+namespace s3d
+{
+	namespace detail
+	{
+		/// @brief ドリフトの推定に必要なサンプルの時間幅（マイクロ秒）
+		static constexpr int64 MinDriftSpanMicrosec = 5'000'000;
+
+		/// @brief 推定するドリフトの上限
+		static constexpr double MaxDrift = 500e-6;
+
+		[[nodiscard]]
+		static int64 Median(Array<int64> values)
+		{
+			const size_t mid = (values.size() / 2);
+			std::nth_element(values.begin(), (values.begin() + mid), values.end());
+			return values[mid];
+		}
+
+		/// @brief NTP のクロックフィルタのように、RTT の大きいサンプルと外れ値を除外してオフセットとドリフトを推定します。
+		static void EstimateClock(ClockSyncState& state)
+		{
+			const ClockSample& newest = state.samples[(state.nextSample + ClockSyncState::MaxSamples - 1) % ClockSyncState::MaxSamples];
+
+			int32 minRoundTrip = Largest<int32>;
+
+			for (size_t i = 0; i < state.numSamples; ++i)
+			{
+				minRoundTrip = Min(minRoundTrip, state.samples[i].roundTripMillisec);
+			}
+
+			// RTT が最小値に近いサンプルほどオフセットの誤差が小さい
+			const int32 roundTripLimit = (minRoundTrip + Max(2, (minRoundTrip / 2)));
+
+			Array<ClockSample> candidates(Arg::reserve = state.numSamples);
+
+			for (size_t i = 0; i < state.numSamples; ++i)
+			{
+				if (state.samples[i].roundTripMillisec <= roundTripLimit)
+				{
+					candidates << state.samples[i];
+				}
+			}
+
+			// 中央値からの偏差が大きいサンプルを外れ値として除外する（サーバ時刻の 1ms の量子化誤差は許容する）
+			const int64 median = Median(candidates.map([](const ClockSample& sample) { return sample.offsetMicrosec; }));
+			const int64 mad = Median(candidates.map([=](const ClockSample& sample) { return Abs(sample.offsetMicrosec - median); }));
+			const int64 threshold = ((3 * mad) + 1000);
+
+			candidates.remove_if([=](const ClockSample& sample) { return (threshold < Abs(sample.offsetMicrosec - median)); });
+
+			const bool newestAccepted = candidates.any([&](const ClockSample& sample) { return (sample.localMicrosec == newest.localMicrosec); });
+
+			if (not newestAccepted)
+			{
+				++state.stats.numRejected;
+			}
+
+			// 残ったサンプルに直線をあてはめ、オフセットとドリフトを求める
+			const double n = static_cast<double>(candidates.size());
+			double meanLocal = 0.0, meanOffset = 0.0;
+
+			for (const auto& sample : candidates)
+			{
+				meanLocal += (static_cast<double>(sample.localMicrosec - newest.localMicrosec) / n);
+				meanOffset += (static_cast<double>(sample.offsetMicrosec - median) / n);
+			}
+
+			double covariance = 0.0, variance = 0.0;
+			int64 minLocal = Largest<int64>, maxLocal = Smallest<int64>;
+
+			for (const auto& sample : candidates)
+			{
+				const double dx = (static_cast<double>(sample.localMicrosec - newest.localMicrosec) - meanLocal);
+				const double dy = (static_cast<double>(sample.offsetMicrosec - median) - meanOffset);
+				covariance += (dx * dy);
+				variance += (dx * dx);
+				minLocal = Min(minLocal, sample.localMicrosec);
+				maxLocal = Max(maxLocal, sample.localMicrosec);
+			}
+
+			double drift = 0.0;
+
+			if ((4 <= candidates.size()) && (MinDriftSpanMicrosec <= (maxLocal - minLocal)) && (0.0 < variance))
+			{
+				drift = Clamp((covariance / variance), -MaxDrift, MaxDrift);
+			}
+
+			state.baseLocalMicrosec = (newest.localMicrosec + static_cast<int64>(std::llround(meanLocal)));
+			state.baseOffsetMicrosec = (median + static_cast<int64>(std::llround(meanOffset)));
+			state.drift = drift;
+
+			state.stats.offsetMicrosec = state.baseOffsetMicrosec;
+			state.stats.driftPPM = (drift * 1e6);
+			state.stats.minRoundTripMillisec = minRoundTrip;
+			state.stats.jitterMicrosec = mad;
+			state.stats.numSamples = state.numSamples;
+			state.stats.synchronized = true;
+		}
+
+		[[nodiscard]]
+		static ClockServer GetClockServer(const int peerState) noexcept
+		{
+			using namespace ExitGames::LoadBalancing::PeerStates;
+
+			switch (peerState) {
+			case ConnectedToNameserver:
+				return ClockServer::NameServer;
+			case Connected:
+			case WaitingForCustomAuthenticationNextStepCall:
+			case Authenticated:
+			case JoinedLobby:
+			case ConnectedComingFromGameserver:
+			case AuthenticatedComingFromGameserver:
+				return ClockServer::MasterServer;
+			case ConnectedToGameserver:
+			case AuthenticatedOnGameServer:
+			case Joining:
+			case Joined:
+			case Leaving:
+			case Left:
+				return ClockServer::GameServer;
+			default:
+				return ClockServer::None;
+			}
+		}
+
+		/// @brief サンプルを破棄して、サーバ時刻の同期をやり直します。
+		/// @param reanchor 共有時刻を新しいサーバの時刻に合わせ直す（巻き戻しを許す）場合 true
+		static void ResetClockSamples(ClockSyncState& state, const bool reanchor)
+		{
+			state.samples = {};
+			state.numSamples = 0;
+			state.nextSample = 0;
+			state.lastServerTimeOffset.reset();
+			state.lastServerTime = 0;
+			state.serverTime64 = 0;
+			state.requestMicrosec.reset();
+
+			// すぐに新しいサーバのタイムスタンプを要求する
+			state.lastRequestMillisec = 0;
+
+			if (reanchor)
+			{
+				state.stats.synchronized = false;
+				state.lastSharedMicrosec = 0;
+			}
+		}
+	}
+
+	void Multiplayer_Photon::updateClockSync()
+	{
+		const ClientState clientState = getClientState();
+
+		if ((clientState == ClientState::Disconnected) or (clientState == ClientState::Disconnecting))
+		{
+			return;
+		}
+
+		auto& state = m_clockSync;
+		const detail::ClockServer server = detail::GetClockServer(m_client->getState());
+
+		// サーバを切り替えている途中は、どちらのサーバの時刻かわからない
+		if (server == detail::ClockServer::None)
+		{
+			return;
+		}
+
+		// サーバごとに時刻の基準が異なるので、切り替わったら同期し直す
+		if (state.server != server)
+		{
+			// 接続した直後は、前の接続の共有時刻から巻き戻さない
+			const bool reanchor = (state.server != detail::ClockServer::None);
+			detail::ResetClockSamples(state, reanchor);
+			state.staleServerTimeOffset = m_client->getServerTimeOffset();
+			state.server = server;
+		}
+
+		const uint64 now = Time::GetMillisec();
+
+		if ((state.lastRequestMillisec + static_cast<uint64>(state.interval.count())) <= now)
+		{
+			m_client->fetchServerTimestamp();
+			state.lastRequestMillisec = now;
+			state.requestMicrosec = static_cast<int64>(Time::GetMicrosec());
+		}
+
+		const int32 serverTimeOffset = m_client->getServerTimeOffset();
+
+		// 最初のタイムスタンプを受信するまではオフセットが 0 のまま
+		if ((not state.lastServerTimeOffset) and (serverTimeOffset == 0))
+		{
+			return;
+		}
+
+		// 前のサーバのオフセットが残っている間はサンプルにしない
+		if (state.staleServerTimeOffset)
+		{
+			if (*state.staleServerTimeOffset == serverTimeOffset)
+			{
+				return;
+			}
+
+			state.staleServerTimeOffset.reset();
+		}
+
+		// 同じサーバでもオフセットが大きく変わった場合は、時刻の基準が変わったとみなす
+		if (state.lastServerTimeOffset
+			and (detail::ClockSyncState::MaxOffsetJumpMillisec < Abs(static_cast<int64>(serverTimeOffset) - *state.lastServerTimeOffset)))
+		{
+			const Optional<int64> requestMicrosec = state.requestMicrosec;
+			detail::ResetClockSamples(state, true);
+			state.requestMicrosec = requestMicrosec;
+		}
+
+		const int32 serverTime = m_client->getServerTime();
+		const int64 localMicrosec = static_cast<int64>(Time::GetMicrosec());
+
+		// 32 ビットのサーバ時刻を 64 ビットに拡張する
+		if (not state.lastServerTimeOffset)
+		{
+			state.serverTime64 = static_cast<uint32>(serverTime);
+		}
+		else
+		{
+			state.serverTime64 += static_cast<int32>(static_cast<uint32>(serverTime) - static_cast<uint32>(state.lastServerTime));
+		}
+
+		state.lastServerTime = serverTime;
+
+		// オフセットはタイムスタンプを受信したときにだけ更新される
+		if (state.lastServerTimeOffset == serverTimeOffset)
+		{
+			return;
+		}
+
+		state.lastServerTimeOffset = serverTimeOffset;
+
+		// 要求を送信していないのに変わった場合は、その応答の RTT がわからないのでサンプルにしない
+		if (not state.requestMicrosec)
+		{
+			return;
+		}
+
+		// RTT は、この応答を得た要求を送信してからの時間（フレームの間隔の分だけ大きく見積もる）
+		const int32 roundTripMillisec = static_cast<int32>((localMicrosec - *state.requestMicrosec) / 1000);
+		state.requestMicrosec.reset();
+
+		state.samples[state.nextSample] = detail::ClockSample{
+			.localMicrosec = localMicrosec,
+			.offsetMicrosec = ((state.serverTime64 * 1000) - localMicrosec),
+			.roundTripMillisec = roundTripMillisec,
+		};
+		state.nextSample = ((state.nextSample + 1) % detail::ClockSyncState::MaxSamples);
+		state.numSamples = Min((state.numSamples + 1), detail::ClockSyncState::MaxSamples);
+
+		detail::EstimateClock(state);
+	}
+}
+
+/// Multiplayer_Photon (connection quality)
+namespace s3d
+{
+	namespace detail
+	{
+		void RollingHistogram::add(const int32 value) noexcept
+		{
+			const uint8 bucket = static_cast<uint8>(Clamp((value / BucketWidth), 0, static_cast<int32>(NumBuckets - 1)));
+
+			if (numSamples == MaxSamples)
+			{
+				--buckets[sampleBuckets[nextSample]];
+			}
+			else
+			{
+				++numSamples;
+			}
+
+			sampleBuckets[nextSample] = bucket;
+			++buckets[bucket];
+			nextSample = ((nextSample + 1) % MaxSamples);
+		}
+
+		int32 RollingHistogram::percentile(const double p) const noexcept
+		{
+			if (numSamples == 0)
+			{
+				return 0;
+			}
+
+			const size_t rank = Max<size_t>(static_cast<size_t>(std::ceil(Clamp(p, 0.0, 1.0) * numSamples)), 1);
+			size_t count = 0;
+
+			for (size_t i = 0; i < NumBuckets; ++i)
+			{
+				count += buckets[i];
+
+				if (rank <= count)
+				{
+					return static_cast<int32>((i + 1) * BucketWidth);
+				}
+			}
+
+			return static_cast<int32>(NumBuckets * BucketWidth);
+		}
+
+		void RollingHistogram::clear() noexcept
+		{
+			buckets.fill(0);
+			numSamples = 0;
+			nextSample = 0;
+		}
+	}
+
+	const ConnectionQualityStats& Multiplayer_Photon::getConnectionQuality() const noexcept
+	{
+		return m_connectionQuality.stats;
+	}
+
+	const ConnectionQualityThresholds& Multiplayer_Photon::getConnectionQualityThresholds() const noexcept
+	{
+		return m_connectionQuality.thresholds;
+	}
+
+	void Multiplayer_Photon::setConnectionQualityThresholds(const ConnectionQualityThresholds& thresholds)
+	{
+		m_connectionQuality.thresholds = thresholds;
+		m_connectionQuality.pendingSinceMillisec.reset();
+	}
+
+	const UpdateTimingStats& Multiplayer_Photon::getLastUpdateTiming() const noexcept
+	{
+		return m_lastUpdateTiming;
+	}
+
+	void Multiplayer_Photon::updateConnectionQuality()
+	{
+		const auto clientState = getClientState();
+
+		if ((clientState == ClientState::Disconnected) or (clientState == ClientState::ConnectingToLobby) or (clientState == ClientState::Disconnecting))
+		{
+			return;
+		}
+
+		auto& state = m_connectionQuality;
+		auto& stats = state.stats;
+		const uint64 now = Time::GetMillisec();
+
+		stats.roundTripMillisec = m_client->getRoundTripTime();
+		stats.roundTripVarianceMillisec = m_client->getRoundTripTimeVariance();
+		stats.queuedOutgoingCommands = m_client->getQueuedOutgoingCommands();
+		stats.queuedIncomingCommands = m_client->getQueuedIncomingCommands();
+
+		// フレームレートによらない時間の窓にするため、一定の間隔で記録する
+		if ((state.lastRoundTripSampleMillisec + detail::ConnectionQualityState::SampleIntervalMillisec) <= now)
+		{
+			state.roundTrip.add(stats.roundTripMillisec);
+			state.roundTripVariance.add(stats.roundTripVarianceMillisec);
+			state.lastRoundTripSampleMillisec = now;
+
+			stats.roundTripP50Millisec = state.roundTrip.percentile(0.50);
+			stats.roundTripP90Millisec = state.roundTrip.percentile(0.90);
+			stats.roundTripP99Millisec = state.roundTrip.percentile(0.99);
+			stats.roundTripVarianceP90Millisec = state.roundTripVariance.percentile(0.90);
+		}
+
+		// 再送数は累計なので、1 秒ごとの差分にする
+		if ((state.lastResendSampleMillisec + 1000) <= now)
+		{
+			const int32 resent = m_client->getResentReliableCommands();
+
+			if (state.lastResendSampleMillisec != 0)
+			{
+				stats.resentReliableCommandsPerSec = Max((resent - state.lastResentReliableCommands), 0);
+			}
+
+			state.lastResentReliableCommands = resent;
+			state.lastResendSampleMillisec = now;
+		}
+
+		const auto& thresholds = state.thresholds;
+		const bool exceeded = ((thresholds.maxRoundTripMillisec < stats.roundTripP90Millisec)
+			or (thresholds.maxRoundTripVarianceMillisec < stats.roundTripVarianceP90Millisec)
+			or (thresholds.maxResentReliableCommandsPerSec < stats.resentReliableCommandsPerSec)
+			or (thresholds.maxQueuedOutgoingCommands < stats.queuedOutgoingCommands));
+
+		if (exceeded == stats.degraded)
+		{
+			state.pendingSinceMillisec.reset();
+			return;
+		}
+
+		if (not state.pendingSinceMillisec)
+		{
+			state.pendingSinceMillisec = now;
+		}
+
+		if ((*state.pendingSinceMillisec + static_cast<uint64>(Max<int64>(thresholds.holdTime.count(), 0))) <= now)
+		{
+			state.pendingSinceMillisec.reset();
+			stats.degraded = exceeded;
+
+			if (exceeded)
+			{
+				log(LogLevel::Warning, U"[Multiplayer_Photon] connection degraded (rtt p90: ", stats.roundTripP90Millisec, U"ms, resent: ", stats.resentReliableCommandsPerSec, U"/s, queued: ", stats.queuedOutgoingCommands, U")");
+				onConnectionDegraded(stats);
+			}
+			else
+			{
+				log(LogLevel::Info, U"[Multiplayer_Photon] connection recovered");
+				onConnectionRecovered(stats);
+			}
+		}
+	}
+}
+
+/// Multiplayer_Photon (auto reconnect)
+namespace s3d
+{
+	void Multiplayer_Photon::enableAutoReconnect(const AutoReconnectOption& option)
+	{
+		if (m_autoReconnect)
+		{
+			m_autoReconnect->option = option;
+			return;
+		}
+
+		m_autoReconnect = detail::AutoReconnectState{ .option = option };
+	}
+
+	void Multiplayer_Photon::disableAutoReconnect()
+	{
+		if (m_autoReconnect && (not m_autoReconnect->outbox.isEmpty()))
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] ", m_autoReconnect->outbox.size(), U" pending events are discarded");
+		}
+
+		m_autoReconnect.reset();
+	}
+
+	bool Multiplayer_Photon::hasAutoReconnect() const noexcept
+	{
+		return m_autoReconnect.has_value();
+	}
+
+	bool Multiplayer_Photon::isReconnecting() const noexcept
+	{
+		return (m_autoReconnect && m_autoReconnect->reconnecting);
+	}
+
+	size_t Multiplayer_Photon::getNumPendingEvents() const noexcept
+	{
+		if (not m_autoReconnect)
+		{
+			return 0;
+		}
+
+		return m_autoReconnect->outbox.size();
+	}
+
+	void Multiplayer_Photon::scheduleReconnect()
+	{
+		if ((not m_autoReconnect) || m_disconnectRequested)
+		{
+			return;
+		}
+
+		auto& state = *m_autoReconnect;
+
+		// connectionErrorReturn() と disconnectReturn() の両方が呼ばれることがある
+		if (state.nextAttemptMillisec)
+		{
+			return;
+		}
+
+		if ((0 < state.option.maxAttempts) && (state.option.maxAttempts <= state.attempt))
+		{
+			log(LogLevel::Error, U"[Multiplayer_Photon] Failed to reconnect after ", state.attempt, U" attempts");
+
+			// 次に connect() が呼ばれるまでは再接続を予定しない
+			m_disconnectRequested = true;
+			finishReconnect(false);
+			return;
+		}
+
+		// 全員が同時に再接続しないように、待ち時間を [delay * (1 - jitter), delay] の範囲でばらつかせる
+		const double maxDelay = static_cast<double>(state.option.maxDelay.count());
+		const double delay = Min((state.option.initialDelay.count() * std::exp2(Min(state.attempt, 30))), maxDelay);
+		const double jitter = Clamp(state.option.jitter, 0.0, 1.0);
+		const Milliseconds jitteredDelay{ static_cast<int64>(delay * (1.0 - jitter * Random())) };
+
+		state.reconnecting = true;
+		++state.attempt;
+		state.nextAttemptMillisec = (Time::GetMillisec() + static_cast<uint64>(jitteredDelay.count()));
+
+		log(LogLevel::Info, U"[Multiplayer_Photon] Reconnecting in ", jitteredDelay.count(), U"ms (attempt ", state.attempt, U")");
+
+		onReconnecting(state.attempt, jitteredDelay);
+	}
+
+	void Multiplayer_Photon::updateAutoReconnect()
+	{
+		if ((not m_autoReconnect) || (not m_autoReconnect->nextAttemptMillisec))
+		{
+			return;
+		}
+
+		if (Time::GetMillisec() < *m_autoReconnect->nextAttemptMillisec)
+		{
+			return;
+		}
+
+		m_autoReconnect->nextAttemptMillisec.reset();
+
+		// 予定していた間に connect() などで接続し直している
+		if (getClientState() != ClientState::Disconnected)
+		{
+			return;
+		}
+
+		if (not reconnect())
+		{
+			scheduleReconnect();
+		}
+	}
+
+	void Multiplayer_Photon::restoreAfterRejoin()
+	{
+		m_restoreOnRejoin = false;
+
+		if (not m_lastUserName.isEmpty())
+		{
+			m_client->getLocalPlayer().setName(detail::ToJString(m_lastUserName));
+		}
+
+		Array<uint8> groups;
+
+		for (size_t i = 1; i < m_eventTargetGroups.size(); ++i)
+		{
+			if (m_eventTargetGroups[i])
+			{
+				groups << static_cast<uint8>(i);
+			}
+		}
+
+		if (groups.size() == (m_eventTargetGroups.size() - 1))
+		{
+			auto emptyJVector = ExitGames::Common::JVector<nByte>();
+			m_client->opChangeGroups(nullptr, &emptyJVector);
+		}
+		else if (groups)
+		{
+			auto joinGroups = ExitGames::Common::JVector<nByte>(groups.data(), static_cast<uint32>(groups.size()));
+			m_client->opChangeGroups(nullptr, &joinGroups);
+		}
+
+		log(LogLevel::Info, U"[Multiplayer_Photon] Rejoined the room. event target groups: ", groups);
+
+		// 切断中に失われたチャンクを送信し直し、受信中の転送の再開を要求する
+		rewindStreams(-1);
+
+		finishReconnect(true);
+	}
+
+	void Multiplayer_Photon::finishReconnect(const bool succeeded)
+	{
+		if ((not m_autoReconnect) || (not m_autoReconnect->reconnecting))
+		{
+			return;
+		}
+
+		auto& state = *m_autoReconnect;
+		state.reconnecting = false;
+		state.attempt = 0;
+
+		Array<detail::PendingEvent> outbox = std::move(state.outbox);
+		state.outbox.clear();
+
+		if (succeeded && m_client->getIsInGameRoom())
+		{
+			for (const auto& pending : outbox)
+			{
+				submitEvent(pending.event, pending.data);
+			}
+		}
+		else if (outbox)
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] ", outbox.size(), U" pending events are discarded");
+		}
+
+		if (state.droppedEvents)
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] ", state.droppedEvents, U" events were dropped because the outbox was full");
+			state.droppedEvents = 0;
+		}
+
+		if (succeeded)
+		{
+			onReconnected();
+		}
+		else
+		{
+			onReconnectFailed();
+		}
+	}
+}
+
+/// Multiplayer_Photon (keyed event cache)
+namespace s3d
+{
+	namespace detail
+	{
+		[[nodiscard]]
+		static bool IsCachingReceiverOption(const ReceiverOption option) noexcept
+		{
+			switch (option)
+			{
+			case ReceiverOption::Others_CacheUntilLeaveRoom:
+			case ReceiverOption::Others_CacheForever:
+			case ReceiverOption::All_CacheUntilLeaveRoom:
+			case ReceiverOption::All_CacheForever:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		/// @brief 指定した内容を含む、キャッシュされたイベントを削除します。
+		static void RemoveCachedEvents(ExitGames::LoadBalancing::Client& client, EventTrafficCounters& counters, const uint8 eventCode, const nByte field, const int32 value)
+		{
+			ExitGames::Common::Hashtable filter;
+			filter.put(field, value);
+
+			counters.sentCount.fetch_add(1, std::memory_order_relaxed);
+			counters.sentBytes.fetch_add((sizeof(field) + sizeof(value)), std::memory_order_relaxed);
+
+			client.opRaiseEvent(Reliable, filter, eventCode, ExitGames::LoadBalancing::RaiseEventOptions().setEventCaching(ExitGames::Lite::EventCache::REMOVE_FROM_ROOM_CACHE));
+		}
+
+		static void RaiseCachedEvent(ExitGames::LoadBalancing::Client& client, EventTrafficCounters& counters, const MultiplayerEvent& eventInfo, ExitGames::Common::Hashtable& table, const Blob& data)
+		{
+			table.put(CachedEventData, static_cast<const nByte*>(static_cast<const void*>(data.data())), static_cast<int>(data.size()));
+
+			counters.sentCount.fetch_add(1, std::memory_order_relaxed);
+			counters.sentBytes.fetch_add(data.size(), std::memory_order_relaxed);
+
+			client.opRaiseEvent(Reliable, table, eventInfo.eventCode(), MakeRaiseEventOptions(eventInfo));
+		}
+	}
+
+	void Multiplayer_Photon::sendCachedEvent(const MultiplayerEvent& eventInfo, const int32 key, const Serializer<MemoryWriter>& writer)
+	{
+		if (not InRange(static_cast<int>(eventInfo.eventCode()), 1, 199))
+		{
+			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
+		}
+
+		if (not detail::IsCachingReceiverOption(eventInfo.receiverOption()))
+		{
+			throw Error{ U"[Multiplayer_Photon] sendCachedEvent() requires ReceiverOption::Others_CacheUntilLeaveRoom, Others_CacheForever, All_CacheUntilLeaveRoom or All_CacheForever" };
+		}
+
+		if (not m_client)
+		{
+			return;
+		}
+
+		auto& mirror = m_eventCacheMirror[eventInfo.eventCode()];
+		const auto it = mirror.slots.find(key);
+		const bool cachedSeparately = ((it != mirror.slots.end()) && (not it->second.inSnapshot));
+
+		mirror.slots[key] = detail::CachedEventSlot{ .data = writer->getBlob() };
+		mirror.lastEvent = eventInfo;
+
+		if (not m_client->getIsInGameRoom())
+		{
+			mirror.resync = true;
+			m_eventCacheResync = true;
+			return;
+		}
+
+		// キューで待っているイベントに追い越されないよう、先に送信しておく
+		flushSendScheduler();
+
+		// 同じキーでキャッシュされているイベントを削除してから追加する
+		detail::RemoveCachedEvents(*m_client, (*m_eventTraffic)[eventInfo.eventCode()], eventInfo.eventCode(), detail::CachedEventKey, key);
+
+		ExitGames::Common::Hashtable table;
+		table.put(detail::CachedEventKey, key);
+		table.put(detail::CachedEventOwner, static_cast<int32>(getLocalPlayerID()));
+		detail::RaiseCachedEvent(*m_client, (*m_eventTraffic)[eventInfo.eventCode()], eventInfo, table, writer->getBlob());
+
+		if (not cachedSeparately)
+		{
+			++mirror.numRoomCachedEvents;
+		}
+
+		if ((0 < m_eventCacheCompactionThreshold) && (m_eventCacheCompactionThreshold < mirror.numRoomCachedEvents))
+		{
+			compactEventCache(eventInfo.eventCode());
+		}
+	}
+
+	void Multiplayer_Photon::removeCachedEvent(const uint8 eventCode, const int32 key)
+	{
+		if (not InRange(static_cast<int>(eventCode), 1, 199))
+		{
+			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
+		}
+
+		if (not m_client)
+		{
+			return;
+		}
+
+		auto mirrorIt = m_eventCacheMirror.find(eventCode);
+		bool cached = false;
+		bool inSnapshot = false;
+
+		if (mirrorIt != m_eventCacheMirror.end())
+		{
+			if (const auto it = mirrorIt->second.slots.find(key); it != mirrorIt->second.slots.end())
+			{
+				cached = true;
+				inSnapshot = it->second.inSnapshot;
+				mirrorIt->second.slots.erase(it);
+			}
+		}
+
+		if (not m_client->getIsInGameRoom())
+		{
+			if (cached)
+			{
+				mirrorIt->second.resync = true;
+				m_eventCacheResync = true;
+			}
+
+			return;
+		}
+
+		flushSendScheduler();
+		detail::RemoveCachedEvents(*m_client, (*m_eventTraffic)[eventCode], eventCode, detail::CachedEventKey, key);
+
+		if (not cached)
+		{
+			return;
+		}
+
+		if (inSnapshot)
+		{
+			// スナップショットから取り除くために作り直す
+			compactEventCache(eventCode);
+		}
+		else if (mirrorIt->second.numRoomCachedEvents)
+		{
+			--mirrorIt->second.numRoomCachedEvents;
+		}
+	}
+
+	void Multiplayer_Photon::setEventCacheCompactionThreshold(const size_t maxCachedEvents)
+	{
+		m_eventCacheCompactionThreshold = maxCachedEvents;
+	}
+
+	Array<int32> Multiplayer_Photon::getCachedEventKeys(const uint8 eventCode) const
+	{
+		Array<int32> keys;
+
+		if (const auto it = m_eventCacheMirror.find(eventCode); it != m_eventCacheMirror.end())
+		{
+			keys.reserve(it->second.slots.size());
+
+			for (const auto& slot : it->second.slots)
+			{
+				keys << slot.first;
+			}
+		}
+
+		return keys;
+	}
+
+	size_t Multiplayer_Photon::getNumRoomCachedEvents(const uint8 eventCode) const
+	{
+		if (const auto it = m_eventCacheMirror.find(eventCode); it != m_eventCacheMirror.end())
+		{
+			return it->second.numRoomCachedEvents;
+		}
+
+		return 0;
+	}
+
+	void Multiplayer_Photon::onCachedEventReplaced(const LocalPlayerID playerID, const uint8 eventCode, const int32 key)
+	{
+		if (playerID == getLocalPlayerID())
+		{
+			return;
+		}
+
+		const auto mirrorIt = m_eventCacheMirror.find(eventCode);
+
+		if (mirrorIt == m_eventCacheMirror.end())
+		{
+			return;
+		}
+
+		auto& mirror = mirrorIt->second;
+		const auto it = mirror.slots.find(key);
+
+		if (it == mirror.slots.end())
+		{
+			return;
+		}
+
+		// 送信者が同じキーの個別のイベントをルームのキャッシュから削除している。スナップショットに含まれる古い値は、後からキャッシュされた新しい値で上書きされる
+		if ((not it->second.inSnapshot) && mirror.numRoomCachedEvents)
+		{
+			--mirror.numRoomCachedEvents;
+		}
+
+		mirror.slots.erase(it);
+	}
+
+	void Multiplayer_Photon::compactEventCache(const uint8 eventCode)
+	{
+		const auto mirrorIt = m_eventCacheMirror.find(eventCode);
+
+		if (mirrorIt == m_eventCacheMirror.end())
+		{
+			return;
+		}
+
+		auto& mirror = mirrorIt->second;
+		mirror.resync = false;
+
+		// 自分がキャッシュしたイベント（スナップショットを含む）をすべて削除する
+		const int32 owner = getLocalPlayerID();
+		flushSendScheduler();
+		detail::RemoveCachedEvents(*m_client, (*m_eventTraffic)[eventCode], eventCode, detail::CachedEventOwner, owner);
+
+		if (mirror.slots.empty() || (not mirror.lastEvent))
+		{
+			mirror.numRoomCachedEvents = 0;
+			return;
+		}
+
+		// (キー, サイズ, データ) の並び
+		Serializer<MemoryWriter> writer;
+		writer(static_cast<uint32>(mirror.slots.size()));
+
+		for (auto& [key, slot] : mirror.slots)
+		{
+			writer(key, static_cast<uint64>(slot.data.size()));
+			writer->write(slot.data.data(), slot.data.size());
+			slot.inSnapshot = true;
+		}
+
+		ExitGames::Common::Hashtable table;
+		table.put(detail::CachedEventOwner, owner);
+		detail::RaiseCachedEvent(*m_client, (*m_eventTraffic)[eventCode], *mirror.lastEvent, table, writer->getBlob());
+
+		mirror.numRoomCachedEvents = 1;
+
+		log(LogLevel::Info, U"[Multiplayer_Photon] Compacted the event cache. eventCode: ", eventCode, U", keys: ", mirror.slots.size());
+	}
+
+	void Multiplayer_Photon::updateEventCache()
+	{
+		if ((not m_eventCacheResync) || (not m_client->getIsInGameRoom()))
+		{
+			return;
+		}
+
+		m_eventCacheResync = false;
+
+		for (auto& [eventCode, mirror] : m_eventCacheMirror)
+		{
+			if (mirror.resync)
+			{
+				compactEventCache(eventCode);
+			}
+		}
+	}
+
+	void Multiplayer_Photon::resetEventCacheMirror(const bool keepPending)
+	{
+		// ルームにいない間に送信したものは、そのルームの状態なので、別のルームには持ち込まない
+		if (not keepPending)
+		{
+			m_eventCacheMirror.clear();
+			m_eventCacheResync = false;
+			return;
+		}
+
+		Array<uint8> eventCodes;
+
+		for (auto& [eventCode, mirror] : m_eventCacheMirror)
+		{
+			if (mirror.resync)
+			{
+				// 新しいルームにはまだ何もキャッシュしていない
+				mirror.numRoomCachedEvents = 0;
+
+				for (auto& slot : mirror.slots)
+				{
+					slot.second.inSnapshot = false;
+				}
+			}
+			else
+			{
+				eventCodes << eventCode;
+			}
+		}
+
+		for (const auto eventCode : eventCodes)
+		{
+			m_eventCacheMirror.erase(eventCode);
+		}
+	}
+}
+
+/// Multiplayer_Photon (host migration)
+namespace s3d
+{
+	/// @brief ping を公開し直す間隔
+	static constexpr uint64 PingPublishIntervalMillisec = 2000;
+
+	/// @brief この値以上 ping が変化したときに公開し直す
+	static constexpr int32 PingPublishThresholdMillisec = 5;
+
+	/// @brief この値以上のサイズのチェックポイントを圧縮する
+	static constexpr size_t CheckpointCompressionThreshold = 256;
+
+	void Multiplayer_Photon::enableHostMigration(const Milliseconds checkpointInterval)
+	{
+		if (m_hostMigration)
+		{
+			m_hostMigration->checkpointInterval = checkpointInterval;
+			return;
+		}
+
+		m_hostMigration = detail::HostMigrationState{ .checkpointInterval = checkpointInterval };
+	}
+
+	void Multiplayer_Photon::disableHostMigration()
+	{
+		m_hostMigration.reset();
+	}
+
+	bool Multiplayer_Photon::hasHostMigration() const noexcept
+	{
+		return m_hostMigration.has_value();
+	}
+
+	LocalPlayerID Multiplayer_Photon::getHostSuccessorID() const noexcept
+	{
+		if (not m_hostMigration)
+		{
+			return -1;
+		}
+
+		return m_hostMigration->successor;
+	}
+
+	bool Multiplayer_Photon::hasHostCheckpoint() const noexcept
+	{
+		return (m_hostMigration && (m_hostMigration->checkpointHost != -1));
+	}
+
+	void Multiplayer_Photon::requestHostCheckpoint()
+	{
+		if (m_hostMigration)
+		{
+			m_hostMigration->checkpointRequested = true;
+		}
+	}
+
+	void Multiplayer_Photon::updateHostMigration()
+	{
+		if ((not m_hostMigration) or (not m_client->getIsInGameRoom()))
+		{
+			return;
+		}
+
+		auto& state = *m_hostMigration;
+		const uint64 now = Time::GetMillisec();
+
+		// 後継者を ping で選べるように、自分の ping をプレイヤープロパティとして公開する
+		if ((state.lastPingPublishMillisec + PingPublishIntervalMillisec) <= now)
+		{
+			const int32 ping = getPingMillisec();
+
+			if ((state.publishedPing < 0) or (PingPublishThresholdMillisec <= Abs(ping - state.publishedPing)))
+			{
+				m_client->getLocalPlayer().addCustomProperty(detail::HostMigrationPingKey(), ping);
+				state.publishedPing = ping;
+			}
+
+			state.lastPingPublishMillisec = now;
+		}
+
+		if (not isHost())
+		{
+			return;
+		}
+
+		const bool checkpointDue = (state.checkpointRequested
+			or ((state.lastCheckpointMillisec + static_cast<uint64>(state.checkpointInterval.count())) <= now));
+
+		if (not checkpointDue)
+		{
+			return;
+		}
+
+		state.lastCheckpointMillisec = now;
+		state.checkpointRequested = false;
+
+		// ping が最も小さいアクティブなプレイヤーを後継者に選ぶ
+		const LocalPlayerID self = getLocalPlayerID();
+		const auto& players = m_client->getCurrentlyJoinedRoom().getPlayers();
+		LocalPlayerID successor = -1;
+		int32 successorPing = Largest<int32>;
+
+		for (uint32 i = 0; i < players.getSize(); ++i)
+		{
+			const auto& player = *players[i];
+
+			if ((player.getNumber() == self) or player.getIsInactive())
+			{
+				continue;
+			}
+
+			const int32 ping = detail::GetPublishedPing(player);
+
+			if ((successor == -1) or (ping < successorPing) or ((ping == successorPing) and (player.getNumber() < successor)))
+			{
+				successor = player.getNumber();
+				successorPing = ping;
+			}
+		}
+
+		if ((successor != state.successor) or state.successorDirty)
+		{
+			state.successor = successor;
+			state.successorDirty = false;
+
+			Serializer<MemoryWriter> writer;
+			writer(FromEnum(detail::SystemEvent::HostSuccessor), successor);
+			flushSendScheduler();
+			sendSystemEvent(writer);
+		}
+
+		if (successor == -1)
+		{
+			return;
+		}
+
+		Serializer<MemoryWriter> checkpoint;
+		writeHostCheckpoint(checkpoint);
+
+		const Blob& raw = checkpoint->getBlob();
+
+		if (raw.isEmpty())
+		{
+			return;
+		}
+
+		Blob compressedData;
+		bool compressed = false;
+
+		if (CheckpointCompressionThreshold <= raw.size())
+		{
+			compressedData = Compression::Compress(raw);
+			compressed = ((not compressedData.isEmpty()) && (compressedData.size() < raw.size()));
+		}
+
+		const Blob& payload = (compressed ? compressedData : raw);
+
+		Serializer<MemoryWriter> writer;
+		writer(FromEnum(detail::SystemEvent::HostCheckpoint), ++state.sequence, compressed);
+		writer->write(payload.data(), static_cast<int64>(payload.size()));
+
+		// チェックポイントより前に書いたイベントが、後から届かないようにする
+		flushSendScheduler();
+		sendSystemEvent(writer, { successor });
+	}
+
+	void Multiplayer_Photon::onHostMigration(const LocalPlayerID newHostPlayerID, const LocalPlayerID oldHostPlayerID)
+	{
+		if (not m_hostMigration)
+		{
+			return;
+		}
+
+		auto& state = *m_hostMigration;
+		const LocalPlayerID self = getLocalPlayerID();
+
+		if (newHostPlayerID != self)
+		{
+			return;
+		}
+
+		// 次の update() ですぐにチェックポイントの送信と後継者の通知を行う
+		state.checkpointRequested = true;
+		state.successorDirty = true;
+
+		if (state.checkpointHost != -1)
+		{
+			const Blob data = (state.checkpointCompressed ? Compression::Decompress(state.checkpoint) : state.checkpoint);
+			const LocalPlayerID checkpointHost = state.checkpointHost;
+
+			state.checkpoint.clear();
+			state.checkpointHost = -1;
+			state.successor = -1;
+
+			debugLog(U"[Multiplayer_Photon] restoreHostCheckpoint() sequence: ", state.checkpointSequence, U", size: ", data.size(), U" bytes");
+
+			Deserializer<MemoryViewReader> reader{ data.data(), data.size() };
+			restoreHostCheckpoint(checkpointHost, reader);
+			return;
+		}
+
+		// チェックポイントを持っていない場合は、チェックポイントを持っている後継者にホストを譲る
+		const LocalPlayerID successor = state.successor;
+
+		if ((successor != -1) && (successor != self) && (successor != oldHostPlayerID))
+		{
+			const auto* player = m_client->getCurrentlyJoinedRoom().getPlayerForNumber(successor);
+
+			if (player && (not player->getIsInactive()))
+			{
+				debugLog(U"[Multiplayer_Photon] Hand over the host to the successor: ", successor);
+				setHost(successor);
+			}
+		}
+	}
+}
+
+/// Multiplayer_Photon (join snapshot)
+namespace s3d
+{
+	/// @brief この値以上のサイズのスナップショットを圧縮する
+	static constexpr size_t JoinSnapshotCompressionThreshold = 256;
+
+	void Multiplayer_Photon::enableJoinSnapshot(const size_t chunkSize)
+	{
+		if (chunkSize == 0)
+		{
+			throw Error{ U"[Multiplayer_Photon] chunkSize must be greater than 0" };
+		}
+
+		if (m_joinSnapshot)
+		{
+			m_joinSnapshot->chunkSize = chunkSize;
+			return;
+		}
+
+		m_joinSnapshot = detail::JoinSnapshotState{ .chunkSize = chunkSize };
+	}
+
+	void Multiplayer_Photon::disableJoinSnapshot()
+	{
+		m_joinSnapshot.reset();
+	}
+
+	bool Multiplayer_Photon::hasJoinSnapshot() const noexcept
+	{
+		return m_joinSnapshot.has_value();
+	}
+
+	bool Multiplayer_Photon::isReceivingJoinSnapshot() const noexcept
+	{
+		return (m_joinSnapshot && (m_joinSnapshot->receivingFrom != -1));
+	}
+
+	void Multiplayer_Photon::updateJoinSnapshot()
+	{
+		if ((not m_joinSnapshot) or m_joinSnapshot->pendingPlayers.isEmpty())
+		{
+			return;
+		}
+
+		auto& state = *m_joinSnapshot;
+		Array<LocalPlayerID> targets = std::exchange(state.pendingPlayers, {});
+
+		if ((not m_client->getIsInGameRoom()) or (not isHost()))
+		{
+			return;
+		}
+
+		// 参加してすぐに退出したプレイヤーには送信しない
+		const auto& room = m_client->getCurrentlyJoinedRoom();
+		targets.remove_if([&](const LocalPlayerID playerID)
+			{
+				const auto* player = room.getPlayerForNumber(playerID);
+				return ((not player) or player->getIsInactive());
+			});
+
+		if (targets.isEmpty())
+		{
+			return;
+		}
+
+		// 同じ update() の間に参加したプレイヤーには、同じスナップショットを送信する
+		Serializer<MemoryWriter> snapshot;
+		writeJoinSnapshot(targets, snapshot);
+
+		const Blob& raw = snapshot->getBlob();
+
+		if (raw.isEmpty())
+		{
+			return;
+		}
+
+		Blob compressedData;
+		bool compressed = false;
+
+		if (JoinSnapshotCompressionThreshold <= raw.size())
+		{
+			compressedData = Compression::Compress(raw);
+			compressed = ((not compressedData.isEmpty()) && (compressedData.size() < raw.size()));
+		}
+
+		const Blob& payload = (compressed ? compressedData : raw);
+		const uint32 numChunks = static_cast<uint32>((payload.size() + state.chunkSize - 1) / state.chunkSize);
+		const uint32 sequence = ++state.sequence;
+
+		debugLog(U"[Multiplayer_Photon] Send a join snapshot to ", targets, U". size: ", raw.size(), U" bytes, payload: ", payload.size(), U" bytes, chunks: ", numChunks);
+
+		// スナップショットに反映済みのイベントが、後から届かないようにする
+		flushSendScheduler();
+
+		Serializer<MemoryWriter> writer;
+
+		for (uint32 i = 0; i < numChunks; ++i)
+		{
+			const size_t offset = (i * state.chunkSize);
+			const size_t size = Min(state.chunkSize, (payload.size() - offset));
+
+			writer->clear();
+			writer(FromEnum(detail::SystemEvent::JoinSnapshot), sequence, i, numChunks, compressed);
+			writer->write((payload.data() + offset), static_cast<int64>(size));
+			sendSystemEvent(writer, targets);
+		}
+	}
+
+	void Multiplayer_Photon::receiveJoinSnapshotChunk(const LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader)
+	{
+		if (not m_joinSnapshot)
+		{
+			return;
+		}
+
+		auto& state = *m_joinSnapshot;
+
+		// スナップショットを送信できるのはホストだけ
+		if (playerID != getHostLocalPlayerID())
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Ignored a join snapshot chunk from a player who is not the host. playerID: ", playerID);
+			return;
+		}
+
+		uint32 sequence = 0;
+		uint32 index = 0;
+		uint32 numChunks = 0;
+		bool compressed = false;
+		reader(sequence, index, numChunks, compressed);
+
+		const auto abandon = [&]()
+		{
+			state.receivingFrom = -1;
+			state.numReceivedChunks = 0;
+			state.data.clear();
+		};
+
+		if (index == 0)
+		{
+			if ((numChunks == 0) || (detail::JoinSnapshotState::MaxReceiveSize < (static_cast<uint64>(numChunks) * state.chunkSize)))
+			{
+				log(LogLevel::Warning, U"[Multiplayer_Photon] Ignored a join snapshot that is too large. playerID: ", playerID, U", chunks: ", numChunks);
+				abandon();
+				return;
+			}
+
+			state.receivingFrom = playerID;
+			state.receivingSequence = sequence;
+			state.numChunks = numChunks;
+			state.numReceivedChunks = 0;
+			state.compressed = compressed;
+			state.data.clear();
+		}
+		else if ((state.receivingFrom != playerID) || (state.receivingSequence != sequence) || (state.numReceivedChunks != index))
+		{
+			// 途中のチャンクが抜けたスナップショットは完成しないので、受信を中止して次のスナップショットを待つ
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Ignored an unexpected join snapshot chunk. playerID: ", playerID, U", sequence: ", sequence, U", index: ", index);
+			abandon();
+			return;
+		}
+
+		// チャンクのデータを受信済みのデータの後ろに読み込む
+		const int64 size = (reader->size() - reader->getPos());
+
+		if (detail::JoinSnapshotState::MaxReceiveSize < (state.data.size() + static_cast<size_t>(Max<int64>(size, 0))))
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Ignored a join snapshot that is too large. playerID: ", playerID, U", sequence: ", sequence);
+			abandon();
+			return;
+		}
+
+		if (0 < size)
+		{
+			const size_t offset = state.data.size();
+			state.data.resize(offset + static_cast<size_t>(size));
+			reader->read((state.data.data() + offset), size);
+		}
+
+		if (++state.numReceivedChunks < state.numChunks)
+		{
+			return;
+		}
+
+		const Blob data = (state.compressed ? Compression::Decompress(state.data) : std::exchange(state.data, {}));
+		const bool decompressFailed = (state.compressed && data.isEmpty() && (not state.data.isEmpty()));
+		state.data.clear();
+		state.receivingFrom = -1;
+
+		if (decompressFailed)
+		{
+			log(LogLevel::Error, U"[Multiplayer_Photon] Failed to decompress the join snapshot. hostPlayerID: ", playerID, U", sequence: ", sequence);
+			return;
+		}
+
+		// スナップショットより前にホストが送信したイベントが受信キューに残っていれば、先に処理する
+		dispatchReceivedEventsFrom(playerID);
+
+		debugLog(U"[Multiplayer_Photon] applyJoinSnapshot() hostPlayerID: ", playerID, U", size: ", data.size(), U" bytes");
+
+		Deserializer<MemoryViewReader> snapshotReader{ data.data(), data.size() };
+		applyJoinSnapshot(playerID, snapshotReader);
+	}
+}
+
+/// Multiplayer_Photon (stream)
+namespace s3d
+{
+	namespace detail
+	{
+		[[nodiscard]]
+		static constexpr std::array<uint32, 256> MakeCRC32Table() noexcept
+		{
+			std::array<uint32, 256> table{};
+
+			for (uint32 i = 0; i < 256; ++i)
+			{
+				uint32 c = i;
+
+				for (int32 k = 0; k < 8; ++k)
+				{
+					c = ((c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1));
+				}
+
+				table[i] = c;
+			}
+
+			return table;
+		}
+
+		inline constexpr std::array<uint32, 256> CRC32Table = MakeCRC32Table();
+
+		[[nodiscard]]
+		static uint32 CRC32(const void* data, const size_t size) noexcept
+		{
+			const uint8* p = static_cast<const uint8*>(data);
+			uint32 crc = 0xFFFFFFFFu;
+
+			for (size_t i = 0; i < size; ++i)
+			{
+				crc = (CRC32Table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8));
+			}
+
+			return ~crc;
+		}
+
+		[[nodiscard]]
+		static uint64 StreamKey(const LocalPlayerID playerID, const uint32 streamID) noexcept
+		{
+			return ((static_cast<uint64>(static_cast<uint32>(playerID)) << 32) | streamID);
+		}
+
+		[[nodiscard]]
+		static LocalPlayerID StreamKeyToPlayerID(const uint64 key) noexcept
+		{
+			return static_cast<LocalPlayerID>(static_cast<uint32>(key >> 32));
+		}
+
+		[[nodiscard]]
+		static StreamProgress ToStreamProgress(const OutgoingStream& stream) noexcept
+		{
+			return{
+				.streamID = stream.streamID,
+				.playerID = stream.target,
+				.eventCode = stream.eventCode,
+				.sending = true,
+				.transferredBytes = Min(stream.data.size(), (stream.ackedChunks * stream.chunkSize)),
+				.totalBytes = stream.data.size(),
+			};
+		}
+
+		[[nodiscard]]
+		static StreamProgress ToStreamProgress(const uint64 key, const IncomingStream& stream) noexcept
+		{
+			return{
+				.streamID = static_cast<uint32>(key),
+				.playerID = StreamKeyToPlayerID(key),
+				.eventCode = stream.eventCode,
+				.sending = false,
+				.transferredBytes = stream.data.size(),
+				.totalBytes = static_cast<size_t>(stream.totalSize),
+			};
+		}
+	}
+
+	void Multiplayer_Photon::setStreamOption(const StreamOption& option)
+	{
+		if ((option.chunkSize == 0) || (option.bytesPerSec == 0) || (option.windowChunks == 0))
+		{
+			throw Error{ U"[Multiplayer_Photon] chunkSize, bytesPerSec and windowChunks must be greater than 0" };
+		}
+
+		m_streams.option = option;
+	}
+
+	const StreamOption& Multiplayer_Photon::getStreamOption() const noexcept
+	{
+		return m_streams.option;
+	}
+
+	uint32 Multiplayer_Photon::sendStream(const LocalPlayerID targetPlayerID, const uint8 eventCode, const Serializer<MemoryWriter>& writer)
+	{
+		if (not InRange(static_cast<int>(eventCode), 1, 199))
+		{
+			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
+		}
+
+		if (not m_client)
+		{
+			return 0;
+		}
+
+		auto& state = m_streams;
+		const size_t chunkSize = state.option.chunkSize;
+		const Blob& data = writer->getBlob();
+
+		detail::OutgoingStream stream{
+			.streamID = state.nextStreamID++,
+			.target = targetPlayerID,
+			.eventCode = eventCode,
+			.data = data,
+			.chunkSize = chunkSize,
+			.numChunks = static_cast<uint32>(Max<size_t>(((data.size() + chunkSize - 1) / chunkSize), 1)),
+			.lastAckMillisec = Time::GetMillisec(),
+		};
+
+		debugLog(U"[Multiplayer_Photon] sendStream() streamID: ", stream.streamID, U", target: ", targetPlayerID, U", size: ", data.size(), U" bytes, chunks: ", stream.numChunks);
+
+		state.outgoing << std::move(stream);
+
+		return state.outgoing.back().streamID;
+	}
+
+	bool Multiplayer_Photon::cancelStream(const uint32 streamID)
+	{
+		auto& outgoing = m_streams.outgoing;
+		const auto it = std::find_if(outgoing.begin(), outgoing.end(), [=](const detail::OutgoingStream& stream) { return (stream.streamID == streamID); });
+
+		if (it == outgoing.end())
+		{
+			return false;
+		}
+
+		const StreamProgress progress = detail::ToStreamProgress(*it);
+		outgoing.erase(it);
+
+		if (m_client && m_client->getIsInGameRoom())
+		{
+			Serializer<MemoryWriter> writer;
+			writer(FromEnum(detail::SystemEvent::StreamCancel), streamID, true);
+			sendSystemEvent(writer, { progress.playerID }, m_streams.option.priorityIndex);
+		}
+
+		onStreamFailed(progress);
+		return true;
+	}
+
+	Array<StreamProgress> Multiplayer_Photon::getStreamProgress() const
+	{
+		Array<StreamProgress> results;
+
+		for (const auto& stream : m_streams.outgoing)
+		{
+			results << detail::ToStreamProgress(stream);
+		}
+
+		for (const auto& [key, stream] : m_streams.incoming)
+		{
+			results << detail::ToStreamProgress(key, stream);
+		}
+
+		return results;
+	}
+
+	void Multiplayer_Photon::updateStreams()
+	{
+		auto& state = m_streams;
+		const auto& option = state.option;
+		const uint64 now = Time::GetMillisec();
+		const uint64 elapsedMillisec = (now - Min(state.lastUpdateMillisec, now));
+		state.lastUpdateMillisec = now;
+
+		// 受信を終えてから時間が経った転送は忘れる
+		{
+			Array<uint64> expired;
+
+			for (const auto& [key, finished] : state.finished)
+			{
+				if ((finished.finishedMillisec + detail::StreamState::FinishedLifetimeMillisec) <= now)
+				{
+					expired << key;
+				}
+			}
+
+			for (const auto key : expired)
+			{
+				state.finished.erase(key);
+			}
+		}
+
+		if (state.outgoing.isEmpty() || (not m_client->getIsInGameRoom()))
+		{
+			state.budget = 0.0;
+			return;
+		}
+
+		const auto& room = m_client->getCurrentlyJoinedRoom();
+
+		// 送信先がルームにいない転送は中止する
+		Array<LocalPlayerID> departed;
+
+		for (const auto& stream : state.outgoing)
+		{
+			if (not room.getPlayerForNumber(stream.target))
+			{
+				departed << stream.target;
+			}
+		}
+
+		for (const auto playerID : departed)
+		{
+			abortStreams(playerID);
+		}
+
+		if (state.outgoing.isEmpty())
+		{
+			state.budget = 0.0;
+			return;
+		}
+
+		// 送信量の上限。まとめて送信するのは 100ms 分まで
+		const double maxBudget = Max(static_cast<double>(option.chunkSize), (option.bytesPerSec / 10.0));
+		state.budget = Min((state.budget + option.bytesPerSec * (elapsedMillisec / 1000.0)), maxBudget);
+
+		for (auto& stream : state.outgoing)
+		{
+			if ((stream.ackedChunks < stream.nextChunk) && ((stream.lastAckMillisec + static_cast<uint64>(option.ackTimeout.count())) <= now))
+			{
+				debugLog(U"[Multiplayer_Photon] Stream ack timed out. streamID: ", stream.streamID, U", resend from chunk ", stream.ackedChunks);
+				stream.nextChunk = stream.ackedChunks;
+				stream.lastAckMillisec = now;
+				stream.resendFrom.reset();
+			}
+		}
+		Serializer<MemoryWriter> writer;
+		size_t numIdle = 0;
+
+		// 送信できるデータの量を、転送ごとに 1 チャンクずつ順番に使う
+		while ((0.0 < state.budget) && (numIdle < state.outgoing.size()))
+		{
+			state.nextOutgoing %= state.outgoing.size();
+			auto& stream = state.outgoing[state.nextOutgoing++];
+
+			const auto* player = room.getPlayerForNumber(stream.target);
+
+			if ((stream.numChunks <= stream.nextChunk)
+				|| (option.windowChunks <= (stream.nextChunk - stream.ackedChunks))
+				|| (not player) || player->getIsInactive())
+			{
+				++numIdle;
+				continue;
+			}
+
+			numIdle = 0;
+
+			const size_t offset = (stream.nextChunk * stream.chunkSize);
+			const size_t size = Min(stream.chunkSize, (stream.data.size() - offset));
+			const auto* chunk = (stream.data.data() + offset);
+
+			writer->clear();
+			writer(FromEnum(detail::SystemEvent::StreamChunk), stream.streamID, stream.eventCode, static_cast<uint64>(stream.data.size()),
+				stream.numChunks, stream.nextChunk, detail::CRC32(chunk, size));
+			writer->write(chunk, static_cast<int64>(size));
+			sendSystemEvent(writer, { stream.target }, option.priorityIndex);
+
+			++stream.nextChunk;
+			state.budget -= static_cast<double>(size);
+		}
+	}
+
+	void Multiplayer_Photon::sendStreamAck(const LocalPlayerID playerID, const uint32 streamID, const uint32 nextChunk, const bool resend)
+	{
+		Serializer<MemoryWriter> writer;
+		writer(FromEnum(detail::SystemEvent::StreamAck), streamID, nextChunk, resend);
+		sendSystemEvent(writer, { playerID }, m_streams.option.priorityIndex);
+	}
+
+	void Multiplayer_Photon::receiveStreamChunk(const LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader)
+	{
+		uint32 streamID = 0;
+		uint8 eventCode = 0;
+		uint64 totalSize = 0;
+		uint32 numChunks = 0;
+		uint32 index = 0;
+		uint32 crc = 0;
+		reader(streamID, eventCode, totalSize, numChunks, index, crc);
+
+		auto& state = m_streams;
+		const uint64 key = detail::StreamKey(playerID, streamID);
+
+		// 受信を終えた転送の、受信の確認が届かずに送信し直されたチャンク
+		if (const auto itFinished = state.finished.find(key); itFinished != state.finished.end())
+		{
+			if (itFinished->second.completed)
+			{
+				sendStreamAck(playerID, streamID, numChunks, false);
+			}
+			return;
+		}
+
+		auto it = state.incoming.find(key);
+
+		if (it == state.incoming.end())
+		{
+			// 大きすぎる転送や、チャンクの数がデータのサイズと合わない転送は受信しない
+			if ((state.option.maxReceiveSize < totalSize) || (numChunks == 0) || (Max<uint64>(totalSize, 1) < numChunks))
+			{
+				log(LogLevel::Warning, U"[Multiplayer_Photon] Stream rejected. playerID: ", playerID, U", streamID: ", streamID, U", size: ", totalSize, U" bytes, chunks: ", numChunks);
+				rejectStream(playerID, streamID);
+				return;
+			}
+
+			it = state.incoming.emplace(key, detail::IncomingStream{ .eventCode = eventCode, .totalSize = totalSize, .numChunks = numChunks }).first;
+		}
+
+		auto& stream = it->second;
+
+		// 重複したチャンクには受信の確認を返し、抜けがある場合は抜けごとに 1 回だけ送信し直しを要求する
+		if (index != stream.nextChunk)
+		{
+			if (index < stream.nextChunk)
+			{
+				sendStreamAck(playerID, streamID, stream.nextChunk, false);
+			}
+			else if (stream.requestedResend != stream.nextChunk)
+			{
+				stream.requestedResend = stream.nextChunk;
+				sendStreamAck(playerID, streamID, stream.nextChunk, true);
+			}
+			return;
+		}
+
+		const int64 size = (reader->size() - reader->getPos());
+		const size_t offset = stream.data.size();
+
+		// 最初に通知されたサイズを超えるデータは受信しない
+		if ((stream.totalSize - offset) < static_cast<uint64>(Max<int64>(size, 0)))
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Stream exceeded its size. playerID: ", playerID, U", streamID: ", streamID, U", size: ", stream.totalSize, U" bytes");
+			rejectStream(playerID, streamID);
+			return;
+		}
+
+		if (0 < size)
+		{
+			stream.data.resize(offset + static_cast<size_t>(size));
+			reader->read((stream.data.data() + offset), size);
+		}
+
+		if (detail::CRC32((stream.data.data() + offset), (stream.data.size() - offset)) != crc)
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Stream chunk checksum mismatch. playerID: ", playerID, U", streamID: ", streamID, U", chunk: ", index);
+			stream.data.resize(offset);
+
+			if (stream.requestedResend != stream.nextChunk)
+			{
+				stream.requestedResend = stream.nextChunk;
+				sendStreamAck(playerID, streamID, stream.nextChunk, true);
+			}
+			return;
+		}
+
+		++stream.nextChunk;
+		stream.requestedResend.reset();
+		sendStreamAck(playerID, streamID, stream.nextChunk, false);
+
+		const StreamProgress progress = detail::ToStreamProgress(key, stream);
+
+		if (stream.nextChunk < stream.numChunks)
+		{
+			onStreamProgress(progress);
+			return;
+		}
+
+		const Blob data = std::move(stream.data);
+		state.incoming.erase(it);
+		state.finished.emplace(key, detail::FinishedStream{ .finishedMillisec = Time::GetMillisec(), .completed = true });
+
+		onStreamProgress(progress);
+
+		if (data.size() != totalSize)
+		{
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Stream size mismatch. playerID: ", playerID, U", streamID: ", streamID, U", size: ", data.size(), U" / ", totalSize);
+			return;
+		}
+
+		receiveCustomEvent(playerID, eventCode, static_cast<const uint8*>(static_cast<const void*>(data.data())), data.size());
+	}
+
+	void Multiplayer_Photon::receiveStreamAck(const LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader)
+	{
+		uint32 streamID = 0;
+		uint32 nextChunk = 0;
+		bool resend = false;
+		reader(streamID, nextChunk, resend);
+
+		auto& outgoing = m_streams.outgoing;
+		const auto it = std::find_if(outgoing.begin(), outgoing.end(),
+			[=](const detail::OutgoingStream& stream) { return ((stream.streamID == streamID) && (stream.target == playerID)); });
+
+		if ((it == outgoing.end()) || (it->numChunks < nextChunk))
+		{
+			return;
+		}
+
+		auto& stream = *it;
+
+		// 確認済みより前からの要求や、すでに戻った抜けに対する要求は、古い要求なので無視する
+		if (resend)
+		{
+			if ((nextChunk < stream.ackedChunks) || (stream.resendFrom && (nextChunk <= *stream.resendFrom)))
+			{
+				return;
+			}
+
+			stream.resendFrom = nextChunk;
+		}
+
+		const bool progressed = (stream.ackedChunks < nextChunk);
+
+		if (progressed || resend)
+		{
+			stream.ackedChunks = nextChunk;
+			stream.lastAckMillisec = Time::GetMillisec();
+		}
+
+		if (resend)
+		{
+			stream.nextChunk = nextChunk;
+		}
+		else
+		{
+			stream.nextChunk = Max(stream.nextChunk, nextChunk);
+		}
+
+		if (not progressed)
+		{
+			return;
+		}
+
+		const StreamProgress progress = detail::ToStreamProgress(stream);
+
+		if (stream.numChunks <= stream.ackedChunks)
+		{
+			outgoing.erase(it);
+		}
+
+		onStreamProgress(progress);
+	}
+
+	void Multiplayer_Photon::receiveStreamCancel(const LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader)
+	{
+		uint32 streamID = 0;
+		bool fromSender = true;
+		reader(streamID, fromSender);
+
+		// 受信側が受信を拒否した、自分が送信している転送
+		if (not fromSender)
+		{
+			auto& outgoing = m_streams.outgoing;
+			const auto it = std::find_if(outgoing.begin(), outgoing.end(),
+				[=](const detail::OutgoingStream& stream) { return ((stream.streamID == streamID) && (stream.target == playerID)); });
+
+			if (it == outgoing.end())
+			{
+				return;
+			}
+
+			log(LogLevel::Warning, U"[Multiplayer_Photon] Stream rejected by the receiver. playerID: ", playerID, U", streamID: ", streamID);
+
+			const StreamProgress progress = detail::ToStreamProgress(*it);
+			outgoing.erase(it);
+
+			onStreamFailed(progress);
+			return;
+		}
+
+		const uint64 key = detail::StreamKey(playerID, streamID);
+		const auto it = m_streams.incoming.find(key);
+
+		if (it == m_streams.incoming.end())
+		{
+			return;
+		}
+
+		const StreamProgress progress = detail::ToStreamProgress(key, it->second);
+		m_streams.incoming.erase(it);
+
+		onStreamFailed(progress);
+	}
+
+	void Multiplayer_Photon::rejectStream(const LocalPlayerID playerID, const uint32 streamID)
+	{
+		auto& state = m_streams;
+		const uint64 key = detail::StreamKey(playerID, streamID);
+		Optional<StreamProgress> progress;
+
+		if (const auto it = state.incoming.find(key); it != state.incoming.end())
+		{
+			progress = detail::ToStreamProgress(key, it->second);
+			state.incoming.erase(it);
+		}
+
+		// 送信中のチャンクが届いても、受信を再開しない
+		state.finished.insert_or_assign(key, detail::FinishedStream{ .finishedMillisec = Time::GetMillisec(), .completed = false });
+
+		Serializer<MemoryWriter> writer;
+		writer(FromEnum(detail::SystemEvent::StreamCancel), streamID, false);
+		sendSystemEvent(writer, { playerID }, state.option.priorityIndex);
+
+		if (progress)
+		{
+			onStreamFailed(*progress);
+		}
+	}
+
+	void Multiplayer_Photon::rewindStreams(const LocalPlayerID playerID)
+	{
+		const uint64 now = Time::GetMillisec();
+
+		for (auto& stream : m_streams.outgoing)
+		{
+			if ((playerID == -1) || (stream.target == playerID))
+			{
+				stream.nextChunk = stream.ackedChunks;
+				stream.lastAckMillisec = now;
+				stream.resendFrom.reset();
+			}
+		}
+
+		// 自分が再参加した場合は、切断中に受信できなかったチャンクの送信し直しを要求する
+		if (playerID == -1)
+		{
+			for (auto& [key, stream] : m_streams.incoming)
+			{
+				stream.requestedResend = stream.nextChunk;
+				sendStreamAck(detail::StreamKeyToPlayerID(key), static_cast<uint32>(key), stream.nextChunk, true);
+			}
+		}
+	}
+
+	void Multiplayer_Photon::abortStreams(const LocalPlayerID playerID)
+	{
+		auto& state = m_streams;
+		Array<StreamProgress> failed;
+
+		state.outgoing.remove_if([&](const detail::OutgoingStream& stream)
+			{
+				if ((playerID != -1) && (stream.target != playerID))
+				{
+					return false;
+				}
+
+				failed << detail::ToStreamProgress(stream);
+				return true;
+			});
+
+		Array<uint64> keys;
+
+		for (const auto& [key, stream] : state.incoming)
+		{
+			if ((playerID == -1) || (detail::StreamKeyToPlayerID(key) == playerID))
+			{
+				failed << detail::ToStreamProgress(key, stream);
+				keys << key;
+			}
+		}
+
+		for (const auto key : keys)
 		{
-			return false;
+			state.incoming.erase(key);
 		}
 
-		const auto roomOption = ExitGames::LoadBalancing::RoomOptions()
-			.setMaxPlayers(static_cast<uint8>(maxPlayers))
-			.setPublishUserID(true);
-
-		return m_client->opCreateRoom(detail::ToJString(roomName), roomOption);
-	}
-
-	bool Multiplayer_Photon::createRoom(RoomNameView roomName, const RoomCreateOption& option)
-	{
-		if (not m_client)
+		if (playerID == -1)
 		{
-			return false;
+			state.finished.clear();
 		}
 
-		return m_client->opCreateRoom(detail::ToJString(roomName), detail::ToRoomOptions(option));
+		for (const auto& progress : failed)
+		{
+			onStreamFailed(progress);
+		}
 	}
+}
 
-	void Multiplayer_Photon::leaveRoom(bool willComeBack)
+/// Multiplayer_Photon (send scheduler)
+namespace s3d
+{
+	void Multiplayer_Photon::enableSendScheduler(const size_t bytesPerSec)
 	{
-		if (not m_client)
+		if (bytesPerSec == 0)
 		{
-			return;
+			throw Error{ U"[Multiplayer_Photon] bytesPerSec must be greater than 0" };
 		}
 
-		m_client->opLeaveRoom(willComeBack);
-	}
-
-	bool Multiplayer_Photon::reconnectAndRejoin()
-	{
-		if (not m_client)
+		if (not m_sendScheduler)
 		{
-			return false;
+			m_sendScheduler.emplace();
+			m_sendScheduler->lastUpdateMillisec = Time::GetMillisec();
 		}
 
-		auto state = getClientState();
+		m_sendScheduler->bytesPerSec = bytesPerSec;
+	}
 
-		if (state == ClientState::InLobby)
+	void Multiplayer_Photon::disableSendScheduler()
+	{
+		if (not m_sendScheduler)
 		{
-			constexpr bool rejoin = true;
-			return m_client->opJoinRoom(detail::ToJString(m_lastJoinedRoomName), rejoin);
+			return;
 		}
 
-		if (state == ClientState::Disconnected)
+		if (m_client && m_client->getIsInGameRoom())
 		{
-			return m_client->reconnectAndRejoin();
+			updateSendScheduler(true);
 		}
 
-		return false;
+		m_sendScheduler.reset();
 	}
 
-	void Multiplayer_Photon::joinEventTargetGroup(uint8 targetGroup)
+	bool Multiplayer_Photon::hasSendScheduler() const noexcept
 	{
-		joinEventTargetGroup(Array<uint8>{ targetGroup });
+		return m_sendScheduler.has_value();
 	}
 
-	void Multiplayer_Photon::joinEventTargetGroup(const Array<uint8>& targetGroups)
+	void Multiplayer_Photon::setSendChannelWeight(const uint8 priorityIndex, const double weight)
 	{
-		if (not m_client)
+		if (not (0.0 < weight))
 		{
-			return;
+			throw Error{ U"[Multiplayer_Photon] weight must be greater than 0" };
 		}
 
-		if (targetGroups.isEmpty())
-		{
-			return;
-		}
+		m_sendChannelWeights[priorityIndex] = weight;
+	}
 
-		for (const auto targetGroup : targetGroups)
+	SendSchedulerStats Multiplayer_Photon::getSendSchedulerStats() const
+	{
+		if (not m_sendScheduler)
 		{
-			if (not InRange(static_cast<int>(targetGroup), 1, 255)) {
-				throw Error{ U"[Multiplayer_Photon] targetGroups must be in a range of 1 to 255" };
-			}
+			return{};
 		}
 
-		auto joinGroups = ExitGames::Common::JVector<nByte>(targetGroups.data(), static_cast<uint32>(targetGroups.size()));
-		m_client->opChangeGroups(nullptr, &joinGroups);
+		return m_sendScheduler->stats;
 	}
 
-	void Multiplayer_Photon::joinAllEventTargetGroups()
+	void Multiplayer_Photon::submitEvent(const MultiplayerEvent& eventInfo, const Blob& data)
 	{
-		if (not m_client)
+		if (not m_sendScheduler)
 		{
+			raiseEvent(eventInfo, data);
 			return;
 		}
 
-		auto emptyJVector = ExitGames::Common::JVector<nByte>();
-
-		m_client->opChangeGroups(nullptr, &emptyJVector);
-	}
-
-	void Multiplayer_Photon::leaveEventTargetGroup(const uint8 targetGroup)
-	{
-		leaveEventTargetGroup(Array<uint8>{ targetGroup });
+		auto& state = *m_sendScheduler;
+		state.channels[eventInfo.priorityIndex()].events.push_back(detail::PendingEvent{ eventInfo, data });
+		++state.stats.queuedEvents;
+		state.stats.queuedBytes += data.size();
 	}
 
-	void Multiplayer_Photon::leaveEventTargetGroup(const Array<uint8>& targetGroups)
+	void Multiplayer_Photon::updateSendScheduler(const bool all)
 	{
-		if (not m_client)
+		if (not m_sendScheduler)
 		{
 			return;
 		}
 
-		if (targetGroups.isEmpty())
-		{
-			return;
-		}
+		auto& state = *m_sendScheduler;
+		const uint64 now = Time::GetMillisec();
+		const uint64 elapsedMillisec = (now - Min(state.lastUpdateMillisec, now));
+		state.lastUpdateMillisec = now;
 
-		for (const auto targetGroup : targetGroups)
+		// ルームにいない間は送信せずに持ち越し、送信できる量も貯めない
+		if (not m_client->getIsInGameRoom())
 		{
-			if (not InRange(static_cast<int>(targetGroup), 1, 255)) {
-				throw Error{ U"[Multiplayer_Photon] targetGroups must be in a range of 1 to 255" };
-			}
+			state.budget = Min(state.budget, 0.0);
+			return;
 		}
 
-		auto leaveGroups = ExitGames::Common::JVector<nByte>(targetGroups.data(), static_cast<uint32>(targetGroups.size()));
-		m_client->opChangeGroups(&leaveGroups, nullptr);
-	}
+		// まとめて送信するのは 100ms 分まで。キューが空の間も上限まで貯めておく。上限を超えて送信した分は次の update() で差し引く
+		const double maxBudget = (state.bytesPerSec / 10.0);
+		state.budget = Min((state.budget + state.bytesPerSec * (elapsedMillisec / 1000.0)), maxBudget);
 
-	void Multiplayer_Photon::leaveAllEventTargetGroups()
-	{
-		if (not m_client)
+		if (state.stats.queuedEvents == 0)
 		{
 			return;
 		}
 
-		auto emptyJVector = ExitGames::Common::JVector<nByte>();
+		while ((all || (0.0 < state.budget)) && state.stats.queuedEvents)
+		{
+			// 待っているプライオリティインデックスの優先度を重みの分だけ上げ、最も高いものを選ぶ
+			detail::SendChannel* selected = nullptr;
 
-		m_client->opChangeGroups(&emptyJVector, nullptr);
-	}
-}
+			for (auto& [priorityIndex, channel] : state.channels)
+			{
+				if (channel.events.size() <= channel.head)
+				{
+					continue;
+				}
 
-/// Multiplayer_Photon::sendEvent
-namespace s3d
-{
-	namespace detail
-	{
-		[[nodiscard]]
-		static ExitGames::LoadBalancing::RaiseEventOptions MakeRaiseEventOptions(const Optional<Array<LocalPlayerID>>& targets)
-		{
-			ExitGames::LoadBalancing::RaiseEventOptions options{};
+				const auto it = m_sendChannelWeights.find(priorityIndex);
+				channel.priority += ((it != m_sendChannelWeights.end()) ? it->second : 1.0);
 
-			if (targets)
+				if ((not selected) || (selected->priority < channel.priority))
+				{
+					selected = &channel;
+				}
+			}
+
+			if (not selected)
 			{
-				options.setTargetPlayers(targets->data(), static_cast<short>(targets->size()));
+				break;
 			}
 
-			return options;
+			selected->priority = 0.0;
+
+			const auto& pending = selected->events[selected->head++];
+			raiseEvent(pending.event, pending.data);
+
+			state.budget -= static_cast<double>(pending.data.size());
+			--state.stats.queuedEvents;
+			state.stats.queuedBytes -= pending.data.size();
+			++state.stats.sentEvents;
+
+			// 送信済みのイベントが半分を超えたら詰める
+			if (selected->events.size() <= selected->head)
+			{
+				selected->events.clear();
+				selected->head = 0;
+			}
+			else if ((selected->events.size() / 2) < selected->head)
+			{
+				selected->events.erase(selected->events.begin(), (selected->events.begin() + selected->head));
+				selected->head = 0;
+			}
 		}
-	}
 
-	static constexpr bool Reliable = true;
+		if (state.stats.queuedEvents)
+		{
+			++state.stats.deferredUpdates;
+		}
+	}
 
-	void Multiplayer_Photon::sendEvent(const MultiplayerEvent& eventInfo, const Serializer<MemoryWriter>& writer)
+	void Multiplayer_Photon::flushSendScheduler()
 	{
-		if (not m_client)
+		if ((not m_sendScheduler) || (m_sendScheduler->stats.queuedEvents == 0))
 		{
 			return;
 		}
 
-		uint8 receiver = ExitGames::Lite::ReceiverGroup::OTHERS;
-		uint8 caching = ExitGames::Lite::EventCache::DO_NOT_CACHE;
-
-		switch (eventInfo.receiverOption())
+		if (m_client && m_client->getIsInGameRoom())
 		{
-		case ReceiverOption::Others:
-			break;
-		case ReceiverOption::Others_CacheUntilLeaveRoom:
-			caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE;
-			break;
-		case ReceiverOption::Others_CacheForever:
-			caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE_GLOBAL;
-			break;
-		case ReceiverOption::All:
-			receiver = ExitGames::Lite::ReceiverGroup::ALL;
-			break;
-		case ReceiverOption::All_CacheUntilLeaveRoom:
-			receiver = ExitGames::Lite::ReceiverGroup::ALL;
-			caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE;
-			break;
-		case ReceiverOption::All_CacheForever:
-			receiver = ExitGames::Lite::ReceiverGroup::ALL;
-			caching = ExitGames::Lite::EventCache::ADD_TO_ROOM_CACHE_GLOBAL;
-			break;
-		case ReceiverOption::Host:
-			receiver = ExitGames::Lite::ReceiverGroup::MASTER_CLIENT;
-			break;
+			updateSendScheduler(true);
 		}
-
-		const auto eventOptions = detail::MakeRaiseEventOptions(eventInfo.targetList())
-			.setChannelID(eventInfo.priorityIndex())
-			.setInterestGroup(eventInfo.targetGroup())
-			.setReceiverGroup(receiver)
-			.setEventCaching(caching);
-
-		const auto& blob = writer->getBlob();
-		const size_t size = blob.size();
-		const uint8* src = static_cast<const uint8*>(static_cast<const void*>(blob.data()));
-
-		m_client->opRaiseEvent(Reliable, src, static_cast<unsigned int>(size), eventInfo.eventCode(), eventOptions);
 	}
 }
 
@@ -1204,6 +5827,7 @@ namespace s3d
 			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
 		}
 
+		flushSendScheduler();
 		m_client->opRaiseEvent(Reliable, ExitGames::Common::Hashtable(), eventCode, ExitGames::LoadBalancing::RaiseEventOptions().setEventCaching(ExitGames::Lite::EventCache::REMOVE_FROM_ROOM_CACHE));
 	}
 
@@ -1221,6 +5845,7 @@ namespace s3d
 
 		auto option = detail::MakeRaiseEventOptions(targets).setEventCaching(ExitGames::Lite::EventCache::REMOVE_FROM_ROOM_CACHE);
 
+		flushSendScheduler();
 		m_client->opRaiseEvent(Reliable, ExitGames::Common::Hashtable(), eventCode, option);
 	}
 
@@ -1391,6 +6016,9 @@ namespace s3d
 			return;
 		}
 
+		// 再接続したときにも同じ名前を使う
+		m_lastUserName = userName;
+
 		m_client->getLocalPlayer().setName(detail::ToJString(userName));
 	}
 
@@ -1421,18 +6049,7 @@ namespace s3d
 			return{};
 		}
 
-		const auto& room = m_client->getCurrentlyJoinedRoom();
-
-		RoomInfo roomInfo
-		{
-			.name = detail::ToString(room.getName()),
-			.playerCount = room.getPlayerCount(),
-			.maxPlayers = room.getMaxPlayers(),
-			.isOpen = room.getIsOpen(),
-			.properties = detail::PhotonHashtableToStringHashTable(room.getCustomProperties()),
-		};
-
-		return roomInfo;
+		return detail::ToRoomInfo(m_client->getCurrentlyJoinedRoom());
 	}
 
 	String Multiplayer_Photon::getCurrentRoomName() const
@@ -1652,12 +6269,288 @@ namespace s3d
 	}
 }
 
+/// EventDispatchTable, MultiplayerMultiplexer
+namespace s3d
+{
+	namespace detail
+	{
+		std::shared_ptr<const EventDispatchTable> InternEventDispatchTable(const EventDispatchTable& table)
+		{
+			static std::mutex mutex;
+			static Array<std::weak_ptr<const EventDispatchTable>> tables;
+
+			std::lock_guard lock{ mutex };
+
+			tables.remove_if([](const std::weak_ptr<const EventDispatchTable>& weak) { return weak.expired(); });
+
+			for (const auto& weak : tables)
+			{
+				if (auto shared = weak.lock(); shared && (*shared == table))
+				{
+					return shared;
+				}
+			}
+
+			auto shared = std::make_shared<const EventDispatchTable>(table);
+			tables << shared;
+			return shared;
+		}
+
+		struct MultiplexerQueue
+		{
+			std::mutex mutex;
+
+			std::deque<Multiplayer_Photon*> tasks;
+		};
+
+		struct MultiplexerShared
+		{
+			explicit MultiplexerShared(const size_t numQueues)
+				: queues{ std::make_unique<MultiplexerQueue[]>(numQueues) }
+				, numQueues{ numQueues } {}
+
+			/// @brief スレッドごとのキュー。0 番は update() を呼んだスレッドが使う
+			std::unique_ptr<MultiplexerQueue[]> queues;
+
+			size_t numQueues = 0;
+
+			std::mutex mutex;
+
+			std::condition_variable workAvailable;
+
+			std::condition_variable workDone;
+
+			/// @brief update() のたびに増える番号。ワーカーはこれが変わったら処理を始める
+			uint64 generation = 0;
+
+			bool quit = false;
+
+			/// @brief 現在の update() で、まだ処理が終わっていないクライアントの数
+			std::atomic<size_t> remaining{ 0 };
+
+			std::atomic<uint64> totalMicrosec{ 0 };
+
+			std::atomic<uint64> maxMicrosec{ 0 };
+
+			std::atomic<uint64> stolenTasks{ 0 };
+
+			/// @brief クライアントの update() が投げた最初の例外
+			std::exception_ptr exception;
+
+			/// @brief 自分のキューの先頭から、空であれば他のスレッドのキューの末尾からクライアントを取り出します。
+			[[nodiscard]]
+			Multiplayer_Photon* pop(const size_t self)
+			{
+				{
+					auto& queue = queues[self];
+					std::lock_guard lock{ queue.mutex };
+
+					if (not queue.tasks.empty())
+					{
+						Multiplayer_Photon* task = queue.tasks.front();
+						queue.tasks.pop_front();
+						return task;
+					}
+				}
+
+				for (size_t i = 1; i < numQueues; ++i)
+				{
+					auto& victim = queues[(self + i) % numQueues];
+					std::lock_guard lock{ victim.mutex };
+
+					if (not victim.tasks.empty())
+					{
+						Multiplayer_Photon* task = victim.tasks.back();
+						victim.tasks.pop_back();
+						stolenTasks.fetch_add(1, std::memory_order_relaxed);
+						return task;
+					}
+				}
+
+				return nullptr;
+			}
+
+			void run(const size_t self)
+			{
+				while (Multiplayer_Photon* client = pop(self))
+				{
+					const uint64 begin = Time::GetMicrosec();
+
+					try
+					{
+						client->update();
+					}
+					catch (...)
+					{
+						std::lock_guard lock{ mutex };
+
+						if (not exception)
+						{
+							exception = std::current_exception();
+						}
+					}
+
+					const uint64 elapsed = (Time::GetMicrosec() - begin);
+					totalMicrosec.fetch_add(elapsed, std::memory_order_relaxed);
+
+					uint64 currentMax = maxMicrosec.load(std::memory_order_relaxed);
+					while ((currentMax < elapsed) && (not maxMicrosec.compare_exchange_weak(currentMax, elapsed, std::memory_order_relaxed))) {}
+
+					if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					{
+						{
+							std::lock_guard lock{ mutex };
+						}
+
+						workDone.notify_one();
+					}
+				}
+			}
+		};
+	}
+
+	MultiplayerMultiplexer::MultiplayerMultiplexer(const size_t numWorkers)
+		: m_shared{ std::make_unique<detail::MultiplexerShared>(numWorkers + 1) }
+	{
+		m_workers.reserve(numWorkers);
+
+		for (size_t i = 0; i < numWorkers; ++i)
+		{
+			m_workers.emplace_back([shared = m_shared.get(), index = (i + 1)]()
+				{
+					uint64 generation = 0;
+
+					for (;;)
+					{
+						{
+							std::unique_lock lock{ shared->mutex };
+							shared->workAvailable.wait(lock, [&]() { return (shared->quit || (shared->generation != generation)); });
+
+							if (shared->quit)
+							{
+								return;
+							}
+
+							generation = shared->generation;
+						}
+
+						shared->run(index);
+					}
+				});
+		}
+
+		m_stats.numThreads = (numWorkers + 1);
+	}
+
+	MultiplayerMultiplexer::~MultiplayerMultiplexer()
+	{
+		{
+			std::lock_guard lock{ m_shared->mutex };
+			m_shared->quit = true;
+		}
+
+		m_shared->workAvailable.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void MultiplayerMultiplexer::add(Multiplayer_Photon& client)
+	{
+		if (m_clients.contains(&client))
+		{
+			return;
+		}
+
+		m_clients << &client;
+	}
+
+	void MultiplayerMultiplexer::remove(const Multiplayer_Photon& client)
+	{
+		m_clients.remove(const_cast<Multiplayer_Photon*>(&client));
+	}
+
+	size_t MultiplayerMultiplexer::num_clients() const noexcept
+	{
+		return m_clients.size();
+	}
+
+	void MultiplayerMultiplexer::update()
+	{
+		auto& shared = *m_shared;
+
+		m_stats.numClients = m_clients.size();
+		m_stats.tickMicrosec = 0;
+		m_stats.totalClientMicrosec = 0;
+		m_stats.maxClientMicrosec = 0;
+		m_stats.stolenTasks = 0;
+
+		if (m_clients.isEmpty())
+		{
+			return;
+		}
+
+		const uint64 begin = Time::GetMicrosec();
+
+		shared.totalMicrosec.store(0, std::memory_order_relaxed);
+		shared.maxMicrosec.store(0, std::memory_order_relaxed);
+		shared.stolenTasks.store(0, std::memory_order_relaxed);
+
+		// キューに積む前に設定しておく（前回の処理を終えたワーカーがすぐに取り出すことがある）
+		shared.remaining.store(m_clients.size(), std::memory_order_release);
+
+		for (size_t i = 0; i < m_clients.size(); ++i)
+		{
+			auto& queue = shared.queues[i % shared.numQueues];
+			std::lock_guard lock{ queue.mutex };
+			queue.tasks.push_back(m_clients[(m_rotation + i) % m_clients.size()]);
+		}
+
+		m_rotation = ((m_rotation + 1) % m_clients.size());
+
+		{
+			std::lock_guard lock{ shared.mutex };
+			++shared.generation;
+		}
+
+		shared.workAvailable.notify_all();
+
+		shared.run(0);
+
+		std::exception_ptr exception;
+		{
+			std::unique_lock lock{ shared.mutex };
+			shared.workDone.wait(lock, [&]() { return (shared.remaining.load(std::memory_order_acquire) == 0); });
+			std::swap(exception, shared.exception);
+		}
+
+		m_stats.tickMicrosec = (Time::GetMicrosec() - begin);
+		m_stats.totalClientMicrosec = shared.totalMicrosec.load(std::memory_order_relaxed);
+		m_stats.maxClientMicrosec = shared.maxMicrosec.load(std::memory_order_relaxed);
+		m_stats.stolenTasks = shared.stolenTasks.load(std::memory_order_relaxed);
+
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+	const MultiplexerStats& MultiplayerMultiplexer::getStats() const noexcept
+	{
+		return m_stats;
+	}
+}
+
 namespace s3d
 {
 	template<>
 	void Multiplayer_Photon::sendEvent<>(const MultiplayerEvent& event)
 	{
-		sendEvent(event, Serializer<MemoryWriter> {});
+		auto& writer = m_frameBuffers.sendWriter;
+		writer->clear();
+		sendEvent(event, writer);
 	}
 
 
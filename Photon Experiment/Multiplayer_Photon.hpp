@@ -18,6 +18,22 @@
 
 # pragma once
 # include <Siv3D.hpp>
+# include "PackedArchive.hpp"
+
+// 1 を定義すると、service() やイベントのディスパッチにかかった時間をトレースとして記録できるようになります。
+// 0 の場合、計測のためのコードは生成されません。
+// ヘッダ内のテンプレートも値によって中身が変わるため、プロジェクトのプリプロセッサの定義などで、すべての翻訳単位に同じ値を定義してください。
+# ifndef MULTIPLAYER_PHOTON_TRACE
+#	define MULTIPLAYER_PHOTON_TRACE 0
+# endif
+
+# if MULTIPLAYER_PHOTON_TRACE
+#	define MULTIPLAYER_PHOTON_DETAIL_CONCAT_IMPL(a, b) a##b
+#	define MULTIPLAYER_PHOTON_DETAIL_CONCAT(a, b) MULTIPLAYER_PHOTON_DETAIL_CONCAT_IMPL(a, b)
+#	define MULTIPLAYER_PHOTON_TRACE_SCOPE(buffer, name, eventCode) const ::s3d::detail::TraceScope MULTIPLAYER_PHOTON_DETAIL_CONCAT(multiplayerPhotonTraceScope, __LINE__){ (buffer), (name), (eventCode) }
+# else
+#	define MULTIPLAYER_PHOTON_TRACE_SCOPE(buffer, name, eventCode) ((void)0)
+# endif
 
 # if SIV3D_PLATFORM(WINDOWS)
 #	if SIV3D_BUILD(DEBUG)
@@ -55,6 +71,9 @@ namespace s3d
 	/// @brief ルームプロパティのハッシュテーブル
 	using RoomPropertyTable = HashTable<uint8, String>;
 
+	/// @brief SQL ロビーで検索できるルームプロパティのハッシュテーブル。キーは列番号（0～9）で、Photon の C0～C9 に対応します
+	using LobbyFilterPropertyTable = HashTable<uint8, int32>;
+
 	/// @brief ルーム内のローカルプレイヤーの情報
 	struct LocalPlayer
 	{
@@ -91,6 +110,9 @@ namespace s3d
 
 		// @brief ロビーから参照可能なルームプロパティ
 		RoomPropertyTable properties;
+
+		/// @brief SQL ロビーで検索できるルームプロパティ
+		LobbyFilterPropertyTable filterProperties;
 	};
 
 	/// @brief 通信時に用いるプロトコル
@@ -148,6 +170,17 @@ namespace s3d
 		/// @return 続けてメソッドを呼び出すための *this 参照
 		RoomCreateOption& roomDestroyGracePeriod(Milliseconds roomDestroyGracePeriod);
 
+		/// @brief ルームを作成する SQL ロビーを設定します。
+		/// @param lobbyName SQL ロビーの名前。空の場合は既定のロビー
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		/// @remark SQL ロビーのルームは getRoomList() には含まれません。requestRoomList() で検索してください。
+		RoomCreateOption& lobby(StringView lobbyName);
+
+		/// @brief SQL ロビーで検索できるルームプロパティを設定します。
+		/// @param filterProperties 列番号（0～9）と値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		RoomCreateOption& filterProperties(const LobbyFilterPropertyTable& filterProperties);
+
 		[[nodiscard]]
 		bool isVisible() const noexcept;
 
@@ -169,6 +202,12 @@ namespace s3d
 		[[nodiscard]]
 		Milliseconds roomDestroyGracePeriod() const noexcept;
 
+		[[nodiscard]]
+		const String& lobby() const noexcept;
+
+		[[nodiscard]]
+		const LobbyFilterPropertyTable& filterProperties() const noexcept;
+
 	private:
 
 		bool m_isVisible = true;
@@ -184,6 +223,131 @@ namespace s3d
 		Optional<Milliseconds> m_rejoinGracePeriod = 0ms;
 
 		Milliseconds m_roomDestroyGracePeriod = 0ms;
+
+		String m_lobbyName;
+
+		LobbyFilterPropertyTable m_filterProperties{};
+	};
+
+	/// @brief SQL ロビーのルームを検索する条件
+	/// @remark 条件はすべて AND で結合されます。
+	class LobbyQuery
+	{
+	public:
+
+		/// @brief 検索する SQL ロビーを指定して、条件を作成します。
+		/// @param lobbyName SQL ロビーの名前
+		SIV3D_NODISCARD_CXX20
+		explicit LobbyQuery(StringView lobbyName);
+
+		/// @brief 列の値が value と等しいルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& equal(uint8 column, int32 value);
+
+		/// @brief 列の値が value と異なるルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& notEqual(uint8 column, int32 value);
+
+		/// @brief 列の値が value より小さいルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& less(uint8 column, int32 value);
+
+		/// @brief 列の値が value 以下のルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& lessEqual(uint8 column, int32 value);
+
+		/// @brief 列の値が value より大きいルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& greater(uint8 column, int32 value);
+
+		/// @brief 列の値が value 以上のルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& greaterEqual(uint8 column, int32 value);
+
+		/// @brief 列の値が min 以上 max 以下のルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param min 最小値
+		/// @param max 最大値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& between(uint8 column, int32 min, int32 max);
+
+		/// @brief 列の値が values のいずれかと等しいルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param values 値の一覧
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& anyOf(uint8 column, const Array<int32>& values);
+
+		/// @brief 真偽値を 1 と 0 で保存した列が value であるルームに絞り込みます。
+		/// @param column 列番号（0～9）
+		/// @param value 真偽値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& is(uint8 column, bool value);
+
+		/// @brief SQL の条件式をそのまま追加します。
+		/// @param condition 条件式（例: U"C0 > 10 OR C1 = 2"）
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& where(StringView condition);
+
+		/// @brief 結果を並べる列を設定します。requestNextRoomListPage() で続きを取得するには、thenBy() も必要です。
+		/// @param column 列番号（0～9）
+		/// @param descending 降順に並べる場合 true, 昇順の場合は false
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& orderBy(uint8 column, bool descending = false);
+
+		/// @brief orderBy() で設定した列の値が同じルームを並べる列を設定します。
+		/// @param uniqueColumn ルームごとに異なる値を設定した列の列番号（0～9）
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		/// @remark ページの境目で orderBy() の列の値が同じルームを取りこぼさないように、requestNextRoomListPage() はこの列も使って続きの位置を決めます。
+		LobbyQuery& thenBy(uint8 uniqueColumn);
+
+		/// @brief orderBy() と thenBy() で設定した並び順で、(value, uniqueValue) より後のルームに絞り込みます（ページング用）。
+		/// @param value 前のページの最後のルームの orderBy() の列の値
+		/// @param uniqueValue 前のページの最後のルームの thenBy() の列の値
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		LobbyQuery& after(int32 value, int32 uniqueValue);
+
+		[[nodiscard]]
+		const String& lobbyName() const noexcept;
+
+		[[nodiscard]]
+		const Optional<uint8>& orderColumn() const noexcept;
+
+		[[nodiscard]]
+		const Optional<uint8>& uniqueColumn() const noexcept;
+
+		[[nodiscard]]
+		bool isDescending() const noexcept;
+
+		/// @brief Photon に送る SQL のフィルタを返します。
+		/// @return SQL のフィルタ
+		[[nodiscard]]
+		String toSQL() const;
+
+	private:
+
+		String m_lobbyName;
+
+		Array<String> m_conditions;
+
+		Optional<uint8> m_orderColumn;
+
+		Optional<uint8> m_uniqueColumn;
+
+		bool m_descending = false;
+
+		Optional<std::pair<int32, int32>> m_after;
 	};
 
 	/// @brief ランダム入室時のマッチメイキングモード
@@ -297,6 +461,93 @@ namespace s3d
 		Optional<Array<LocalPlayerID>> m_targetList;
 	};
 
+	/// @brief 2D ワールドのグリッドをイベントターゲットグループに対応させる空間インタレスト管理のオプション
+	/// @remark セル (column, row) はイベントターゲットグループ 1 + row * columns + column に対応します。
+	class SpatialInterestOption
+	{
+	public:
+		[[nodiscard]]
+		constexpr SpatialInterestOption() = default;
+
+		/// @brief グリッドの左上のワールド座標を設定します。
+		/// @param origin グリッドの左上のワールド座標
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		SpatialInterestOption& origin(const Vec2& origin);
+
+		/// @brief セルの一辺の長さを設定します。
+		/// @param cellSize セルの一辺の長さ（0 より大きい値）
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		SpatialInterestOption& cellSize(double cellSize);
+
+		/// @brief グリッドのセル数を設定します。
+		/// @param columns 横方向のセル数
+		/// @param rows 縦方向のセル数
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		/// @remark columns * rows は 1 以上 255 以下である必要があります。
+		SpatialInterestOption& gridSize(int32 columns, int32 rows);
+
+		/// @brief 購読を開始する距離を設定します。自分の位置からセルまでの距離がこの値以下になると購読します。
+		/// @param radius 購読を開始する距離
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		SpatialInterestOption& subscribeRadius(double radius);
+
+		/// @brief 購読を解除するまでの余裕を設定します。セルまでの距離が subscribeRadius + hysteresis を超えると購読を解除します。
+		/// @param hysteresis 購読を解除するまでの余裕
+		/// @return 続けてメソッドを呼び出すための *this 参照
+		/// @remark セルの境界付近を行き来したときに購読と解除が繰り返されるのを防ぎます。
+		SpatialInterestOption& hysteresis(double hysteresis);
+
+		[[nodiscard]]
+		const Vec2& origin() const noexcept;
+
+		[[nodiscard]]
+		double cellSize() const noexcept;
+
+		[[nodiscard]]
+		int32 columns() const noexcept;
+
+		[[nodiscard]]
+		int32 rows() const noexcept;
+
+		[[nodiscard]]
+		double subscribeRadius() const noexcept;
+
+		[[nodiscard]]
+		double hysteresis() const noexcept;
+
+		/// @brief グリッドのセルの総数を返します。
+		/// @return グリッドのセルの総数
+		[[nodiscard]]
+		int32 num_cells() const noexcept;
+
+		/// @brief 指定したワールド座標を含むセルのイベントターゲットグループを返します。
+		/// @param pos ワールド座標
+		/// @return イベントターゲットグループ（1以上255以下の整数）
+		/// @remark グリッドの外側の座標は最も近いセルに割り当てられます。
+		[[nodiscard]]
+		uint8 groupAt(const Vec2& pos) const noexcept;
+
+		/// @brief 指定したイベントターゲットグループに対応するセルの領域を返します。
+		/// @param targetGroup イベントターゲットグループ（1以上 num_cells() 以下の整数）
+		/// @return セルの領域
+		[[nodiscard]]
+		RectF cellRect(uint8 targetGroup) const noexcept;
+
+	private:
+
+		Vec2 m_origin{ 0, 0 };
+
+		double m_cellSize = 100.0;
+
+		int32 m_columns = 15;
+
+		int32 m_rows = 15;
+
+		double m_subscribeRadius = 100.0;
+
+		double m_hysteresis = 25.0;
+	};
+
 	/// @brief Multiplayer_Photon クライアントの状態
 	enum class ClientState : uint8 {
 		Disconnected,
@@ -308,177 +559,1234 @@ namespace s3d
 		Disconnecting,
 	};
 
-	class Multiplayer_Photon;
+	/// @brief ログの重要度
+	enum class LogLevel : uint8 {
+		Trace,
+		Debug,
+		Info,
+		Warning,
+		Error,
+		/// @brief ログを出力しない
+		None,
+	};
 
-	namespace detail
+	/// @brief イベントコードごとの通信量と処理時間
+	struct EventTrafficStats
 	{
-		using TypeErasedCallback = void(Multiplayer_Photon::*)();
-		using CallbackWrapper = void(*)(Multiplayer_Photon&, TypeErasedCallback, LocalPlayerID, Deserializer<MemoryViewReader>&);
+		/// @brief イベントコード（0 はライブラリ内部で使うイベント）
+		uint8 eventCode = 0;
 
-		using CustomEventReceiver = std::pair<TypeErasedCallback, CallbackWrapper>;
-	}
+		/// @brief 送信したイベントの数
+		uint64 sentCount = 0;
 
-	/// @brief マルチプレイヤー用クラス (Photon バックエンド)
-	class Multiplayer_Photon
-	{
-	public:
+		/// @brief 受信したイベントの数
+		uint64 receivedCount = 0;
 
-		/// @brief デフォルトコンストラクタ。このコンストラクタを使用する場合は後で init を呼び出してください。
-		SIV3D_NODISCARD_CXX20
-		Multiplayer_Photon();
+		/// @brief 送信したデータのサイズ（バイト）
+		uint64 sentBytes = 0;
 
-		/// @brief マルチプレイヤー用クラスを作成します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		SIV3D_NODISCARD_CXX20
-		Multiplayer_Photon(std::string_view secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief 受信したデータのサイズ（バイト）
+		uint64 receivedBytes = 0;
 
-		/// @brief マルチプレイヤー用クラスを作成します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		SIV3D_NODISCARD_CXX20
-		Multiplayer_Photon(StringView secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief シリアライズにかかった時間の合計（マイクロ秒）
+		uint64 serializeMicrosec = 0;
 
-		/// @brief マルチプレイヤー用クラスを作成します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param logger デバッグ用のログの出力先関数
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		SIV3D_NODISCARD_CXX20
-		Multiplayer_Photon(std::string_view secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief デシリアライズにかかった時間の合計（マイクロ秒）
+		uint64 deserializeMicrosec = 0;
 
-		/// @brief マルチプレイヤー用クラスを作成します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param logger デバッグ用のログの出力先関数
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		SIV3D_NODISCARD_CXX20
-		Multiplayer_Photon(StringView secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief 受信時のコールバックの実行にかかった時間の合計（マイクロ秒）
+		uint64 callbackMicrosec = 0;
 
-		/// @brief デストラクタ
-		virtual ~Multiplayer_Photon();
+		/// @brief 受信キューがあふれて破棄した（または新しいイベントで置き換えた）イベントの数
+		uint64 droppedCount = 0;
+	};
 
-		/// @brief マルチプレイヤー用クラスを初期化します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		void init(std::string_view secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+	/// @brief 受信キューが一杯のときの、イベントコードごとの扱い
+	enum class ReceivePolicy : uint8
+	{
+		/// @brief 破棄しない。キューが一杯の間は、Photon の受信キューに残したまま新しいイベントを取り出さない
+		/// @remark ただし、キューの容量の 4 倍に達した場合は、メモリを使い続けないように新しいイベントを破棄します（ReceiveQueueStats::droppedEvents に数えます）
+		NeverDrop,
 
-		/// @brief マルチプレイヤー用クラスを初期化します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		void init(StringView secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief 送信者ごとに最新のイベントだけを残す。まだ処理されていない同じ送信者のイベントを置き換える
+		KeepLatest,
 
-		/// @brief マルチプレイヤー用クラスを初期化します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param logger デバッグ用のログの出力先関数
-		/// @param verbose デバッグ用の logger 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		void init(std::string_view secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger = {}, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+		/// @brief キューが一杯のとき、このポリシーのイベントから古いものを破棄する
+		DropOldest,
+	};
 
-		/// @brief マルチプレイヤー用クラスを初期化します。
-		/// @param secretPhotonAppID Photon アプリケーション ID
-		/// @param photonAppVersion アプリケーションのバージョン
-		/// @param logger デバッグ用のログの出力先関数
-		/// @param verbose デバッグ用の logger 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
-		/// @param protocol 通信に用いるプロトコル
-		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
-		void init(StringView secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger = {}, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+	/// @brief 受信キューの状態
+	struct ReceiveQueueStats
+	{
+		/// @brief 処理を待っているイベントの数
+		size_t queued = 0;
 
-		/// @brief Photon サーバへの接続を試みます。
-		/// @param userName ユーザ名
-		/// @param region 接続するサーバのリージョン。unspecified の場合は利用可能なサーバのうち最速のものが選択されます。
-		/// @remark リージョンは https://doc.photonengine.com/en-us/pun/current/connection-and-authentication/regions を参照してください。
-		/// @remark Web版では必ず region を設定する必要があります。
-		bool connect(StringView userName, const Optional<String>& region = unspecified);
+		/// @brief これまでに処理を待っていたイベントの数の最大値
+		size_t peakQueued = 0;
 
-		/// @brief Photon サーバから切断を試みます。
-		void disconnect();
+		/// @brief キューがあふれて破棄したイベントの数
+		uint64 droppedEvents = 0;
 
-		/// @brief サーバーと同期します。
-		/// @remark 6 秒間以上この関数を呼ばないと自動的に切断されます。
-		void update();
+		/// @brief ReceivePolicy::KeepLatest で置き換えたイベントの数
+		uint64 replacedEvents = 0;
 
-		/// @brief update() を呼ぶ必要がある状態であるかを返します。not isDisconnected() と同じです。
-		/// @return  update() を呼ぶ必要がある状態である場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isActive() const;
+		/// @brief 時間の上限に達して、処理を次の update() に持ち越した回数
+		uint64 deferredUpdates = 0;
 
-		/// @brief クライアントの状態を返します。
-		/// @return 現在のクライアントの状態
-		[[nodiscard]]
-		ClientState getClientState() const;
+		/// @brief キューが一杯で、Photon からイベントを取り出さなかった update() の回数
+		uint64 backpressureUpdates = 0;
 
-		/// @brief サーバーから切断されているかを返します。
-		/// @return サーバーから切断されている場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isDisconnected() const;
+		/// @brief キューが一杯の状態が 100ms を超えて続き、容量を超えてイベントを取り出した update() の回数
+		uint64 forcedUpdates = 0;
+	};
 
-		/// @brief ロビーに接続中かを返します。
-		/// @return ロビーに接続中の場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isConnectingToLobby() const;
+	/// @brief サーバとの時刻同期の状態
+	struct ClockSyncStats
+	{
+		/// @brief 推定したローカルの時刻（Time::GetMicrosec()）から共有時刻へのオフセット（マイクロ秒）
+		int64 offsetMicrosec = 0;
 
-		/// @brief 自分がロビーにいるかを返します。
-		/// @return ロビーにいる場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isInLobby() const;
+		/// @brief 推定したローカルの時計のずれの速さ（ppm）
+		double driftPPM = 0.0;
 
-		/// @brief ルームに参加中かを返します。
-		/// @return ルームに参加中の場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isJoiningRoom() const;
+		/// @brief 採用されたサンプルの最小のラウンドトリップタイム（ミリ秒）
+		int32 minRoundTripMillisec = 0;
 
-		/// @brief 自分がルームに参加しているかを返します。
-		/// @return ルームに参加している場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isInRoom() const;
+		/// @brief 採用されたサンプルのオフセットのばらつき（マイクロ秒）
+		int64 jitterMicrosec = 0;
 
-		/// @brief ルームから退出中かを返します。
-		/// @return ルームから退出中の場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isLeavingRoom() const;
+		/// @brief 保持しているサンプルの数
+		size_t numSamples = 0;
 
-		/// @brief サーバーから切断中かを返します。
-		/// @return サーバーから切断中の場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isDisconnecting() const;
+		/// @brief 外れ値として除外されたサンプルの累計
+		size_t numRejected = 0;
 
-		/// @brief 自分がロビーまたはルームにいるかを返します。
-		/// @return ロビーまたはルームいる場合 true, それ以外の場合は false
-		[[nodiscard]]
-		bool isInLobbyOrInRoom() const;
+		/// @brief 同期済みであるか
+		bool synchronized = false;
+	};
 
-		/// @brief 存在するルームの一覧を返します。
-		/// @return 存在するルームの一覧
-		[[nodiscard]]
-		Array<RoomInfo> getRoomList() const;
+	/// @brief 一定の期間における通信量のレート
+	struct TrafficRate
+	{
+		/// @brief 受信したデータのサイズ（バイト/秒）
+		double bytesInPerSec = 0.0;
 
-		/// @brief 存在するルームの名前の一覧を返します。
-		/// @return 存在するルームの名前の一覧
-		[[nodiscard]]
-		Array<RoomName> getRoomNameList() const;
+		/// @brief 送信したデータのサイズ（バイト/秒）
+		double bytesOutPerSec = 0.0;
 
-		/// @brief サーバのタイムスタンプ（ミリ秒）を返します。
-		/// @return サーバのタイムスタンプ（ミリ秒）
-		[[nodiscard]]
-		int32 getServerTimeMillisec() const;
+		/// @brief 受信したパケットの数（個/秒）
+		double packetsInPerSec = 0.0;
 
-		/// @brief サーバのタイムスタンプとクライアントのシステムのタイムスタンプのオフセット（ミリ秒）を返します。
-		/// @return サーバのタイムスタンプとクライアントのシステムのタイムスタンプのオフセット（ミリ秒）
+		/// @brief 送信したパケットの数（個/秒）
+		double packetsOutPerSec = 0.0;
+	};
+
+	/// @brief 直近 1 秒、10 秒、60 秒の通信量のレート
+	struct TrafficRates
+	{
+		TrafficRate last1s;
+
+		TrafficRate last10s;
+
+		TrafficRate last60s;
+	};
+
+	/// @brief 直前の update() の処理時間の内訳
+	struct UpdateTimingStats
+	{
+		/// @brief update() 全体にかかった時間（マイクロ秒）
+		uint64 totalMicrosec = 0;
+
+		/// @brief service() のうち、イベントのコールバックを除いた時間（マイクロ秒）
+		uint64 serviceMicrosec = 0;
+
+		/// @brief 受信したイベントのデシリアライズとコールバックにかかった時間（マイクロ秒）
+		uint64 callbackMicrosec = 0;
+	};
+
+	/// @brief 接続品質の状態
+	struct ConnectionQualityStats
+	{
+		/// @brief 現在のラウンドトリップタイム（ミリ秒）
+		int32 roundTripMillisec = 0;
+
+		/// @brief 現在のラウンドトリップタイムの分散（ミリ秒）
+		int32 roundTripVarianceMillisec = 0;
+
+		/// @brief 直近のラウンドトリップタイムの 50 パーセンタイル（ミリ秒）
+		/// @remark パーセンタイルは、100ms ごとに記録した直近 512 回（約 51 秒間）のサンプルから求めます。
+		int32 roundTripP50Millisec = 0;
+
+		/// @brief 直近のラウンドトリップタイムの 90 パーセンタイル（ミリ秒）
+		int32 roundTripP90Millisec = 0;
+
+		/// @brief 直近のラウンドトリップタイムの 99 パーセンタイル（ミリ秒）
+		int32 roundTripP99Millisec = 0;
+
+		/// @brief 直近のラウンドトリップタイムの分散の 90 パーセンタイル（ミリ秒）
+		int32 roundTripVarianceP90Millisec = 0;
+
+		/// @brief 直近 1 秒間に再送された reliable なコマンドの数
+		int32 resentReliableCommandsPerSec = 0;
+
+		/// @brief 送信待ちのコマンドの数
+		int32 queuedOutgoingCommands = 0;
+
+		/// @brief 処理待ちの受信したコマンドの数
+		int32 queuedIncomingCommands = 0;
+
+		/// @brief 接続品質が低下している状態であるか
+		bool degraded = false;
+	};
+
+	/// @brief 接続品質が低下したと判定するしきい値
+	struct ConnectionQualityThresholds
+	{
+		/// @brief ラウンドトリップタイムの 90 パーセンタイルの上限（ミリ秒）
+		int32 maxRoundTripMillisec = 250;
+
+		/// @brief ラウンドトリップタイムの分散の 90 パーセンタイルの上限（ミリ秒）
+		int32 maxRoundTripVarianceMillisec = 100;
+
+		/// @brief 1 秒あたりの reliable なコマンドの再送数の上限
+		int32 maxResentReliableCommandsPerSec = 5;
+
+		/// @brief 送信待ちのコマンドの数の上限
+		int32 maxQueuedOutgoingCommands = 100;
+
+		/// @brief 状態が切り替わるまでに、しきい値を超えている（または下回っている）必要がある時間
+		Milliseconds holdTime{ 1000 };
+	};
+
+	/// @brief 自動再接続のオプション
+	struct AutoReconnectOption
+	{
+		/// @brief 最初の再接続までの待ち時間。失敗するたびに 2 倍になります
+		Milliseconds initialDelay{ 500 };
+
+		/// @brief 再接続までの待ち時間の上限
+		Milliseconds maxDelay{ 30'000 };
+
+		/// @brief 待ち時間をランダムに短くする割合（0.0 以上 1.0 以下）。多数のクライアントが同時に再接続しないようにします
+		double jitter = 0.5;
+
+		/// @brief 再接続を試みる回数の上限。0 の場合は無制限
+		int32 maxAttempts = 10;
+
+		/// @brief 切断中に送信されたイベントを保持する数の上限。超えた場合は古いものから破棄されます
+		size_t outboxCapacity = 256;
+	};
+
+	/// @brief 送信スケジューラの状態
+	struct SendSchedulerStats
+	{
+		/// @brief 送信を待っているイベントの数
+		size_t queuedEvents = 0;
+
+		/// @brief 送信を待っているイベントのデータのサイズ（バイト）
+		size_t queuedBytes = 0;
+
+		/// @brief スケジューラが送信したイベントの数
+		uint64 sentEvents = 0;
+
+		/// @brief 送信量の上限に達して、送信を次の update() に持ち越した回数
+		uint64 deferredUpdates = 0;
+	};
+
+	/// @brief sendStream() による大きなデータの転送のオプション
+	struct StreamOption
+	{
+		/// @brief 1 つのイベントで送信するデータの最大サイズ（バイト）
+		size_t chunkSize = (4 * 1024);
+
+		/// @brief 1 秒あたりに送信するデータの上限（バイト）。同時に行われている転送で分け合います
+		size_t bytesPerSec = (64 * 1024);
+
+		/// @brief 転送に使うプライオリティインデックス。ゲームのイベントと別にすることで、転送中もイベントが遅れないようにします
+		uint8 priorityIndex = 1;
+
+		/// @brief 受信の確認を待たずに送信しておくチャンクの数
+		uint32 windowChunks = 16;
+
+		/// @brief この時間受信の確認が進まない場合、確認されていないチャンクから送信し直します
+		Milliseconds ackTimeout{ 3000 };
+
+		/// @brief 受信する転送 1 つあたりのデータの上限（バイト）。これを超える転送は受信を拒否して中止します
+		size_t maxReceiveSize = (64 * 1024 * 1024);
+	};
+
+	/// @brief sendStream() による転送の進捗
+	struct StreamProgress
+	{
+		/// @brief 転送 ID（送信者ごとに一意）
+		uint32 streamID = 0;
+
+		/// @brief 送信の場合は送信先、受信の場合は送信者のローカルプレイヤー ID
+		LocalPlayerID playerID = -1;
+
+		/// @brief 転送が完了したときにコールバックに渡されるイベントコード
+		uint8 eventCode = 0;
+
+		/// @brief 自分が送信している転送であるか
+		bool sending = false;
+
+		/// @brief 転送が完了した（受信の確認が取れた）データのサイズ（バイト）
+		size_t transferredBytes = 0;
+
+		/// @brief データ全体のサイズ（バイト）
+		size_t totalBytes = 0;
+
+		[[nodiscard]]
+		bool isCompleted() const noexcept
+		{
+			return (transferredBytes == totalBytes);
+		}
+	};
+
+	class Multiplayer_Photon;
+
+	class MultiplayerReplay;
+
+	namespace detail
+	{
+		struct ClockSample
+		{
+			/// @brief サンプルを取得したときのローカルの時刻（マイクロ秒）
+			int64 localMicrosec = 0;
+
+			/// @brief ローカルの時刻から共有時刻へのオフセット（マイクロ秒）
+			int64 offsetMicrosec = 0;
+
+			int32 roundTripMillisec = 0;
+		};
+
+		/// @brief サーバ時刻を取得しているサーバ。サーバごとに時刻の基準が異なる
+		enum class ClockServer : uint8
+		{
+			/// @brief サーバを切り替えている途中
+			None,
+
+			NameServer,
+
+			MasterServer,
+
+			GameServer,
+		};
+
+		struct ClockSyncState
+		{
+			static constexpr size_t MaxSamples = 16;
+
+			/// @brief 前回のオフセットとの差がこれを超えた場合は、サーバの時刻の基準が変わったとみなす（ミリ秒）
+			static constexpr int32 MaxOffsetJumpMillisec = 1000;
+
+			/// @brief サーバのタイムスタンプを要求する間隔
+			Milliseconds interval{ 1000 };
+
+			uint64 lastRequestMillisec = 0;
+
+			/// @brief 応答を待っている要求を送信したときのローカルの時刻（マイクロ秒）
+			Optional<int64> requestMicrosec;
+
+			/// @brief 最後にサーバ時刻を取得したサーバ
+			ClockServer server = ClockServer::None;
+
+			/// @brief サーバを切り替える前の getServerTimeOffset() の値。新しいサーバの値に変わるまでサンプルにしない
+			Optional<int32> staleServerTimeOffset;
+
+			/// @brief 最後に観測した getServerTimeOffset() の値
+			Optional<int32> lastServerTimeOffset;
+
+			/// @brief 最後に観測した 32 ビットのサーバ時刻
+			int32 lastServerTime = 0;
+
+			/// @brief 64 ビットに拡張したサーバ時刻（ミリ秒）
+			int64 serverTime64 = 0;
+
+			std::array<ClockSample, MaxSamples> samples{};
+
+			size_t numSamples = 0;
+
+			size_t nextSample = 0;
+
+			/// @brief 推定したオフセットの基準点（ローカルの時刻, マイクロ秒）
+			int64 baseLocalMicrosec = 0;
+
+			/// @brief 基準点でのオフセット（マイクロ秒）
+			int64 baseOffsetMicrosec = 0;
+
+			/// @brief ローカルの時刻 1 マイクロ秒あたりのオフセットの変化
+			double drift = 0.0;
+
+			ClockSyncStats stats;
+
+			/// @brief これまでに返した共有時刻の最大値（単調増加にするため）
+			mutable int64 lastSharedMicrosec = 0;
+		};
+
+		struct TrafficSample
+		{
+			uint64 millisec = 0;
+
+			uint64 bytesIn = 0;
+
+			uint64 bytesOut = 0;
+
+			uint64 packetsIn = 0;
+
+			uint64 packetsOut = 0;
+		};
+
+		/// @brief 通信量の累計とレートを計算するための状態。Photon のカウンタは int32 なので、差分を 64 ビットで積算する
+		struct TrafficMeterState
+		{
+			static constexpr uint64 SampleIntervalMillisec = 250;
+
+			/// @brief 60 秒の区間の両端を含むサンプル数
+			static constexpr size_t MaxSamples = ((60'000 / SampleIntervalMillisec) + 1);
+
+			/// @brief 現在の累計
+			TrafficSample total;
+
+			/// @brief 最後に観測した Photon のカウンタの値
+			int32 lastBytesIn = 0;
+
+			int32 lastBytesOut = 0;
+
+			int32 lastPacketsIn = 0;
+
+			int32 lastPacketsOut = 0;
+
+			/// @brief SampleIntervalMillisec ごとの累計のリングバッファ
+			Array<TrafficSample> samples;
+
+			size_t nextSample = 0;
+
+			TrafficRates rates;
+		};
+
+		/// @brief 直近の一定数のサンプルの分布を保持するヒストグラム
+		struct RollingHistogram
+		{
+			static constexpr int32 BucketWidth = 5;
+
+			static constexpr size_t NumBuckets = 201;
+
+			static constexpr size_t MaxSamples = 512;
+
+			std::array<uint16, NumBuckets> buckets{};
+
+			/// @brief 各サンプルが入っているビンのリングバッファ
+			std::array<uint8, MaxSamples> sampleBuckets{};
+
+			size_t numSamples = 0;
+
+			size_t nextSample = 0;
+
+			void add(int32 value) noexcept;
+
+			/// @brief パーセンタイルを返します。
+			/// @param p 0.0 以上 1.0 以下の割合
+			/// @return パーセンタイル（ビンの上端）。サンプルが無い場合は 0
+			[[nodiscard]]
+			int32 percentile(double p) const noexcept;
+
+			void clear() noexcept;
+		};
+
+		struct ConnectionQualityState
+		{
+			/// @brief ラウンドトリップタイムをヒストグラムに記録する間隔。Photon の値は平滑化されているので、毎フレーム記録すると同じ値に偏る
+			static constexpr uint64 SampleIntervalMillisec = 100;
+
+			ConnectionQualityThresholds thresholds;
+
+			RollingHistogram roundTrip;
+
+			RollingHistogram roundTripVariance;
+
+			ConnectionQualityStats stats;
+
+			int32 lastResentReliableCommands = 0;
+
+			uint64 lastResendSampleMillisec = 0;
+
+			uint64 lastRoundTripSampleMillisec = 0;
+
+			/// @brief 現在の状態と異なる判定が続いている開始時刻
+			Optional<uint64> pendingSinceMillisec;
+		};
+
+		/// @brief ログのリングバッファの 1 件分。ヒープを使わない固定長のレコード
+		struct LogRecord
+		{
+			static constexpr size_t MaxLength = 250;
+
+			uint16 length = 0;
+
+			std::array<char32, MaxLength> text;
+		};
+
+		/// @brief ログを記録するスレッドと出力するスレッドが 1 つずつの、ロックフリーなリングバッファ
+		class LogRing
+		{
+		public:
+
+			static constexpr size_t Capacity = 1024;
+
+			/// @brief ログを追加します。記録する側のスレッドから呼びます。
+			/// @return 追加できた場合 true, バッファが一杯の場合は false
+			bool push(StringView text) noexcept;
+
+			/// @brief 最も古いログを返します。出力する側のスレッドから呼びます。
+			/// @return 最も古いログ。空の場合は nullptr
+			[[nodiscard]]
+			const LogRecord* front() const noexcept;
+
+			/// @brief front() で取得したログを取り除きます。出力する側のスレッドから呼びます。
+			void pop() noexcept;
+
+			/// @brief バッファが一杯で捨てられたログの数を返し、0 に戻します。
+			[[nodiscard]]
+			uint64 takeDropped() noexcept;
+
+		private:
+
+			std::array<LogRecord, Capacity> m_records;
+
+			std::atomic<size_t> m_head{ 0 };
+
+			std::atomic<size_t> m_tail{ 0 };
+
+			std::atomic<uint64> m_dropped{ 0 };
+		};
+
+		/// @brief 引数が呼び出し可能であれば呼び出した結果を、それ以外はそのまま返します。ログの引数を遅延評価するために使います。
+		template<class Arg>
+		[[nodiscard]]
+		decltype(auto) EvaluateLogArg(Arg&& arg)
+		{
+			if constexpr (std::is_invocable_v<Arg&>)
+			{
+				return arg();
+			}
+			else
+			{
+				return std::forward<Arg>(arg);
+			}
+		}
+
+		/// @brief 記録ファイルのレコードの種類
+		enum class RecordKind : uint8
+		{
+			CustomEvent = 1,
+			ConnectionError,
+			Connect,
+			Disconnect,
+			LeaveRoom,
+			JoinRoom,
+			JoinRandomRoom,
+			CreateRoom,
+			JoinOrCreateRoom,
+			JoinRandomOrCreateRoom,
+			JoinRoomEvent,
+			LeaveRoomEvent,
+			RoomListUpdate,
+			RoomPropertiesChange,
+			HostChange,
+			RoomListResponse,
+		};
+
+		struct TraceEvent
+		{
+			/// @brief 区間の名前（文字列リテラル）
+			const char32* name = nullptr;
+
+			uint64 beginMicrosec = 0;
+
+			uint64 durationMicrosec = 0;
+
+			/// @brief イベントコード。無い場合は -1
+			int32 eventCode = -1;
+		};
+
+		struct TraceBuffer
+		{
+			Array<TraceEvent> events;
+
+			size_t maxEvents = 0;
+
+			uint64 numDropped = 0;
+		};
+
+		/// @brief スコープの開始から終了までを TraceBuffer に記録します。
+		class TraceScope
+		{
+		public:
+
+			TraceScope(TraceBuffer* buffer, const char32* name, const int32 eventCode) noexcept
+				: m_buffer{ buffer }
+				, m_name{ name }
+				, m_eventCode{ eventCode }
+				, m_beginMicrosec{ buffer ? Time::GetMicrosec() : 0 } {}
+
+			TraceScope(const TraceScope&) = delete;
+
+			TraceScope& operator =(const TraceScope&) = delete;
+
+			~TraceScope()
+			{
+				if (not m_buffer)
+				{
+					return;
+				}
+
+				if (m_buffer->maxEvents <= m_buffer->events.size())
+				{
+					++m_buffer->numDropped;
+					return;
+				}
+
+				m_buffer->events << TraceEvent{ m_name, m_beginMicrosec, (Time::GetMicrosec() - m_beginMicrosec), m_eventCode };
+			}
+
+		private:
+
+			TraceBuffer* m_buffer;
+
+			const char32* m_name;
+
+			int32 m_eventCode;
+
+			uint64 m_beginMicrosec;
+		};
+
+		using TypeErasedCallback = void(Multiplayer_Photon::*)();
+		using CallbackWrapper = void(*)(Multiplayer_Photon&, TypeErasedCallback, LocalPlayerID, uint8, Deserializer<MemoryViewReader>&);
+
+		using CustomEventReceiver = std::pair<TypeErasedCallback, CallbackWrapper>;
+
+		/// @brief イベントコードで引くコールバックの表。登録されていないイベントコードは { nullptr, nullptr }
+		using EventDispatchTable = std::array<CustomEventReceiver, 200>;
+
+		/// @brief 同じ内容の表を共有します。同じ派生クラスのインスタンスは、同じ表を 1 つだけ参照するようになります。
+		/// @param table 表
+		/// @return 内容が table と等しい、共有された表
+		[[nodiscard]]
+		std::shared_ptr<const EventDispatchTable> InternEventDispatchTable(const EventDispatchTable& table);
+
+		template<class T, class... Args>
+		struct EventWrapperImpl;
+
+		template<class T, class... Args>
+		struct PackedEventWrapperImpl;
+
+		/// @brief イベントコードごとの通信量と処理時間のカウンタ。別スレッドから読み取れるように relaxed なアトミック変数で集計する
+		struct EventTrafficCounters
+		{
+			std::atomic<uint64> sentCount{ 0 };
+
+			std::atomic<uint64> receivedCount{ 0 };
+
+			std::atomic<uint64> sentBytes{ 0 };
+
+			std::atomic<uint64> receivedBytes{ 0 };
+
+			std::atomic<uint64> serializeMicrosec{ 0 };
+
+			std::atomic<uint64> deserializeMicrosec{ 0 };
+
+			std::atomic<uint64> callbackMicrosec{ 0 };
+
+			std::atomic<uint64> droppedCount{ 0 };
+		};
+
+		using EventTrafficTable = std::array<EventTrafficCounters, 256>;
+
+		struct HostMigrationState
+		{
+			/// @brief ホストがチェックポイントを送信する間隔
+			Milliseconds checkpointInterval{ 100 };
+
+			uint64 lastCheckpointMillisec = 0;
+
+			uint64 lastPingPublishMillisec = 0;
+
+			int32 publishedPing = -1;
+
+			uint32 sequence = 0;
+
+			bool checkpointRequested = false;
+
+			/// @brief 後継者。ホストが決定し、全員に通知する
+			LocalPlayerID successor = -1;
+
+			bool successorDirty = true;
+
+			/// @brief 後継者として受信した最新のチェックポイント
+			Blob checkpoint;
+
+			bool checkpointCompressed = false;
+
+			uint32 checkpointSequence = 0;
+
+			LocalPlayerID checkpointHost = -1;
+		};
+
+		struct OutgoingStream
+		{
+			uint32 streamID = 0;
+
+			LocalPlayerID target = -1;
+
+			uint8 eventCode = 0;
+
+			Blob data;
+
+			/// @brief 転送を始めたときの StreamOption::chunkSize
+			size_t chunkSize = 0;
+
+			uint32 numChunks = 0;
+
+			/// @brief 次に送信するチャンク
+			uint32 nextChunk = 0;
+
+			/// @brief 受信の確認が取れたチャンクの数
+			uint32 ackedChunks = 0;
+
+			/// @brief 最後に受信の確認が進んだ時刻（ミリ秒）
+			uint64 lastAckMillisec = 0;
+
+			/// @brief 最後に送信し直しの要求に応じて戻ったチャンク。同じ抜けに対する要求で何度も戻らないようにする
+			Optional<uint32> resendFrom;
+		};
+
+		struct IncomingStream
+		{
+			uint8 eventCode = 0;
+
+			uint64 totalSize = 0;
+
+			uint32 numChunks = 0;
+
+			/// @brief 次に受信するチャンク
+			uint32 nextChunk = 0;
+
+			/// @brief 送信し直しを要求したチャンク。このチャンクを受信するまでは、抜けがあっても要求を重ねない
+			Optional<uint32> requestedResend;
+
+			Blob data;
+		};
+
+		struct FinishedStream
+		{
+			/// @brief 受信を終えた時刻（ミリ秒）
+			uint64 finishedMillisec = 0;
+
+			/// @brief 受信が完了した場合 true, 受信を拒否した場合は false
+			bool completed = false;
+		};
+
+		struct StreamState
+		{
+			/// @brief 受信を終えた転送を覚えておく時間（ミリ秒）
+			static constexpr uint64 FinishedLifetimeMillisec = 60'000;
+
+			StreamOption option;
+
+			/// @brief 送信できるデータの量（バイト）
+			double budget = 0.0;
+
+			uint64 lastUpdateMillisec = 0;
+
+			uint32 nextStreamID = 1;
+
+			/// @brief 次に送信する転送の位置（ラウンドロビン）
+			size_t nextOutgoing = 0;
+
+			Array<OutgoingStream> outgoing;
+
+			/// @brief (送信者, 転送 ID) ごとの受信中の転送
+			HashTable<uint64, IncomingStream> incoming;
+
+			/// @brief 受信を終えた (送信者, 転送 ID)。送信し直されたチャンクに受信の確認を返すために使い、FinishedLifetimeMillisec 後に忘れる
+			HashTable<uint64, FinishedStream> finished;
+		};
+
+		struct JoinSnapshotState
+		{
+			/// @brief 受信するスナップショットの最大サイズ（圧縮後のバイト数）。これを超える場合は受信を中止する
+			static constexpr size_t MaxReceiveSize = (64 * 1024 * 1024);
+
+			/// @brief 1 つのイベントで送信するデータの最大サイズ
+			size_t chunkSize = (16 * 1024);
+
+			/// @brief 次の update() でスナップショットを送信するプレイヤー（ホストのみ）
+			Array<LocalPlayerID> pendingPlayers;
+
+			uint32 sequence = 0;
+
+			/// @brief 受信中のスナップショットを送信しているホスト。受信中でない場合は -1
+			LocalPlayerID receivingFrom = -1;
+
+			uint32 receivingSequence = 0;
+
+			uint32 numChunks = 0;
+
+			uint32 numReceivedChunks = 0;
+
+			bool compressed = false;
+
+			/// @brief 受信したチャンクをつなげたデータ
+			Blob data;
+		};
+
+		/// @brief 毎フレーム確保し直さないように使い回す一時的なバッファ。中身だけを消して、確保した容量はそのまま残す
+		struct FrameBuffers
+		{
+			/// @brief sendEvent() でイベントをシリアライズする
+			Serializer<MemoryWriter> sendWriter;
+
+			/// @brief sendPackedEvent() でイベントをビット単位で詰めて書き込む
+			PackedWriter packedWriter;
+
+			/// @brief RegisterPackedEventCallback() で登録したコールバックに渡すイベントを読み出すためのコピー
+			Array<uint8> packedBuffer;
+
+			/// @brief joinRoomEventAction() に渡すプレイヤーの一覧
+			Array<LocalPlayerID> playerIDs;
+
+			/// @brief onRoomPropertiesChange() に渡す変更されたプロパティ
+			RoomPropertyTable properties;
+
+			/// @brief 空間インタレスト管理で参加・退出するイベントターゲットグループ
+			Array<uint8> joinGroups;
+
+			Array<uint8> leaveGroups;
+
+			void clear();
+		};
+
+		/// @brief 受信キューの 1 件分
+		struct ReceivedEvent
+		{
+			/// @brief 受信した順番
+			uint64 sequence = 0;
+
+			LocalPlayerID playerID = 0;
+
+			uint8 eventCode = 0;
+
+			ReceivePolicy policy = ReceivePolicy::NeverDrop;
+
+			/// @brief 破棄されたか（取り出すときに読み飛ばす）
+			bool dropped = false;
+
+			Blob data;
+		};
+
+		/// @brief 容量を超えると、ポリシーに従ってイベントを破棄する受信キュー。要素を使い回すリングバッファ
+		class ReceiveQueue
+		{
+		public:
+
+			enum class PushResult : uint8
+			{
+				Queued,
+
+				/// @brief 同じ送信者とイベントコードのイベントを置き換えた
+				Replaced,
+
+				/// @brief 古いイベントを破棄して追加した（droppedEventCode に破棄したイベントコードが入る）
+				DroppedOldest,
+
+				/// @brief 追加するイベントを破棄した
+				DroppedIncoming,
+			};
+
+			/// @brief ReceivePolicy::NeverDrop のイベントでも、容量のこの倍数に達した場合は破棄する
+			static constexpr size_t MaxOverflowFactor = 4;
+
+			void setCapacity(size_t capacity);
+
+			[[nodiscard]]
+			PushResult push(LocalPlayerID playerID, uint8 eventCode, ReceivePolicy policy, const uint8* data, size_t size, uint8& droppedEventCode);
+
+			/// @brief 最も古いイベントを取り出し、そのデータを data と入れ替えます。
+			/// @return 取り出せた場合 true, 空の場合は false
+			bool pop(LocalPlayerID& playerID, uint8& eventCode, Blob& data);
+
+			/// @brief playerID が送信した最も古いイベントを取り出し、そのデータを data と入れ替えます。他の送信者のイベントの順番は変わりません。
+			/// @return 取り出せた場合 true, playerID のイベントが無い場合は false
+			bool popFrom(LocalPlayerID playerID, uint8& eventCode, Blob& data);
+
+			void clear();
+
+			/// @brief 処理を待っているイベントの数を返します。
+			[[nodiscard]]
+			size_t size() const noexcept;
+
+			[[nodiscard]]
+			bool isFull() const noexcept;
+
+		private:
+
+			Array<ReceivedEvent> m_slots;
+
+			/// @brief 先頭の要素の位置
+			size_t m_head = 0;
+
+			/// @brief 破棄された要素を含む要素の数
+			size_t m_count = 0;
+
+			/// @brief 破棄されていない要素の数
+			size_t m_live = 0;
+
+			size_t m_capacity = 0;
+
+			uint64 m_nextSequence = 0;
+
+			/// @brief (送信者, イベントコード) ごとの、キュー内の ReceivePolicy::KeepLatest のイベントの sequence
+			HashTable<uint64, uint64> m_latest;
+
+			[[nodiscard]]
+			ReceivedEvent* find(uint64 sequence) noexcept;
+
+			/// @brief 要素の数が numSlots 未満の場合、順番を保ったまま増やします。
+			void reserveSlots(size_t numSlots);
+
+			[[nodiscard]]
+			static uint64 LatestKey(LocalPlayerID playerID, uint8 eventCode) noexcept;
+		};
+
+		struct ReceiveQueueState
+		{
+			/// @brief キューが一杯でも、この時間を超えて Photon からイベントを取り出すのを止めない（ミリ秒）
+			/// @remark 取り出すのを止めている間は、ライブラリ内部のイベントやプレイヤーの入退室の通知も届かない
+			static constexpr uint64 MaxBackpressureMillisec = 100;
+
+			ReceiveQueue queue;
+
+			Microseconds dispatchBudget{ 2000 };
+
+			ReceiveQueueStats stats;
+
+			/// @brief キューが一杯になって、Photon からイベントを取り出すのを止め始めた時刻（ミリ秒）
+			Optional<uint64> backpressureBeginMillisec;
+		};
+
+		/// @brief sendCachedEvent() でキャッシュしたイベント
+		struct CachedEventSlot
+		{
+			Blob data;
+
+			/// @brief ルームのキャッシュで、個別のイベントではなくスナップショットに含まれているか
+			bool inSnapshot = false;
+		};
+
+		/// @brief イベントコードごとの、自分がルームにキャッシュしたイベントの写し
+		struct EventCacheMirror
+		{
+			HashTable<int32, CachedEventSlot> slots;
+
+			/// @brief 最後に送信したイベントの送信オプション。スナップショットの送信に使う
+			Optional<MultiplayerEvent> lastEvent;
+
+			/// @brief ルームのキャッシュにある、自分が送信したイベント（スナップショットを含む）の数
+			size_t numRoomCachedEvents = 0;
+
+			/// @brief ルームのキャッシュを写しで置き換える必要があるか
+			bool resync = false;
+		};
+
+		/// @brief 切断中に送信されたイベント
+		struct PendingEvent
+		{
+			MultiplayerEvent event;
+
+			Blob data;
+		};
+
+		struct SendChannel
+		{
+			/// @brief 送信待ちのイベント。head より前は送信済み
+			Array<PendingEvent> events;
+
+			size_t head = 0;
+
+			/// @brief 選ばれなかった回数に応じて増える優先度。選ばれると 0 に戻る
+			double priority = 0.0;
+		};
+
+		struct SendSchedulerState
+		{
+			/// @brief 1 秒あたりに送信するデータの上限（バイト）
+			size_t bytesPerSec = (32 * 1024);
+
+			/// @brief 送信できるデータの量（バイト）
+			double budget = 0.0;
+
+			uint64 lastUpdateMillisec = 0;
+
+			/// @brief プライオリティインデックスごとの送信待ちのイベント
+			HashTable<uint8, SendChannel> channels;
+
+			SendSchedulerStats stats;
+		};
+
+		struct AutoReconnectState
+		{
+			AutoReconnectOption option;
+
+			/// @brief 再接続を試みている最中であるか
+			bool reconnecting = false;
+
+			/// @brief これまでに試みた再接続の回数
+			int32 attempt = 0;
+
+			/// @brief 次に再接続を試みる時刻
+			Optional<uint64> nextAttemptMillisec;
+
+			/// @brief ルームに再参加した後に送信するイベント
+			Array<PendingEvent> outbox;
+
+			/// @brief outbox があふれて破棄したイベントの数
+			uint64 droppedEvents = 0;
+		};
+	}
+
+	/// @brief マルチプレイヤー用クラス (Photon バックエンド)
+	class Multiplayer_Photon
+	{
+	public:
+
+		/// @brief デフォルトコンストラクタ。このコンストラクタを使用する場合は後で init を呼び出してください。
+		SIV3D_NODISCARD_CXX20
+		Multiplayer_Photon();
+
+		/// @brief マルチプレイヤー用クラスを作成します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		SIV3D_NODISCARD_CXX20
+		Multiplayer_Photon(std::string_view secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを作成します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		SIV3D_NODISCARD_CXX20
+		Multiplayer_Photon(StringView secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを作成します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param logger デバッグ用のログの出力先関数
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		SIV3D_NODISCARD_CXX20
+		Multiplayer_Photon(std::string_view secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを作成します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param logger デバッグ用のログの出力先関数
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		SIV3D_NODISCARD_CXX20
+		Multiplayer_Photon(StringView secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief デストラクタ
+		virtual ~Multiplayer_Photon();
+
+		/// @brief マルチプレイヤー用クラスを初期化します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		void init(std::string_view secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを初期化します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param verbose デバッグ用の Print 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		void init(StringView secretPhotonAppID, StringView photonAppVersion, Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを初期化します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param logger デバッグ用のログの出力先関数
+		/// @param verbose デバッグ用の logger 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		void init(std::string_view secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger = {}, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief マルチプレイヤー用クラスを初期化します。
+		/// @param secretPhotonAppID Photon アプリケーション ID
+		/// @param photonAppVersion アプリケーションのバージョン
+		/// @param logger デバッグ用のログの出力先関数
+		/// @param verbose デバッグ用の logger 出力をする場合 Verbose::Yes, それ以外の場合は Verbose::No
+		/// @param protocol 通信に用いるプロトコル
+		/// @remark アプリケーションバージョンが異なるプレイヤーとの通信はできません。
+		void init(StringView secretPhotonAppID, StringView photonAppVersion, const std::function<void(StringView)>& logger = {}, const Verbose verbose = Verbose::Yes, ConnectionProtocol protocol = ConnectionProtocol::Default);
+
+		/// @brief Photon サーバへの接続を試みます。
+		/// @param userName ユーザ名
+		/// @param region 接続するサーバのリージョン。unspecified の場合は利用可能なサーバのうち最速のものが選択されます。
+		/// @remark リージョンは https://doc.photonengine.com/en-us/pun/current/connection-and-authentication/regions を参照してください。
+		/// @remark Web版では必ず region を設定する必要があります。
+		bool connect(StringView userName, const Optional<String>& region = unspecified);
+
+		/// @brief 切断された後、最後に接続したときの設定で、できるだけ少ない往復で再接続を試みます。
+		/// @return リクエストに成功してコールバックが呼ばれる場合 true、それ以外の場合は false
+		/// @remark ルームに参加している間に切断された場合は、ゲームサーバに直接再接続してルームに再参加します（joinRoomReturn() が呼ばれます）。
+		/// @remark それ以外の場合は、最後に接続したリージョンとクラスタを指定して connect() します（リージョンの ping 計測を省略します）。
+		bool reconnect();
+
+		/// @brief 接続に使うユーザ ID を返します。
+		/// @return ユーザ ID。まだ接続したことがなく、setUserID() も呼ばれていない場合は空の文字列
+		[[nodiscard]]
+		const String& getUserID() const noexcept;
+
+		/// @brief 接続に使うユーザ ID を設定します。
+		/// @param userID ユーザ ID
+		/// @remark 設定しない場合、最初の connect() でユーザ名と時刻から作成され、以降の接続ではその ID が使われ続けます。
+		void setUserID(StringView userID);
+
+		/// @brief 最後に接続に成功したリージョンを返します。
+		/// @return 最後に接続に成功したリージョン。接続したことがない場合は none
+		[[nodiscard]]
+		const Optional<String>& getLastRegion() const noexcept;
+
+		/// @brief リージョンを指定しない connect() で選ばれた最速のリージョンを保存するファイルを設定します。
+		/// @param path 保存先のファイルパス
+		/// @param expiry 保存した結果の有効期間（既定は 24 時間）
+		/// @remark 有効な結果が保存されている場合、リージョンを指定しない connect() はリージョンの ping 計測を省略して、保存されたリージョンに接続します。
+		/// @remark 保存されたリージョンへの接続に失敗した場合、そのファイルは削除されます。
+		void setRegionCache(FilePathView path, Duration expiry = Duration{ 24 * 60 * 60 });
+
+		/// @brief 保存した最速のリージョンを削除します。次にリージョンを指定せずに connect() したときは、ping を計測し直します。
+		void clearRegionCache();
+
+		/// @brief 自動再接続を有効にします。connectionErrorReturn() の後や、disconnect() を呼ばずに切断された後に、待ち時間を伸ばしながら update() の中で reconnect() を試みます。
+		/// @param option 自動再接続のオプション
+		/// @remark ルームに再参加した後、joinEventTargetGroup() で参加していたイベントターゲットグループとユーザ名を設定し直し、切断中に sendEvent() されたイベントを送信します。
+		void enableAutoReconnect(const AutoReconnectOption& option = {});
+
+		/// @brief 自動再接続を無効にします。切断中に送信されたイベントは破棄されます。
+		void disableAutoReconnect();
+
+		/// @brief 自動再接続が有効であるかを返します。
+		/// @return 自動再接続が有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasAutoReconnect() const noexcept;
+
+		/// @brief 自動再接続を試みている最中であるかを返します。
+		/// @return 再接続を試みている最中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isReconnecting() const noexcept;
+
+		/// @brief 切断中に送信され、ルームへの再参加を待っているイベントの数を返します。
+		/// @return ルームへの再参加を待っているイベントの数
+		[[nodiscard]]
+		size_t getNumPendingEvents() const noexcept;
+
+		/// @brief Photon サーバから切断を試みます。
+		void disconnect();
+
+		/// @brief サーバーと同期します。
+		/// @remark 6 秒間以上この関数を呼ばないと自動的に切断されます。
+		void update();
+
+		/// @brief update() を呼ぶ必要がある状態であるかを返します。not isDisconnected() と同じです。
+		/// @return  update() を呼ぶ必要がある状態である場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isActive() const;
+
+		/// @brief クライアントの状態を返します。
+		/// @return 現在のクライアントの状態
+		[[nodiscard]]
+		ClientState getClientState() const;
+
+		/// @brief サーバーから切断されているかを返します。
+		/// @return サーバーから切断されている場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isDisconnected() const;
+
+		/// @brief ロビーに接続中かを返します。
+		/// @return ロビーに接続中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isConnectingToLobby() const;
+
+		/// @brief 自分がロビーにいるかを返します。
+		/// @return ロビーにいる場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isInLobby() const;
+
+		/// @brief ルームに参加中かを返します。
+		/// @return ルームに参加中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isJoiningRoom() const;
+
+		/// @brief 自分がルームに参加しているかを返します。
+		/// @return ルームに参加している場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isInRoom() const;
+
+		/// @brief ルームから退出中かを返します。
+		/// @return ルームから退出中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isLeavingRoom() const;
+
+		/// @brief サーバーから切断中かを返します。
+		/// @return サーバーから切断中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isDisconnecting() const;
+
+		/// @brief 自分がロビーまたはルームにいるかを返します。
+		/// @return ロビーまたはルームいる場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isInLobbyOrInRoom() const;
+
+		/// @brief 存在するルームの一覧を返します。
+		/// @return 存在するルームの一覧
+		[[nodiscard]]
+		Array<RoomInfo> getRoomList() const;
+
+		/// @brief 存在するルームの名前の一覧を返します。
+		/// @return 存在するルームの名前の一覧
+		[[nodiscard]]
+		Array<RoomName> getRoomNameList() const;
+
+		/// @brief 接続したときに既定のロビーに自動で参加するかを設定します。
+		/// @param enabled 自動で参加する場合 true, それ以外の場合は false
+		/// @remark 既定のロビーに参加すると、ルームの一覧の全体が onRoomListUpdate() のたびに送られてきます。SQL ロビーだけを使う場合は false にしてください。
+		/// @remark 次に connect() したときから有効になります。
+		void setAutoJoinLobby(bool enabled);
+
+		/// @brief SQL ロビーから、条件に合うルームの一覧を要求します。結果は onRoomListResponse() で通知されます。
+		/// @param query 検索する条件
+		/// @return リクエストに成功してコールバックが呼ばれる場合 true、それ以外の場合は false
+		/// @remark 1 回の要求で返されるルームの数はサーバによって制限されます（100 件）。続きは requestNextRoomListPage() で要求してください。
+		bool requestRoomList(const LobbyQuery& query);
+
+		/// @brief 直前の requestRoomList() の続きを要求します。
+		/// @return リクエストに成功してコールバックが呼ばれる場合 true、続きが無い場合や orderBy() と thenBy() が設定されていない場合は false
+		/// @remark 直前の結果が 1 ページ分（100 件）に満たなかった場合は、続きが無いものとします。
+		bool requestNextRoomListPage();
+
+		/// @brief サーバのタイムスタンプ（ミリ秒）を返します。
+		/// @return サーバのタイムスタンプ（ミリ秒）
+		[[nodiscard]]
+		int32 getServerTimeMillisec() const;
+
+		/// @brief サーバのタイムスタンプとクライアントのシステムのタイムスタンプのオフセット（ミリ秒）を返します。
+		/// @return サーバのタイムスタンプとクライアントのシステムのタイムスタンプのオフセット（ミリ秒）
 		/// @remark Multiplayer_Photon::GetSystemTimeMillisec() の戻り値と足した値がサーバのタイムスタンプと一致します。
 		[[nodiscard]]
 		int32 getServerTimeOffsetMillisec() const;
@@ -489,6 +1797,23 @@ namespace s3d
 		[[nodiscard]]
 		int32 getPingMillisec() const;
 
+		/// @brief サーバ時刻に同期した、全クライアントで共有される時刻（マイクロ秒）を返します。
+		/// @return 共有時刻（マイクロ秒）。同期前は 0
+		/// @remark サーバのタイムスタンプを継続的に取得し、ラウンドトリップタイムの大きいサンプルや外れ値を除外し、時計のずれを補正して推定します。
+		/// @remark 同じサーバに接続している間、戻り値は単調増加し、32 ビットのサーバ時刻と異なりオーバーフローしません。
+		/// @remark サーバ（ネームサーバ、マスターサーバ、ゲームサーバ）ごとに時刻の基準が異なるため、サーバが切り替わると同期し直すまで 0 を返し、その後は新しいサーバの時刻に合わせ直します。
+		[[nodiscard]]
+		int64 getSharedTimeMicrosec() const;
+
+		/// @brief サーバとの時刻同期の状態を返します。
+		/// @return 時刻同期の状態
+		[[nodiscard]]
+		ClockSyncStats getClockSyncStats() const noexcept;
+
+		/// @brief 時刻同期のためにサーバのタイムスタンプを要求する間隔を設定します。
+		/// @param interval タイムスタンプを要求する間隔
+		void setClockSyncInterval(Milliseconds interval);
+
 		/// @brief getPingMillisec() で取得される ping の更新頻度を取得します。
 		/// @return pingの更新頻度（ミリ秒）
 		[[nodiscard]]
@@ -498,26 +1823,81 @@ namespace s3d
 		/// @param intervalMillisec pingの更新頻度（ミリ秒）
 		void setPingIntervalMillisec(int32 intervalMillisec);
 
+		/// @brief 接続品質の状態を返します。
+		/// @return 接続品質の状態
+		/// @remark 値は update() の中で更新されます。
+		[[nodiscard]]
+		const ConnectionQualityStats& getConnectionQuality() const noexcept;
+
+		/// @brief 接続品質が低下したと判定するしきい値を返します。
+		/// @return しきい値
+		[[nodiscard]]
+		const ConnectionQualityThresholds& getConnectionQualityThresholds() const noexcept;
+
+		/// @brief 接続品質が低下したと判定するしきい値を設定します。
+		/// @param thresholds しきい値
+		void setConnectionQualityThresholds(const ConnectionQualityThresholds& thresholds);
+
+		/// @brief 直前の update() の処理時間の内訳を返します。
+		/// @return 直前の update() の処理時間の内訳
+		[[nodiscard]]
+		const UpdateTimingStats& getLastUpdateTiming() const noexcept;
+
 # if not SIV3D_PLATFORM(WEB)
 		/// @brief 受信したデータのサイズ（バイト）を返します。
 		/// @return 受信したデータのサイズ（バイト）
+		/// @remark 値は update() の中で更新されます。
 		[[nodiscard]]
-		int32 getBytesIn() const;
+		uint64 getBytesIn() const noexcept;
 
 		/// @brief 送信したデータのサイズ（バイト）を返します。
 		/// @return 送信したデータのサイズ（バイト）
+		/// @remark 値は update() の中で更新されます。
+		[[nodiscard]]
+		uint64 getBytesOut() const noexcept;
+
+		/// @brief 受信したパケットの数を返します。
+		/// @return 受信したパケットの数
+		/// @remark 値は update() の中で更新されます。
+		[[nodiscard]]
+		uint64 getPacketsIn() const noexcept;
+
+		/// @brief 送信したパケットの数を返します。
+		/// @return 送信したパケットの数
+		/// @remark 値は update() の中で更新されます。
+		[[nodiscard]]
+		uint64 getPacketsOut() const noexcept;
+
+		/// @brief 直近 1 秒、10 秒、60 秒の通信量のレートを返します。
+		/// @return 通信量のレート
+		/// @remark 値は update() の中で更新されます。接続してから区間の長さが経過していない場合は、経過した時間でのレートを返します。
 		[[nodiscard]]
-		int32 getBytesOut() const;
+		const TrafficRates& getTrafficRates() const noexcept;
 # else
 		/// @brief 受信したデータのサイズ（バイト）を返します。この関数は Web 版では利用できません。
 		/// @return 受信したデータのサイズ（バイト）
 		[[nodiscard]]
-		int32 getBytesIn() const = delete;
+		uint64 getBytesIn() const = delete;
 
 		/// @brief 送信したデータのサイズ（バイト）を返します。この関数は Web 版では利用できません。
 		/// @return 送信したデータのサイズ（バイト）
 		[[nodiscard]]
-		int32 getBytesOut() const = delete;
+		uint64 getBytesOut() const = delete;
+
+		/// @brief 受信したパケットの数を返します。この関数は Web 版では利用できません。
+		/// @return 受信したパケットの数
+		[[nodiscard]]
+		uint64 getPacketsIn() const = delete;
+
+		/// @brief 送信したパケットの数を返します。この関数は Web 版では利用できません。
+		/// @return 送信したパケットの数
+		[[nodiscard]]
+		uint64 getPacketsOut() const = delete;
+
+		/// @brief 直近 1 秒、10 秒、60 秒の通信量のレートを返します。この関数は Web 版では利用できません。
+		/// @return 通信量のレート
+		[[nodiscard]]
+		const TrafficRates& getTrafficRates() const = delete;
 # endif
 
 		/// @brief ルームの数を返します。
@@ -550,6 +1930,13 @@ namespace s3d
 		/// @remark maxPlayers は 最大 255, 無料の Photon アカウントの場合は 20
 		bool joinRandomRoom(const RoomPropertyTable& propertyFilter, int32 expectedMaxPlayers = 0, MatchmakingMode matchmakingMode = MatchmakingMode::FillOldestRoom);
 
+		/// @brief SQL ロビーの、条件に合うランダムなルームに参加を試みます。
+		/// @param query 検索する条件
+		/// @param expectedMaxPlayers 最大人数が指定されたものと一致するルームにのみ参加を試みます。（0の場合は指定なし）
+		/// @param matchmakingMode マッチメイキングモード
+		/// @return リクエストに成功してコールバックが呼ばれる場合 true、それ以外の場合は false
+		bool joinRandomRoom(const LobbyQuery& query, int32 expectedMaxPlayers = 0, MatchmakingMode matchmakingMode = MatchmakingMode::FillOldestRoom);
+
 		/// @brief 既存のランダムなルームに参加を試み、参加できるルームが無かった場合には新しいルームの作成を試みます。
 		/// @param expectedMaxPlayers 最大人数が指定されたものと一致するルームにのみ参加を試みます。（0の場合は指定なし）
 		/// @param roomName 新しいルーム名
@@ -619,8 +2006,233 @@ namespace s3d
 		void leaveEventTargetGroup(const Array<uint8>& targetGroups);
 
 		/// @brief 全てのイベントターゲットグループから退出します。
+		/// @remark 空間インタレスト管理によって参加していたイベントターゲットグループからも退出します。空間インタレスト管理が有効な場合は、次の update() で参加し直します。
 		void leaveAllEventTargetGroups();
 
+		/// @brief 空間インタレスト管理を有効にします。以降、setInterestPosition() で設定した位置の周辺のセルに対応するイベントターゲットグループに自動的に参加します。
+		/// @param option 空間インタレスト管理のオプション
+		/// @remark すでに有効な場合は、自動的に参加していたイベントターゲットグループから退出してから設定し直します。
+		/// @remark 参加・退出の変更は update() ごとに 1 回のリクエストにまとめて送信されます。
+		/// @remark joinEventTargetGroup() で参加したイベントターゲットグループからは、空間インタレスト管理によって退出しません。
+		void setSpatialInterest(const SpatialInterestOption& option);
+
+		/// @brief 空間インタレスト管理を無効にし、自動的に参加していたイベントターゲットグループから退出します。
+		void clearSpatialInterest();
+
+		/// @brief 空間インタレスト管理における自分の位置を設定します。
+		/// @param position 自分のワールド座標
+		void setInterestPosition(const Vec2& position);
+
+		/// @brief 空間インタレスト管理が有効であるかを返します。
+		/// @return 空間インタレスト管理が有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasSpatialInterest() const noexcept;
+
+		/// @brief 指定したワールド座標を含むセルのイベントターゲットグループを返します。
+		/// @param position ワールド座標
+		/// @return イベントターゲットグループ
+		/// @remark 空間インタレスト管理が有効でない場合は例外を投げます。
+		[[nodiscard]]
+		TargetGroup getInterestTargetGroup(const Vec2& position) const;
+
+		/// @brief 空間インタレスト管理によって現在参加しているイベントターゲットグループの一覧を返します。
+		/// @return イベントターゲットグループの一覧
+		[[nodiscard]]
+		Array<uint8> getInterestTargetGroups() const;
+
+		/// @brief 指定したワールド座標を含むセルのイベントターゲットグループにイベントを送信します。
+		/// @param eventCode イベントコード （1～199）
+		/// @param position イベントが発生したワールド座標
+		/// @param args 送信するデータ
+		/// @remark 空間インタレスト管理が有効でない場合は例外を投げます。
+		template<class... Args>
+		void sendEventAt(uint8 eventCode, const Vec2& position, Args... args);
+
+		/// @brief ホスト移行を有効にします。ホストは writeHostCheckpoint() で書き込まれた状態を、ping が最も小さいプレイヤー（後継者）に定期的に送信します。
+		/// @param checkpointInterval チェックポイントを送信する間隔
+		/// @remark ルーム内の全員が有効にする必要があります。
+		/// @remark 後継者以外のプレイヤーがホストになった場合、そのプレイヤーは後継者にホストを譲ります。
+		void enableHostMigration(Milliseconds checkpointInterval = Milliseconds{ 100 });
+
+		/// @brief ホスト移行を無効にします。
+		void disableHostMigration();
+
+		/// @brief ホスト移行が有効であるかを返します。
+		/// @return ホスト移行が有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasHostMigration() const noexcept;
+
+		/// @brief ホストが指定した後継者のローカルプレイヤー ID を返します。
+		/// @return 後継者のローカルプレイヤー ID, 後継者がいない場合は -1
+		[[nodiscard]]
+		LocalPlayerID getHostSuccessorID() const noexcept;
+
+		/// @brief 後継者として、ホストから受信したチェックポイントを保持しているかを返します。
+		/// @return チェックポイントを保持している場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasHostCheckpoint() const noexcept;
+
+		/// @brief 次の update() で、送信間隔を待たずにチェックポイントを送信します。
+		/// @remark 自分がホストでない場合は何もしません。
+		void requestHostCheckpoint();
+
+		/// @brief 送信スケジューラを有効にします。sendEvent() したイベントはキューに入れられ、update() の中で送信量の上限まで送信されます。
+		/// @param bytesPerSec 1 秒あたりに送信するデータの上限（バイト）
+		/// @remark 送信するイベントは、setSendChannelWeight() で設定した重みに従ってプライオリティインデックスごとに選ばれます。選ばれなかったプライオリティインデックスは優先度が上がるため、重みの小さいイベントもいずれ送信されます。
+		/// @remark 上限を超えた分は、次の update() 以降に持ち越されます。キューが空の間は、100ms 分までまとめて送信できるよう送信量を貯めておきます。
+		/// @remark sendCachedEvent(), removeCachedEvent(), removeEventCache() と、ホストのチェックポイント・参加者へのスナップショットは、送信を待っているイベントをすべて送信してから送信されます。sendStream() のチャンクは送信量の上限に含まれません。
+		void enableSendScheduler(size_t bytesPerSec = (32 * 1024));
+
+		/// @brief 送信スケジューラを無効にします。送信を待っているイベントはすぐに送信されます。
+		void disableSendScheduler();
+
+		/// @brief 送信スケジューラが有効であるかを返します。
+		/// @return 送信スケジューラが有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasSendScheduler() const noexcept;
+
+		/// @brief 送信スケジューラで、プライオリティインデックスごとの重みを設定します。
+		/// @param priorityIndex プライオリティインデックス
+		/// @param weight 重み（既定は 1.0）。大きいほど優先的に送信されます
+		void setSendChannelWeight(uint8 priorityIndex, double weight);
+
+		/// @brief 送信スケジューラの状態を返します。
+		/// @return 送信スケジューラの状態
+		[[nodiscard]]
+		SendSchedulerStats getSendSchedulerStats() const;
+
+		/// @brief sendStream() による転送のオプションを設定します。
+		/// @param option 転送のオプション
+		void setStreamOption(const StreamOption& option);
+
+		/// @brief sendStream() による転送のオプションを返します。
+		/// @return 転送のオプション
+		[[nodiscard]]
+		const StreamOption& getStreamOption() const noexcept;
+
+		/// @brief 大きなデータを分割し、送信量を制限しながら 1 人のプレイヤーに転送します。
+		/// @param targetPlayerID 送信先のプレイヤーのローカル ID
+		/// @param eventCode 転送が完了したときに受信側で呼ばれるコールバックのイベントコード（1～199）
+		/// @param args 送信するデータ
+		/// @return 転送 ID
+		/// @remark チャンクごとにチェックサムで検証し、切断やルームへの再参加の後は受信の確認が取れたところから再開します。
+		/// @remark 受信側では、転送が完了したときに sendEvent() と同じコールバックが呼ばれます。
+		/// @remark 受信側の StreamOption::maxReceiveSize を超える転送は、受信側に拒否されて中止されます。
+		template<class... Args>
+		uint32 sendStream(LocalPlayerID targetPlayerID, uint8 eventCode, Args... args);
+
+		/// @brief 大きなデータを分割し、送信量を制限しながら 1 人のプレイヤーに転送します。
+		/// @param targetPlayerID 送信先のプレイヤーのローカル ID
+		/// @param eventCode 転送が完了したときに受信側で呼ばれるコールバックのイベントコード（1～199）
+		/// @param writer 送信するデータを書き込んだシリアライザ
+		/// @return 転送 ID
+		uint32 sendStream(LocalPlayerID targetPlayerID, uint8 eventCode, const Serializer<MemoryWriter>& writer);
+
+		/// @brief 送信中の転送を中止します。
+		/// @param streamID 転送 ID
+		/// @return 送信中の転送を中止した場合 true, それ以外の場合は false
+		bool cancelStream(uint32 streamID);
+
+		/// @brief 送信中と受信中の転送の進捗を返します。
+		/// @return 転送の進捗の一覧
+		[[nodiscard]]
+		Array<StreamProgress> getStreamProgress() const;
+
+		/// @brief 後から参加したプレイヤーへのスナップショットを有効にします。ホストは writeJoinSnapshot() で書き込まれた状態を圧縮し、分割して新しいプレイヤーに送信します。
+		/// @param chunkSize 1 つのイベントで送信するデータの最大サイズ（バイト）
+		/// @remark ルーム内の全員が、同じ chunkSize で有効にする必要があります。受信側は、チャンクの数と自分の chunkSize から、大きすぎるスナップショット（圧縮後 64 MB 超）を受信せずに無視します。
+		/// @remark 同じ update() の間に参加したプレイヤーには、1 回だけ書き込んだスナップショットをまとめて送信します。
+		void enableJoinSnapshot(size_t chunkSize = (16 * 1024));
+
+		/// @brief 後から参加したプレイヤーへのスナップショットを無効にします。
+		void disableJoinSnapshot();
+
+		/// @brief 後から参加したプレイヤーへのスナップショットが有効であるかを返します。
+		/// @return スナップショットが有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasJoinSnapshot() const noexcept;
+
+		/// @brief ホストからスナップショットを受信している最中であるかを返します。
+		/// @return スナップショットの一部を受信していて、まだ applyJoinSnapshot() が呼ばれていない場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isReceivingJoinSnapshot() const noexcept;
+
+		/// @brief イベントコードごとの通信量と処理時間を返します。
+		/// @return 送信または受信のあったイベントコードの通信量と処理時間の一覧
+		/// @remark 集計はアトミック変数で行われるため、別スレッドから呼び出すこともできます。
+		[[nodiscard]]
+		Array<EventTrafficStats> getEventTrafficStats() const;
+
+		/// @brief イベントコードごとの通信量と処理時間の集計をリセットします。
+		void resetEventTrafficStats();
+
+		/// @brief onEventTrafficReport() が呼ばれる間隔を設定します。
+		/// @param interval onEventTrafficReport() が呼ばれる間隔。0ms の場合は呼ばれません
+		void setEventTrafficReportInterval(Milliseconds interval);
+
+		/// @brief 受信キューを有効にします。受信したイベントはキューに入れられ、update() の中で時間の上限まで処理されます。
+		/// @param capacity キューに入れておくイベントの数の上限
+		/// @param dispatchBudget 1 回の update() でイベントの処理に使う時間の上限。少なくとも 1 件は処理されます
+		/// @remark キューが一杯になると、setReceivePolicy() で設定したポリシーに従ってイベントを破棄します。破棄できない場合は、Photon からイベントを取り出すのを止めます。
+		/// @remark 取り出すのを止めている間は、ライブラリ内部のイベントやプレイヤーの入退室の通知も遅れます。止めるのは最長 100ms までで、それを超えるとキューの容量を超えてイベントを取り出します。
+		/// @remark キューの容量の 4 倍に達した場合は、ReceivePolicy::NeverDrop のイベントも破棄します。
+		/// @remark ライブラリ内部で使うイベントはキューに入れずにすぐ処理されます。プレイヤーが退出したときは、leaveRoomEventAction() の前に、そのプレイヤーのキューに残っているイベントを処理します。
+		void enableReceiveQueue(size_t capacity = 1024, Microseconds dispatchBudget = Microseconds{ 2000 });
+
+		/// @brief 受信キューを無効にします。キューに残っているイベントはすぐに処理されます。
+		/// @remark イベントのコールバックの中から呼ばないでください。
+		void disableReceiveQueue();
+
+		/// @brief 受信キューが有効であるかを返します。
+		/// @return 受信キューが有効な場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasReceiveQueue() const noexcept;
+
+		/// @brief 受信キューが一杯のときの、イベントコードごとの扱いを設定します。
+		/// @param eventCode イベントコード
+		/// @param policy 受信キューが一杯のときの扱い（既定は ReceivePolicy::NeverDrop）
+		void setReceivePolicy(uint8 eventCode, ReceivePolicy policy);
+
+		/// @brief 受信キューが一杯のときの、イベントコードごとの扱いを返します。
+		/// @param eventCode イベントコード
+		/// @return 受信キューが一杯のときの扱い
+		[[nodiscard]]
+		ReceivePolicy getReceivePolicy(uint8 eventCode) const noexcept;
+
+		/// @brief 受信キューの状態を返します。
+		/// @return 受信キューの状態
+		[[nodiscard]]
+		ReceiveQueueStats getReceiveQueueStats() const noexcept;
+
+		/// @brief 受信したコールバックをファイルに記録し始めます。
+		/// @param path 記録ファイルのパス
+		/// @return 記録を開始できた場合 true, それ以外の場合は false
+		/// @remark 記録したファイルは MultiplayerReplay で再生できます。すでに記録中の場合は、それまでの記録を終了します。
+		bool startRecording(FilePathView path);
+
+		/// @brief 記録を終了します。
+		void stopRecording();
+
+		/// @brief 記録中であるかを返します。
+		/// @return 記録中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isRecording() const noexcept;
+
+		/// @brief service() やイベントのディスパッチにかかった時間のトレースを記録し始めます。
+		/// @param maxEvents 記録する区間の最大数
+		/// @return 記録を開始した場合 true, MULTIPLAYER_PHOTON_TRACE が 0 でトレースが使えない場合は false
+		bool startTrace(size_t maxEvents = 1'000'000);
+
+		/// @brief トレースの記録を終了し、Chrome (chrome://tracing) や Perfetto で読み込める JSON ファイルに書き出します。
+		/// @param path 書き出すファイルのパス
+		/// @return 書き出しに成功した場合 true, それ以外の場合は false
+		bool stopTrace(FilePathView path);
+
+		/// @brief トレースを記録中であるかを返します。
+		/// @return 記録中の場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isTracing() const noexcept;
+
 		/// @brief ルームにイベントを送信します。
 		/// @param event イベントの送信オプション
 		/// @param args 送信するデータ
@@ -633,6 +2245,14 @@ namespace s3d
 		/// @param writer 送信するデータを書き込んだシリアライザ
 		void sendEvent(const MultiplayerEvent& event, const Serializer<MemoryWriter>& writer);
 
+		/// @brief データを PackedWriter でビット単位で詰めて、ルームにイベントを送信します。
+		/// @param event イベントの送信オプション
+		/// @param args 送信するデータ
+		/// @remark 受信側では RegisterPackedEventCallback() で登録したコールバックで受け取ります。
+		/// @remark SIV3D_SERIALIZE メンバ関数で Packed::Quantize() や Packed::Range() を使うと、範囲に必要なビット数だけで送信されます。
+		template<class... Args>
+		void sendPackedEvent(const MultiplayerEvent& event, const Args&... args);
+
 		/// @brief キャッシュされたイベントを削除します。
 		/// @param eventCode 削除するイベントコード, 0 の場合は全てのイベントを削除
 		void removeEventCache(uint8 eventCode = 0);
@@ -643,6 +2263,44 @@ namespace s3d
 		/// @remark プレイヤーに紐づくイベントとは、ReceiverOption::○○○_CacheUntilLeaveRoomによってキャッシュされたイベントのことです。
 		void removeEventCache(uint8 eventCode, const Array<LocalPlayerID>& targets);
 
+		/// @brief イベントコードとキーの組ごとに、最新の 1 件だけをルームにキャッシュするイベントを送信します。
+		/// @param event イベントの送信オプション。ReceiverOption は ○○○_CacheUntilLeaveRoom または ○○○_CacheForever である必要があります
+		/// @param key キャッシュのキー。同じイベントコードとキーでキャッシュされているイベントは（他のプレイヤーが送信したものも）置き換えられます
+		/// @param args 送信するデータ
+		/// @remark 受信側では sendEvent() と同じコールバックが呼ばれます。
+		/// @remark ルームにいない間に送信した場合は、同じルームに再参加した後にキャッシュされます。別のルームに参加した場合は破棄されます。
+		template<class... Args>
+		void sendCachedEvent(const MultiplayerEvent& event, int32 key, Args... args);
+
+		/// @brief イベントコードとキーの組ごとに、最新の 1 件だけをルームにキャッシュするイベントを送信します。
+		/// @param event イベントの送信オプション。ReceiverOption は ○○○_CacheUntilLeaveRoom または ○○○_CacheForever である必要があります
+		/// @param key キャッシュのキー。同じイベントコードとキーでキャッシュされているイベントは（他のプレイヤーが送信したものも）置き換えられます
+		/// @param writer 送信するデータを書き込んだシリアライザ
+		void sendCachedEvent(const MultiplayerEvent& event, int32 key, const Serializer<MemoryWriter>& writer);
+
+		/// @brief sendCachedEvent() でキャッシュしたイベントを削除します。
+		/// @param eventCode イベントコード
+		/// @param key キャッシュのキー
+		void removeCachedEvent(uint8 eventCode, int32 key);
+
+		/// @brief 自分が sendCachedEvent() でルームにキャッシュしたイベントが、イベントコードごとにこの数を超えたら、1 つのスナップショットにまとめます。
+		/// @param maxCachedEvents まとめる前にキャッシュしておくイベントの数。0 の場合はまとめません
+		/// @remark スナップショットは、後からルームに参加したプレイヤーだけが処理します。ルームにいるプレイヤーは、ルームに参加してから受信済みのキーを無視します。
+		void setEventCacheCompactionThreshold(size_t maxCachedEvents);
+
+		/// @brief 自分が sendCachedEvent() でキャッシュしているイベントのキーの一覧を返します。
+		/// @param eventCode イベントコード
+		/// @return キャッシュしているイベントのキーの一覧
+		/// @remark 他のプレイヤーが同じキーで送信したイベントに置き換えられたキーは含まれません。
+		[[nodiscard]]
+		Array<int32> getCachedEventKeys(uint8 eventCode) const;
+
+		/// @brief 自分が sendCachedEvent() でルームにキャッシュしているイベント（スナップショットを含む）の数を返します。
+		/// @param eventCode イベントコード
+		/// @return ルームにキャッシュしているイベントの数
+		[[nodiscard]]
+		size_t getNumRoomCachedEvents(uint8 eventCode) const;
+
 		/// @brief 自身のプレイヤー情報を返します。
 		LocalPlayer getLocalPlayer() const;
 
@@ -826,6 +2484,10 @@ namespace s3d
 		/// @brief ロビー内のルームが更新されたときに呼ばれます。
 		virtual void onRoomListUpdate() {}
 
+		/// @brief requestRoomList() または requestNextRoomListPage() の結果が通知されるときに呼ばれます。
+		/// @param rooms 条件に合うルームの一覧
+		virtual void onRoomListResponse([[maybe_unused]] const Array<RoomInfo>& rooms) {}
+
 		/// @brief ルームのプロパティが変更されたときに呼ばれます。
 		/// @param changes 変更されたプロパティのキーと値（Web 版ではこのパラメータは利用できません）
 		/// @remark Web 版では、この関数はルームのプロパティが変更された時の他にも呼ばれることがあります。
@@ -836,6 +2498,61 @@ namespace s3d
 		/// @param oldHostPlayerID 古いホストのローカルプレイヤー ID
 		virtual void onHostChange([[maybe_unused]] LocalPlayerID newHostPlayerID, [[maybe_unused]] LocalPlayerID oldHostPlayerID) {}
 
+		/// @brief setEventTrafficReportInterval() で設定した間隔ごとに、update() の中で呼ばれます。
+		/// @param stats イベントコードごとの通信量と処理時間の一覧（累計）
+		virtual void onEventTrafficReport([[maybe_unused]] const Array<EventTrafficStats>& stats) {}
+
+		/// @brief 接続品質がしきい値を超えた状態が続いたときに、update() の中で呼ばれます。
+		/// @param stats 接続品質の状態
+		virtual void onConnectionDegraded([[maybe_unused]] const ConnectionQualityStats& stats) {}
+
+		/// @brief 低下していた接続品質がしきい値を下回った状態が続いたときに、update() の中で呼ばれます。
+		/// @param stats 接続品質の状態
+		virtual void onConnectionRecovered([[maybe_unused]] const ConnectionQualityStats& stats) {}
+
+		/// @brief 自動再接続が有効なとき、再接続を予定したときに呼ばれます。
+		/// @param attempt 何回目の再接続であるか（1 から始まる）
+		/// @param delay 再接続を試みるまでの待ち時間
+		virtual void onReconnecting([[maybe_unused]] int32 attempt, [[maybe_unused]] Milliseconds delay) {}
+
+		/// @brief 自動再接続が有効なとき、再接続（ルームに参加していた場合は再参加）に成功したときに呼ばれます。
+		virtual void onReconnected() {}
+
+		/// @brief 自動再接続が有効なとき、再接続の回数が上限に達したときや、ルームに再参加できなかったときに呼ばれます。
+		virtual void onReconnectFailed() {}
+
+		/// @brief sendStream() による転送が進んだときに呼ばれます。
+		/// @param progress 転送の進捗
+		/// @remark 送信側では受信の確認が取れたとき、受信側ではチャンクを受信したときに呼ばれます。
+		virtual void onStreamProgress([[maybe_unused]] const StreamProgress& progress) {}
+
+		/// @brief sendStream() による転送が、送信先（または送信者）の退出や cancelStream()、受信側の拒否によって中止されたときに呼ばれます。
+		/// @param progress 中止されたときの転送の進捗
+		virtual void onStreamFailed([[maybe_unused]] const StreamProgress& progress) {}
+
+		/// @brief ホスト移行が有効なとき、ホストが後継者に送信するチェックポイントを書き込むために呼ばれます。
+		/// @param writer チェックポイントの書き込み先
+		/// @remark 何も書き込まなかった場合、チェックポイントは送信されません。
+		virtual void writeHostCheckpoint([[maybe_unused]] Serializer<MemoryWriter>& writer) {}
+
+		/// @brief ホスト移行が有効なとき、自分が新しいホストになった直後（onHostChange() の前）に、最新のチェックポイントを復元するために呼ばれます。
+		/// @param oldHostPlayerID チェックポイントを送信した古いホストのローカルプレイヤー ID
+		/// @param reader チェックポイントのデータ
+		virtual void restoreHostCheckpoint([[maybe_unused]] LocalPlayerID oldHostPlayerID, [[maybe_unused]] Deserializer<MemoryViewReader>& reader) {}
+
+		/// @brief スナップショットが有効なとき、ホストが後から参加したプレイヤーに送信するスナップショットを書き込むために呼ばれます。
+		/// @param newPlayerIDs スナップショットを送信するプレイヤーのローカルプレイヤー ID
+		/// @param writer スナップショットの書き込み先
+		/// @remark 何も書き込まなかった場合、スナップショットは送信されません。
+		virtual void writeJoinSnapshot([[maybe_unused]] const Array<LocalPlayerID>& newPlayerIDs, [[maybe_unused]] Serializer<MemoryWriter>& writer) {}
+
+		/// @brief スナップショットが有効なとき、ルームに参加した後、ホストから受信したスナップショットを適用するために呼ばれます。
+		/// @param hostPlayerID スナップショットを送信したホストのローカルプレイヤー ID
+		/// @param reader スナップショットのデータ
+		/// @remark スナップショットより先に、キャッシュされたイベントを受信することがあります。
+		/// @remark 受信キューが有効な場合、ホストがスナップショットより前に送信したイベントは、このコールバックより先に処理されます。
+		virtual void applyJoinSnapshot([[maybe_unused]] LocalPlayerID hostPlayerID, [[maybe_unused]] Deserializer<MemoryViewReader>& reader) {}
+
 		/// @brief ルームのイベントを受信した際に呼ばれます。
 		/// @param playerID 送信者のローカルプレイヤー ID
 		/// @param eventCode イベントコード
@@ -857,14 +2574,59 @@ namespace s3d
 		template<class T, class... Args>
 		void RegisterEventCallback(uint8 eventCode, EventCallbackType<T, Args...> callback);
 
+		/// @brief sendPackedEvent() で送信されたイベントを受け取るコールバックを登録します。
+		/// @param eventCode イベントコード
+		/// @param callback コールバック
+		/// @remark データが不正な場合、コールバックは呼ばれません。
+		template<class T, class... Args>
+		void RegisterPackedEventCallback(uint8 eventCode, EventCallbackType<T, Args...> callback);
+
 		template<class... Args>
 		void debugLog(Args&&... args) const
 		{
-			if (m_verbose and m_logger) {
-				m_logger(Format(std::forward<Args>(args)...));
+			log(LogLevel::Debug, std::forward<Args>(args)...);
+		}
+
+		/// @brief ログを記録します。記録したログは update() の中で（または setLogThreadEnabled() で有効にしたスレッドで）出力されます。
+		/// @param level ログの重要度
+		/// @param args ログの内容。引数を取らない関数オブジェクトを渡した場合、level のログが出力されない設定のときは呼び出されません。出力される場合は、記録するときにその場で呼び出されます
+		/// @remark update() を呼ぶスレッドから呼んでください。
+		/// @remark ログのスレッドを使わない場合、リングバッファが一杯になると、記録済みのログを出力してから記録します。ログのスレッドを使う場合、出力が追いつかなかったログは捨てられ、捨てられた数が出力されます。
+		template<class... Args>
+		void log(LogLevel level, Args&&... args) const
+		{
+			if (not isLogEnabled(level))
+			{
+				return;
 			}
+
+			pushLog(Format(detail::EvaluateLogArg(std::forward<Args>(args))...));
 		}
 
+		/// @brief 指定した重要度のログが出力されるかを返します。
+		/// @param level ログの重要度
+		/// @return 出力される場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isLogEnabled(LogLevel level) const noexcept;
+
+		/// @brief 出力するログの重要度の下限を返します。
+		/// @return 出力するログの重要度の下限
+		[[nodiscard]]
+		LogLevel getLogLevel() const noexcept;
+
+		/// @brief 出力するログの重要度の下限を設定します。
+		/// @param level 出力するログの重要度の下限
+		void setLogLevel(LogLevel level) noexcept;
+
+		/// @brief 記録されたログをすべて出力します。
+		/// @remark ログを出力するスレッドが有効な場合は何もしません。
+		void flushLog() const;
+
+		/// @brief 記録されたログを別のスレッドで出力するかを設定します。
+		/// @param enabled 別のスレッドで出力する場合 true, update() の中で出力する場合は false
+		/// @remark ログの出力先関数がスレッドセーフな場合にのみ有効にしてください（Print はスレッドセーフではありません）。
+		void setLogThreadEnabled(bool enabled);
+
 	protected:
 
 		/// @brief 既存のランダムマッチが見つからなかった時のエラーコード
@@ -876,6 +2638,14 @@ namespace s3d
 
 	private:
 
+		template<class T, class... Args>
+		friend struct detail::EventWrapperImpl;
+
+		template<class T, class... Args>
+		friend struct detail::PackedEventWrapperImpl;
+
+		friend class MultiplayerReplay;
+
 # if not SIV3D_PLATFORM(WEB)
 		std::unique_ptr<ExitGames::LoadBalancing::Listener> m_listener;
 
@@ -894,9 +2664,430 @@ namespace s3d
 
 		Optional<String> m_requestedRegion;
 
-		HashTable<uint8, detail::CustomEventReceiver> m_table;
+		/// @brief 接続に使うユーザ ID（再接続しても同じプレイヤーとして扱われるように保持する）
+		String m_userID;
+
+		String m_lastUserName;
+
+		/// @brief 最後に接続に成功したリージョン
+		Optional<String> m_lastRegion;
+
+		/// @brief 最後に接続に成功したクラスタ
+		String m_lastCluster;
+
+		/// @brief 現在のクライアントが RegionSelectionMode::SELECT で作成されているか
+		bool m_clientSelectsRegion = false;
+
+		/// @brief reconnect() でルームに再参加するか
+		bool m_rejoinOnReconnect = false;
+
+		/// @brief 最速のリージョンを保存するファイル
+		Optional<FilePath> m_regionCachePath;
+
+		Duration m_regionCacheExpiry{ 0 };
+
+		/// @brief 保存されたリージョンを使った接続を試みていて、まだ接続に成功していないか
+		bool m_usingCachedRegion = false;
+
+		bool m_autoJoinLobby = true;
+
+		/// @brief 直前に requestRoomList() した条件
+		Optional<LobbyQuery> m_lastRoomQuery;
+
+		/// @brief 直前の結果の最後のルームの、orderBy() と thenBy() の列の値。続きが無い場合は none
+		Optional<std::pair<int32, int32>> m_nextRoomPageAfter;
+
+		/// @brief disconnect() による切断であるか
+		bool m_disconnectRequested = false;
+
+		/// @brief 次にルームに参加したとき、再参加としてイベントターゲットグループなどを設定し直すか
+		bool m_restoreOnRejoin = false;
+
+		/// @brief joinEventTargetGroup() によって参加しているイベントターゲットグループ
+		std::array<bool, 256> m_eventTargetGroups{};
+
+		Optional<detail::AutoReconnectState> m_autoReconnect;
+
+		/// @brief sendCachedEvent() でキャッシュしたイベントの写し
+		HashTable<uint8, detail::EventCacheMirror> m_eventCacheMirror;
+
+		size_t m_eventCacheCompactionThreshold = 32;
+
+		/// @brief ルームのキャッシュを写しで置き換える必要があるイベントコードがあるか
+		bool m_eventCacheResync = false;
+
+		/// @brief ルームに参加してから受信した、sendCachedEvent() のイベントコードごとのキー。スナップショットに含まれる受信済みのキーは処理しない
+		HashTable<uint8, HashSet<int32>> m_receivedCachedEventKeys;
+
+		/// @brief 登録されたコールバックの表。変更されないので、同じ派生クラスのインスタンスの間で共有される
+		std::shared_ptr<const detail::EventDispatchTable> m_table;
 
 		std::function<void(StringView)> m_logger;
+
+		LogLevel m_logLevel = LogLevel::Trace;
+
+		/// @brief ログのリングバッファ。大きいので、最初にログを記録するときに作成する
+		mutable std::unique_ptr<detail::LogRing> m_logRing;
+
+		std::thread m_logThread;
+
+		std::atomic<bool> m_logThreadRunning{ false };
+
+		void pushLog(StringView text) const;
+
+		void drainLog() const;
+
+		Optional<SpatialInterestOption> m_spatialInterest;
+
+		Optional<Vec2> m_interestPosition;
+
+		/// @brief 空間インタレスト管理によって参加しているイベントターゲットグループ
+		std::array<bool, 256> m_spatialInterestGroups{};
+
+		Optional<detail::HostMigrationState> m_hostMigration;
+
+		Optional<detail::JoinSnapshotState> m_joinSnapshot;
+
+		detail::StreamState m_streams;
+
+		Optional<detail::SendSchedulerState> m_sendScheduler;
+
+		/// @brief 送信スケジューラの、プライオリティインデックスごとの重み。設定されていない場合は 1.0
+		HashTable<uint8, double> m_sendChannelWeights;
+
+		detail::ClockSyncState m_clockSync;
+
+		std::unique_ptr<detail::EventTrafficTable> m_eventTraffic = std::make_unique<detail::EventTrafficTable>();
+
+		/// @brief update() の最初に中身を消す、一時的なバッファ
+		detail::FrameBuffers m_frameBuffers;
+
+		Optional<detail::ReceiveQueueState> m_receiveQueue;
+
+		std::array<ReceivePolicy, 256> m_receivePolicies{};
+
+		/// @brief 受信キューから取り出したイベントのデータ（容量を使い回す）
+		Blob m_receivedEventData;
+
+		/// @brief 直前に受信したイベントのデシリアライズにかかった時間（マイクロ秒）
+		uint64 m_lastDeserializeMicrosec = 0;
+
+		Milliseconds m_eventTrafficReportInterval{ 0 };
+
+		uint64 m_lastEventTrafficReportMillisec = 0;
+
+		detail::TrafficMeterState m_trafficMeter;
+
+		detail::ConnectionQualityState m_connectionQuality;
+
+		UpdateTimingStats m_lastUpdateTiming;
+
+		/// @brief 現在の update() の中で、イベントのコールバックにかかった時間（マイクロ秒）
+		uint64 m_updateCallbackMicrosec = 0;
+
+		BinaryWriter m_recordWriter;
+
+		uint64 m_recordingBeginMicrosec = 0;
+
+		/// @brief startTrace() で記録を開始したトレース。記録していない場合は nullptr
+		std::unique_ptr<detail::TraceBuffer> m_trace;
+
+		void updateSpatialInterest();
+
+		void leaveSpatialInterestGroups();
+
+		/// @brief ライブラリ内部で使うイベント（イベントコード 0）を送信します。
+		/// @param writer 先頭にイベントの種類を書き込んだシリアライザ
+		/// @param targets 送信先のプレイヤーのローカル ID のリスト。空の場合は自分以外の全員
+		/// @param priorityIndex プライオリティインデックス
+		void sendSystemEvent(const Serializer<MemoryWriter>& writer, const Array<LocalPlayerID>& targets = {}, uint8 priorityIndex = 0);
+
+		void onSystemEvent(LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader);
+
+		void updateHostMigration();
+
+		void onHostMigration(LocalPlayerID newHostPlayerID, LocalPlayerID oldHostPlayerID);
+
+		/// @brief ホストの場合、後から参加したプレイヤーにスナップショットを送信します。
+		void updateJoinSnapshot();
+
+		void receiveJoinSnapshotChunk(LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader);
+
+		/// @brief 送信量の上限まで sendStream() のチャンクを送信し、受信の確認を返します。
+		void updateStreams();
+
+		void receiveStreamChunk(LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader);
+
+		void receiveStreamAck(LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader);
+
+		void receiveStreamCancel(LocalPlayerID playerID, Deserializer<MemoryViewReader>& reader);
+
+		/// @brief 受信中の転送の受信を拒否し、送信者に中止を通知します。
+		void rejectStream(LocalPlayerID playerID, uint32 streamID);
+
+		/// @brief 受信の確認を送信します。
+		/// @param nextChunk 次に受信するチャンク
+		/// @param resend nextChunk から送信し直しを要求する場合 true
+		void sendStreamAck(LocalPlayerID playerID, uint32 streamID, uint32 nextChunk, bool resend);
+
+		/// @brief 受信の確認が取れていないチャンクから送信し直します。playerID が -1 の場合はすべての転送が対象です。
+		void rewindStreams(LocalPlayerID playerID);
+
+		/// @brief 退出したプレイヤーとの転送を中止します。playerID が -1 の場合はすべての転送が対象です。
+		void abortStreams(LocalPlayerID playerID);
+
+		/// @brief 受信したイベントを記録し、受信キューに入れるかコールバックに渡します。
+		void receiveCustomEvent(LocalPlayerID playerID, uint8 eventCode, const uint8* data, size_t size);
+
+		void updateClockSync();
+
+		void updateTrafficMeter();
+
+		void updateConnectionQuality();
+
+		[[nodiscard]]
+		Optional<String> loadRegionCache() const;
+
+		void saveRegionCache(StringView region) const;
+
+		/// @brief 自動再接続が有効な場合、次の再接続を予定します。
+		void scheduleReconnect();
+
+		void updateAutoReconnect();
+
+		/// @brief ルームに再参加した後、イベントターゲットグループとユーザ名を設定し直します。
+		void restoreAfterRejoin();
+
+		/// @brief 自動再接続を終了し、ルームに参加している場合は切断中に送信されたイベントを送信します。
+		void finishReconnect(bool succeeded);
+
+		void raiseEvent(const MultiplayerEvent& eventInfo, const Blob& data);
+
+		/// @brief 送信スケジューラが有効な場合はキューに入れ、それ以外の場合はすぐに送信します。
+		void submitEvent(const MultiplayerEvent& eventInfo, const Blob& data);
+
+		/// @brief 送信量の上限まで、送信スケジューラのキューにあるイベントを送信します。
+		/// @param all 上限を無視してすべて送信する場合 true
+		void updateSendScheduler(bool all = false);
+
+		/// @brief 送信スケジューラのキューにあるイベントを、送信量の上限を無視してすべて送信します。キューを通さずに送信する前に呼びます。
+		void flushSendScheduler();
+
+		/// @brief 他のプレイヤーが sendCachedEvent() でキャッシュしたイベントを受信したときに、写しから同じキーを取り除きます。
+		void onCachedEventReplaced(LocalPlayerID playerID, uint8 eventCode, int32 key);
+
+		/// @brief 自分がルームにキャッシュしたイベントを削除し、写しを 1 つのスナップショットとしてキャッシュし直します。
+		void compactEventCache(uint8 eventCode);
+
+		/// @brief ルームにいない間に sendCachedEvent() されたイベントをキャッシュします。
+		void updateEventCache();
+
+		/// @brief 新しいルームに参加したときに写しを削除します。
+		/// @param keepPending 前と同じルームに再参加した場合 true。ルームにいない間に sendCachedEvent() された写しを残します
+		void resetEventCacheMirror(bool keepPending);
+
+		/// @brief 受信したイベントを受信キューに入れます。
+		void enqueueReceivedEvent(LocalPlayerID playerID, uint8 eventCode, const uint8* data, size_t size);
+
+		/// @brief 受信キューのイベントを、時間の上限まで処理します。
+		/// @param all 時間の上限を無視してすべて処理する場合 true
+		void dispatchReceiveQueue(bool all = false);
+
+		/// @brief 受信キューに残っている、playerID が送信したイベントをすべて処理します。
+		void dispatchReceivedEventsFrom(LocalPlayerID playerID);
+
+		/// @brief 受信したイベントを登録されたコールバック（または customEventAction()）に渡します。
+		void dispatchCustomEvent(LocalPlayerID playerID, uint8 eventCode, Deserializer<MemoryViewReader>& reader, size_t size);
+
+		void writeRecord(detail::RecordKind kind, const Blob& payload);
+
+		template<class... Args>
+		void record(const detail::RecordKind kind, const Args&... args)
+		{
+			if (not m_recordWriter)
+			{
+				return;
+			}
+
+			Serializer<MemoryWriter> writer;
+			writer(args...);
+			writeRecord(kind, writer->getBlob());
+		}
+	};
+
+	/// @brief Multiplayer_Photon::startRecording() で記録したファイルを再生するクラス
+	/// @remark 記録されたコールバックを、サーバに接続していない Multiplayer_Photon（の派生クラス）に順番に渡します。ライブラリ内部で使うイベントは再生されません。
+	class MultiplayerReplay
+	{
+	public:
+
+		SIV3D_NODISCARD_CXX20
+		MultiplayerReplay() = default;
+
+		/// @brief 記録ファイルを開きます。
+		/// @param path 記録ファイルのパス
+		SIV3D_NODISCARD_CXX20
+		explicit MultiplayerReplay(FilePathView path);
+
+		/// @brief 記録ファイルを開き、レコードの索引を作成します。
+		/// @param path 記録ファイルのパス
+		/// @return 開くことができた場合 true, それ以外の場合は false
+		bool open(FilePathView path);
+
+		/// @brief 記録ファイルを閉じます。
+		void close();
+
+		/// @brief 記録ファイルを開いているかを返します。
+		/// @return 開いている場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isOpen() const noexcept;
+
+		/// @brief レコードの数を返します。
+		/// @return レコードの数
+		[[nodiscard]]
+		size_t num_records() const noexcept;
+
+		/// @brief 記録の長さ（最後のレコードの時刻、マイクロ秒）を返します。
+		/// @return 記録の長さ（マイクロ秒）
+		[[nodiscard]]
+		uint64 lengthMicrosec() const noexcept;
+
+		/// @brief 現在の再生位置（マイクロ秒）を返します。
+		/// @return 現在の再生位置（マイクロ秒）
+		[[nodiscard]]
+		uint64 positionMicrosec() const noexcept;
+
+		/// @brief すべてのレコードを再生したかを返します。
+		/// @return すべて再生した場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool isFinished() const noexcept;
+
+		/// @brief レコードを再生せずに、再生位置を移動します。
+		/// @param timeMicrosec 移動先の時刻（マイクロ秒）
+		void seek(uint64 timeMicrosec);
+
+		/// @brief 前回の呼び出しからの経過時間に応じて、再生位置までのレコードを再生します。
+		/// @param target レコードを渡す対象
+		/// @param speed 再生速度（1.0 で記録時と同じ速さ）
+		/// @return 再生したレコードの数
+		size_t update(Multiplayer_Photon& target, double speed = 1.0);
+
+		/// @brief 指定した時刻までのレコードを、待たずに再生します。
+		/// @param target レコードを渡す対象
+		/// @param timeMicrosec 再生する最後の時刻（マイクロ秒）
+		/// @return 再生したレコードの数
+		size_t playUntil(Multiplayer_Photon& target, uint64 timeMicrosec);
+
+		/// @brief 残りのすべてのレコードを、待たずに再生します。
+		/// @param target レコードを渡す対象
+		/// @return 再生したレコードの数
+		size_t playAll(Multiplayer_Photon& target);
+
+	private:
+
+		struct IndexEntry
+		{
+			int64 offset = 0;
+
+			uint64 timeMicrosec = 0;
+
+			uint32 size = 0;
+
+			detail::RecordKind kind = detail::RecordKind::CustomEvent;
+		};
+
+		BinaryReader m_reader;
+
+		Array<IndexEntry> m_index;
+
+		size_t m_next = 0;
+
+		double m_positionMicrosec = 0.0;
+
+		Optional<uint64> m_lastUpdateMicrosec;
+
+		Blob m_buffer;
+
+		void dispatch(Multiplayer_Photon& target, const IndexEntry& entry);
+	};
+
+	/// @brief MultiplayerMultiplexer の統計
+	struct MultiplexerStats
+	{
+		size_t numClients = 0;
+
+		/// @brief update() を呼んだスレッドを含むスレッドの数
+		size_t numThreads = 0;
+
+		/// @brief 直前の update() にかかった時間（マイクロ秒）
+		uint64 tickMicrosec = 0;
+
+		/// @brief 直前の update() で、各クライアントの update() にかかった時間の合計（マイクロ秒）
+		uint64 totalClientMicrosec = 0;
+
+		/// @brief 直前の update() で、クライアントの update() にかかった時間の最大値（マイクロ秒）
+		uint64 maxClientMicrosec = 0;
+
+		/// @brief 直前の update() で、他のスレッドのキューから取ったクライアントの数
+		uint64 stolenTasks = 0;
+	};
+
+	namespace detail
+	{
+		struct MultiplexerShared;
+	}
+
+	/// @brief 多数の Multiplayer_Photon を、少数のワーカースレッドで並列に update() するクラス
+	/// @remark クライアントは毎回スレッドのキューに均等に割り振られ、空になったスレッドは他のスレッドのキューからクライアントを取って処理します。
+	/// @remark 1 つのクライアントが同時に複数のスレッドで update() されることはありませんが、コールバックはワーカースレッドから呼ばれます。クライアントの間で共有するデータは保護してください。
+	/// @remark ログの出力先関数はスレッドセーフである必要があります（Print はスレッドセーフではありません）。
+	class MultiplayerMultiplexer
+	{
+	public:
+
+		/// @brief マルチプレクサを作成します。
+		/// @param numWorkers update() を呼んだスレッドの他に使うワーカースレッドの数
+		SIV3D_NODISCARD_CXX20
+		explicit MultiplayerMultiplexer(size_t numWorkers = (Max<size_t>(Threading::GetConcurrency(), 1) - 1));
+
+		~MultiplayerMultiplexer();
+
+		/// @brief update() するクライアントを追加します。
+		/// @param client クライアント。remove() するまで破棄しないでください
+		/// @remark update() を呼ぶスレッドから呼んでください。
+		void add(Multiplayer_Photon& client);
+
+		/// @brief クライアントを取り除きます。
+		/// @param client クライアント
+		/// @remark update() を呼ぶスレッドから呼んでください。
+		void remove(const Multiplayer_Photon& client);
+
+		/// @brief 追加されているクライアントの数を返します。
+		/// @return 追加されているクライアントの数
+		[[nodiscard]]
+		size_t num_clients() const noexcept;
+
+		/// @brief 追加されているすべてのクライアントを 1 回ずつ update() します。すべて終わるまで戻りません。
+		/// @remark クライアントの update() が例外を投げた場合、すべてのクライアントの処理が終わった後で、最初の例外をこのスレッドで投げ直します。
+		void update();
+
+		/// @brief 直前の update() の統計を返します。
+		/// @return 直前の update() の統計
+		[[nodiscard]]
+		const MultiplexerStats& getStats() const noexcept;
+
+	private:
+
+		Array<Multiplayer_Photon*> m_clients;
+
+		std::unique_ptr<detail::MultiplexerShared> m_shared;
+
+		Array<std::thread> m_workers;
+
+		/// @brief 毎回同じクライアントが後回しにならないように、割り振りの開始位置をずらす
+		size_t m_rotation = 0;
+
+		MultiplexerStats m_stats;
 	};
 
 	void Formatter(FormatData& formatData, ClientState value);
@@ -906,35 +3097,135 @@ namespace s3d
 		template<class T, class... Args>
 		struct EventWrapperImpl
 		{
-			static void wrapper(Multiplayer_Photon& client, TypeErasedCallback callback, LocalPlayerID player, Deserializer<MemoryViewReader>& reader)
+			static void wrapper(Multiplayer_Photon& client, TypeErasedCallback callback, LocalPlayerID player, [[maybe_unused]] uint8 eventCode, Deserializer<MemoryViewReader>& reader)
 			{
+				using Indices = std::make_index_sequence<sizeof...(Args)>;
+
 				std::tuple<std::remove_cvref_t<Args>...> args{};
-				impl(static_cast<T&>(client), callback, player, reader, args, std::make_index_sequence<std::tuple_size_v<std::tuple<Args...>>>());
+
+				{
+					MULTIPLAYER_PHOTON_TRACE_SCOPE(client.m_trace.get(), U"deserialize", eventCode);
+					const uint64 deserializeBegin = Time::GetMicrosec();
+					read(reader, args, Indices{});
+					client.m_lastDeserializeMicrosec = (Time::GetMicrosec() - deserializeBegin);
+				}
+
+				{
+					MULTIPLAYER_PHOTON_TRACE_SCOPE(client.m_trace.get(), U"callback", eventCode);
+					invoke(static_cast<T&>(client), callback, player, args, Indices{});
+				}
 			}
 
-			static void impl(T& client, TypeErasedCallback callback, LocalPlayerID player, [[maybe_unused]] Deserializer<MemoryViewReader>& reader, [[maybe_unused]] std::tuple<> args, std::integer_sequence<size_t>)
+			static void read([[maybe_unused]] Deserializer<MemoryViewReader>& reader, [[maybe_unused]] std::tuple<>& args, std::integer_sequence<size_t>) {}
+
+			template<std::size_t... I>
+			static void read(Deserializer<MemoryViewReader>& reader, std::tuple<std::remove_cvref_t<Args>...>& args, std::integer_sequence<size_t, I...>)
 			{
-				(client.*reinterpret_cast<Multiplayer_Photon::EventCallbackType<T, Args...>>(callback))(player);
+				reader(std::get<I>(args)...);
 			}
 
 			template<std::size_t... I>
-			static void impl(T& client, TypeErasedCallback callback, LocalPlayerID player, Deserializer<MemoryViewReader>& reader, std::tuple<std::remove_cvref_t<Args>...> args, std::integer_sequence<size_t, I...>)
+			static void invoke(T& client, TypeErasedCallback callback, LocalPlayerID player, [[maybe_unused]] std::tuple<std::remove_cvref_t<Args>...>& args, std::integer_sequence<size_t, I...>)
 			{
-				reader(std::get<I>(args)...);
 				(client.*reinterpret_cast<Multiplayer_Photon::EventCallbackType<T, Args...>>(callback))(player, static_cast<std::tuple_element_t<I, std::tuple<Args...>>>(std::get<I>(args))...);
 			}
 		};
+
+		template<class T, class... Args>
+		struct PackedEventWrapperImpl
+		{
+			static void wrapper(Multiplayer_Photon& client, TypeErasedCallback callback, LocalPlayerID player, [[maybe_unused]] uint8 eventCode, Deserializer<MemoryViewReader>& reader)
+			{
+				using Indices = std::make_index_sequence<sizeof...(Args)>;
+
+				std::tuple<std::remove_cvref_t<Args>...> args{};
+
+				{
+					MULTIPLAYER_PHOTON_TRACE_SCOPE(client.m_trace.get(), U"deserialize", eventCode);
+					const uint64 deserializeBegin = Time::GetMicrosec();
+
+					// MemoryViewReader からはデータの先頭を得られないので、残りをコピーしてから読み出す
+					auto& buffer = client.m_frameBuffers.packedBuffer;
+					buffer.resize(static_cast<size_t>(reader->size() - reader->getPos()));
+					reader->read(buffer.data(), static_cast<int64>(buffer.size()));
+
+					PackedReader packedReader{ buffer.data(), buffer.size() };
+					std::apply([&packedReader](auto&... arg) { packedReader(arg...); }, args);
+					client.m_lastDeserializeMicrosec = (Time::GetMicrosec() - deserializeBegin);
+
+					if (packedReader.hasError())
+					{
+						client.debugLog(U"[Multiplayer_Photon] Multiplayer_Photon::RegisterPackedEventCallback() failed to read the event data (", buffer.size(), U" bytes)");
+						return;
+					}
+				}
+
+				{
+					MULTIPLAYER_PHOTON_TRACE_SCOPE(client.m_trace.get(), U"callback", eventCode);
+					EventWrapperImpl<T, Args...>::invoke(static_cast<T&>(client), callback, player, args, Indices{});
+				}
+			}
+		};
 	}
 
 	template<class... Args>
 	void Multiplayer_Photon::sendEvent(const MultiplayerEvent& event, Args... args)
 	{
-		sendEvent(event, Serializer<MemoryWriter> {}(args...));
+		const uint64 serializeBegin = Time::GetMicrosec();
+		auto& writer = m_frameBuffers.sendWriter;
+		writer->clear();
+		writer(args...);
+		(*m_eventTraffic)[event.eventCode()].serializeMicrosec.fetch_add((Time::GetMicrosec() - serializeBegin), std::memory_order_relaxed);
+
+		sendEvent(event, writer);
 	}
 
 	template<>
 	void Multiplayer_Photon::sendEvent<>(const MultiplayerEvent& event);
 
+	template<class... Args>
+	void Multiplayer_Photon::sendPackedEvent(const MultiplayerEvent& event, const Args&... args)
+	{
+		const uint64 serializeBegin = Time::GetMicrosec();
+		auto& packedWriter = m_frameBuffers.packedWriter;
+		packedWriter.clear();
+		packedWriter(args...);
+		const auto& bytes = packedWriter.finish();
+
+		auto& writer = m_frameBuffers.sendWriter;
+		writer->clear();
+		writer->write(bytes.data(), static_cast<int64>(bytes.size()));
+		(*m_eventTraffic)[event.eventCode()].serializeMicrosec.fetch_add((Time::GetMicrosec() - serializeBegin), std::memory_order_relaxed);
+
+		sendEvent(event, writer);
+	}
+
+	template<class... Args>
+	void Multiplayer_Photon::sendCachedEvent(const MultiplayerEvent& event, const int32 key, Args... args)
+	{
+		const uint64 serializeBegin = Time::GetMicrosec();
+		auto& writer = m_frameBuffers.sendWriter;
+		writer->clear();
+		writer(args...);
+		(*m_eventTraffic)[event.eventCode()].serializeMicrosec.fetch_add((Time::GetMicrosec() - serializeBegin), std::memory_order_relaxed);
+
+		sendCachedEvent(event, key, writer);
+	}
+
+	template<class... Args>
+	uint32 Multiplayer_Photon::sendStream(const LocalPlayerID targetPlayerID, const uint8 eventCode, Args... args)
+	{
+		Serializer<MemoryWriter> writer;
+		writer(args...);
+		return sendStream(targetPlayerID, eventCode, writer);
+	}
+
+	template<class... Args>
+	void Multiplayer_Photon::sendEventAt(const uint8 eventCode, const Vec2& position, Args... args)
+	{
+		sendEvent(MultiplayerEvent{ eventCode, getInterestTargetGroup(position) }, args...);
+	}
+
 	template<class T, class ...Args>
 	void Multiplayer_Photon::RegisterEventCallback(uint8 eventCode, Multiplayer_Photon::EventCallbackType<T, Args...> callback)
 	{
@@ -943,7 +3234,23 @@ namespace s3d
 			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
 		}
 
-		m_table[static_cast<uint8>(eventCode)] = detail::CustomEventReceiver(reinterpret_cast<detail::TypeErasedCallback>(callback), &detail::EventWrapperImpl<T, Args...>::wrapper);
+		// 表は共有されているので、書き換えずにコピーしてから登録する
+		detail::EventDispatchTable table = (m_table ? *m_table : detail::EventDispatchTable{});
+		table[eventCode] = detail::CustomEventReceiver(reinterpret_cast<detail::TypeErasedCallback>(callback), &detail::EventWrapperImpl<T, Args...>::wrapper);
+		m_table = detail::InternEventDispatchTable(table);
+	}
+
+	template<class T, class ...Args>
+	void Multiplayer_Photon::RegisterPackedEventCallback(uint8 eventCode, Multiplayer_Photon::EventCallbackType<T, Args...> callback)
+	{
+		if (not InRange(static_cast<int>(eventCode), 1, 199))
+		{
+			throw Error{ U"[Multiplayer_Photon] EventCode must be in a range of 1 to 199" };
+		}
+
+		detail::EventDispatchTable table = (m_table ? *m_table : detail::EventDispatchTable{});
+		table[eventCode] = detail::CustomEventReceiver(reinterpret_cast<detail::TypeErasedCallback>(callback), &detail::PackedEventWrapperImpl<T, Args...>::wrapper);
+		m_table = detail::InternEventDispatchTable(table);
 	}
 }
 
@@ -0,0 +1,226 @@
+﻿//-----------------------------------------------
+//	NetworkProfilerOverlay: Multiplayer_Photon の通信の状態を画面に重ねて表示する
+//-----------------------------------------------
+
+# include "NetworkProfilerOverlay.hpp"
+
+namespace s3d
+{
+	namespace
+	{
+		constexpr double PanelWidth = 320.0;
+
+		constexpr double PanelHeight = 64.0;
+
+		constexpr double PanelMargin = 6.0;
+
+		/// @brief イベント数のパネルに名前を表示するイベントコードの数
+		constexpr size_t NumTopEventCodes = 4;
+
+		constexpr std::array<ColorF, NetworkProfilerOverlay::MaxSeries> SeriesColors{ ColorF{ 0.3, 0.9, 0.5 }, ColorF{ 1.0, 0.6, 0.2 } };
+	}
+
+	void NetworkProfilerOverlay::Series::push(const double value) noexcept
+	{
+		values[next] = static_cast<float>(value);
+		next = ((next + 1) % HistoryLength);
+		count = Min((count + 1), HistoryLength);
+	}
+
+	double NetworkProfilerOverlay::Series::latest() const noexcept
+	{
+		if (count == 0)
+		{
+			return 0.0;
+		}
+
+		return values[(next + HistoryLength - 1) % HistoryLength];
+	}
+
+	double NetworkProfilerOverlay::Series::max() const noexcept
+	{
+		float result = 0.0f;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			result = Max(result, values[i]);
+		}
+
+		return result;
+	}
+
+	NetworkProfilerOverlay::NetworkProfilerOverlay()
+	{
+		m_panels[Bandwidth] = Panel{ .label = U"bandwidth", .unit = U"KB/s", .seriesNames = { U"in", U"out" }, .numSeries = 2 };
+		m_panels[Events] = Panel{ .label = U"events", .unit = U"/s", .seriesNames = { U"received", U"" }, .numSeries = 1 };
+		m_panels[RoundTrip] = Panel{ .label = U"round trip", .unit = U"ms", .seriesNames = { U"rtt", U"variance" }, .numSeries = 2 };
+		m_panels[Queues] = Panel{ .label = U"queued commands", .unit = U"", .seriesNames = { U"out", U"in" }, .numSeries = 2 };
+		m_panels[UpdateTime] = Panel{ .label = U"update()", .unit = U"us", .seriesNames = { U"service", U"callback" }, .numSeries = 2 };
+
+		m_lineBuffer.reserve(HistoryLength);
+
+		updateLabels();
+	}
+
+	void NetworkProfilerOverlay::setSampleInterval(const Duration interval)
+	{
+		m_sampleInterval = Max(interval, Duration{ 0.0 });
+	}
+
+	void NetworkProfilerOverlay::update(const Multiplayer_Photon& network)
+	{
+		const auto& timing = network.getLastUpdateTiming();
+		m_maxServiceMicrosec = Max(m_maxServiceMicrosec, timing.serviceMicrosec);
+		m_maxCallbackMicrosec = Max(m_maxCallbackMicrosec, timing.callbackMicrosec);
+
+		const double elapsedSec = m_stopwatch.sF();
+
+		if (elapsedSec < m_sampleInterval.count())
+		{
+			return;
+		}
+
+		m_stopwatch.restart();
+
+		sample(network, elapsedSec);
+
+		m_maxServiceMicrosec = 0;
+		m_maxCallbackMicrosec = 0;
+	}
+
+	void NetworkProfilerOverlay::sample(const Multiplayer_Photon& network, const double elapsedSec)
+	{
+# if not SIV3D_PLATFORM(WEB)
+		const auto& rates = network.getTrafficRates().last1s;
+		m_panels[Bandwidth].series[0].push(rates.bytesInPerSec / 1024.0);
+		m_panels[Bandwidth].series[1].push(rates.bytesOutPerSec / 1024.0);
+# endif
+
+		{
+			double total = 0.0;
+			m_topEventRates.clear();
+
+			for (const auto& stats : network.getEventTrafficStats())
+			{
+				uint64& last = m_lastReceivedCounts[stats.eventCode];
+				const double rate = ((stats.receivedCount - Min(last, stats.receivedCount)) / elapsedSec);
+				last = stats.receivedCount;
+
+				total += rate;
+
+				if (0.0 < rate)
+				{
+					m_topEventRates.emplace_back(stats.eventCode, rate);
+				}
+			}
+
+			const size_t numTop = Min(m_topEventRates.size(), NumTopEventCodes);
+			std::partial_sort(m_topEventRates.begin(), (m_topEventRates.begin() + numTop), m_topEventRates.end(),
+				[](const auto& a, const auto& b) { return (b.second < a.second); });
+			m_topEventRates.resize(numTop);
+
+			m_panels[Events].series[0].push(total);
+		}
+
+		const auto& quality = network.getConnectionQuality();
+		m_panels[RoundTrip].series[0].push(quality.roundTripMillisec);
+		m_panels[RoundTrip].series[1].push(quality.roundTripVarianceMillisec);
+		m_panels[Queues].series[0].push(quality.queuedOutgoingCommands);
+		m_panels[Queues].series[1].push(quality.queuedIncomingCommands);
+
+		m_panels[UpdateTime].series[0].push(static_cast<double>(m_maxServiceMicrosec));
+		m_panels[UpdateTime].series[1].push(static_cast<double>(m_maxCallbackMicrosec));
+
+		updateLabels();
+	}
+
+	void NetworkProfilerOverlay::updateLabels()
+	{
+		for (auto& panel : m_panels)
+		{
+			// 重ねて表示する系列は同じ縦軸の範囲を使う
+			panel.maxValue = 1.0;
+
+			for (size_t s = 0; s < panel.numSeries; ++s)
+			{
+				panel.maxValue = Max(panel.maxValue, panel.series[s].max());
+			}
+
+			panel.header = panel.label;
+
+			for (size_t s = 0; s < panel.numSeries; ++s)
+			{
+				panel.header += U"  {} {:.1f}{}"_fmt(panel.seriesNames[s], panel.series[s].latest(), panel.unit);
+			}
+
+			panel.maxLabel = U"max {:.1f}"_fmt(panel.maxValue);
+		}
+
+		m_topEventLabels.resize(m_topEventRates.size());
+
+		for (size_t i = 0; i < m_topEventRates.size(); ++i)
+		{
+			m_topEventLabels[i] = U"#{}: {:.0f}/s"_fmt(m_topEventRates[i].first, m_topEventRates[i].second);
+		}
+	}
+
+	void NetworkProfilerOverlay::draw(const Vec2& pos) const
+	{
+		for (size_t i = 0; i < NumPanels; ++i)
+		{
+			const RectF rect{ pos.x, (pos.y + i * (PanelHeight + PanelMargin)), PanelWidth, PanelHeight };
+			drawPanel(m_panels[i], rect);
+
+			if (i == Events)
+			{
+				Vec2 textPos = rect.tr().movedBy(-4, 16);
+
+				for (const auto& label : m_topEventLabels)
+				{
+					m_font(label).draw(Arg::topRight = textPos, Palette::White);
+					textPos.y += 12;
+				}
+			}
+		}
+	}
+
+	SizeF NetworkProfilerOverlay::size() const noexcept
+	{
+		return{ PanelWidth, (NumPanels * (PanelHeight + PanelMargin) - PanelMargin) };
+	}
+
+	void NetworkProfilerOverlay::drawPanel(const Panel& panel, const RectF& rect) const
+	{
+		rect.draw(ColorF{ 0.0, 0.6 });
+
+		const double maxValue = panel.maxValue;
+		const RectF area = rect.stretched(-16, -4, -14, -4);
+		const double dx = (area.w / (HistoryLength - 1));
+
+		for (size_t s = 0; s < panel.numSeries; ++s)
+		{
+			const auto& series = panel.series[s];
+
+			if (series.count < 2)
+			{
+				continue;
+			}
+
+			// 古いサンプルから順に、右端が最新になるように並べる
+			m_lineBuffer.clear();
+			const size_t first = ((series.next + HistoryLength - series.count) % HistoryLength);
+			const double offsetX = (area.w - (series.count - 1) * dx);
+
+			for (size_t i = 0; i < series.count; ++i)
+			{
+				const double value = series.values[(first + i) % HistoryLength];
+				m_lineBuffer.push_back(Vec2{ (area.x + offsetX + i * dx), (area.bottomY() - (value / maxValue) * area.h) });
+			}
+
+			m_lineBuffer.draw(1.5, SeriesColors[s]);
+		}
+
+		m_font(panel.header).draw(rect.pos.movedBy(4, 1), Palette::White);
+		m_font(panel.maxLabel).draw(Arg::bottomLeft = rect.bl().movedBy(4, -1), ColorF{ 0.8 });
+	}
+}
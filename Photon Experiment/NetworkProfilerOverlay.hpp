@@ -0,0 +1,127 @@
+﻿//-----------------------------------------------
+//	NetworkProfilerOverlay: Multiplayer_Photon の通信の状態を画面に重ねて表示する
+//-----------------------------------------------
+
+# pragma once
+# include <Siv3D.hpp>
+# include "Multiplayer_Photon.hpp"
+
+namespace s3d
+{
+	/// @brief Multiplayer_Photon の通信量、イベント数、RTT、キューの長さ、update() の処理時間をスクロールするグラフで表示するオーバーレイ
+	class NetworkProfilerOverlay
+	{
+	public:
+
+		/// @brief 1 つのグラフが保持するサンプルの数
+		static constexpr size_t HistoryLength = 240;
+
+		/// @brief 1 つのグラフに重ねて表示する系列の最大数
+		static constexpr size_t MaxSeries = 2;
+
+		SIV3D_NODISCARD_CXX20
+		NetworkProfilerOverlay();
+
+		/// @brief サンプルを記録する間隔を設定します。
+		/// @param interval サンプルを記録する間隔
+		/// @remark 間隔の間の update() の処理時間は、最大値が記録されます。
+		void setSampleInterval(Duration interval);
+
+		/// @brief Multiplayer_Photon::update() の後に毎フレーム呼び出して、サンプルを記録します。
+		/// @param network 計測する Multiplayer_Photon
+		void update(const Multiplayer_Photon& network);
+
+		/// @brief オーバーレイを描画します。
+		/// @param pos 左上の座標
+		/// @remark 表示する文字列は、サンプルを記録したときに作成されます。
+		void draw(const Vec2& pos = Vec2{ 10, 10 }) const;
+
+		/// @brief オーバーレイの大きさを返します。
+		/// @return オーバーレイの大きさ
+		[[nodiscard]]
+		SizeF size() const noexcept;
+
+	private:
+
+		/// @brief サンプルのリングバッファ
+		struct Series
+		{
+			std::array<float, HistoryLength> values{};
+
+			size_t next = 0;
+
+			size_t count = 0;
+
+			void push(double value) noexcept;
+
+			[[nodiscard]]
+			double latest() const noexcept;
+
+			[[nodiscard]]
+			double max() const noexcept;
+		};
+
+		struct Panel
+		{
+			String label;
+
+			/// @brief 値の単位
+			String unit;
+
+			std::array<Series, MaxSeries> series;
+
+			std::array<String, MaxSeries> seriesNames;
+
+			size_t numSeries = 1;
+
+			/// @brief 重ねて表示する系列で共通の縦軸の上限
+			double maxValue = 1.0;
+
+			/// @brief 描画する文字列。サンプルを記録したときだけ作り直す
+			String header;
+
+			String maxLabel;
+		};
+
+		enum PanelIndex : size_t
+		{
+			Bandwidth,
+			Events,
+			RoundTrip,
+			Queues,
+			UpdateTime,
+			NumPanels,
+		};
+
+		Font m_font{ 12 };
+
+		std::array<Panel, NumPanels> m_panels;
+
+		Duration m_sampleInterval{ 0.05 };
+
+		Stopwatch m_stopwatch{ StartImmediately::Yes };
+
+		/// @brief イベントコードごとの、前回のサンプルでの受信数
+		HashTable<uint8, uint64> m_lastReceivedCounts;
+
+		/// @brief 受信数の多いイベントコードと、1 秒あたりの受信数
+		Array<std::pair<uint8, double>> m_topEventRates;
+
+		/// @brief m_topEventRates を描画する文字列
+		Array<String> m_topEventLabels;
+
+		uint64 m_maxServiceMicrosec = 0;
+
+		uint64 m_maxCallbackMicrosec = 0;
+
+		/// @brief 描画のたびに確保し直さないように使い回す頂点の配列
+		mutable LineString m_lineBuffer;
+
+		void sample(const Multiplayer_Photon& network, double elapsedSec);
+
+		/// @brief 記録したサンプルから、描画する文字列を作り直します。
+		void updateLabels();
+
+		void drawPanel(const Panel& panel, const RectF& rect) const;
+	};
+}
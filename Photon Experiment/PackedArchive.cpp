@@ -0,0 +1,609 @@
+﻿//-----------------------------------------------
+//	PackedArchive: 値をビット単位で詰めて書き込み・読み出す
+//-----------------------------------------------
+
+# include "PackedArchive.hpp"
+# if SIV3D_INTRINSIC(SSE)
+#	include <emmintrin.h>
+# endif
+
+namespace s3d
+{
+	namespace
+	{
+		[[nodiscard]]
+		constexpr uint64 LowBitMask(const uint32 numBits) noexcept
+		{
+			return ((numBits < 64) ? ((uint64{ 1 } << numBits) - 1) : ~uint64{ 0 });
+		}
+
+		static_assert(std::endian::native == std::endian::little, "StoreFixed() and the SIMD paths write the integers in memory order");
+
+		/// @brief 量子化した値を byteWidth バイトのリトルエンディアンの整数として書き込む
+		void StoreFixed(const uint32 step, const uint32 byteWidth, uint8* dst) noexcept
+		{
+			std::memcpy(dst, &step, byteWidth);
+		}
+
+		[[nodiscard]]
+		uint32 LoadFixed(const uint8* src, const uint32 byteWidth) noexcept
+		{
+			uint32 step = 0;
+			std::memcpy(&step, src, byteWidth);
+			return step;
+		}
+
+		[[nodiscard]]
+		uint32 QuantizeOne(const double x, const detail::FixedQuantization& q) noexcept
+		{
+			// NaN は minValue として扱う
+			const double clamped = ((not (q.minValue < x)) ? q.minValue : ((q.maxValue < x) ? q.maxValue : x));
+			const double step = std::nearbyint((clamped - q.minValue) * (1.0 / q.precision));
+			return static_cast<uint32>(Min(step, static_cast<double>(q.maxStep)));
+		}
+
+		[[nodiscard]]
+		double DequantizeOne(const uint32 step, const detail::FixedQuantization& q) noexcept
+		{
+			return Min((q.minValue + step * q.precision), q.maxValue);
+		}
+
+		[[nodiscard]]
+		uint32 FloatBits(const float x) noexcept
+		{
+			return std::bit_cast<uint32>(x);
+		}
+
+		/// @brief 単精度浮動小数点数を半精度に変換する（最近接偶数への丸め）。SIMD 版と同じ結果になるように、同じ手順で計算する
+		[[nodiscard]]
+		uint16 FloatToHalf(const float x) noexcept
+		{
+			constexpr uint32 F32Infinity = (255u << 23);
+			constexpr uint32 F16Max = ((127u + 16) << 23);
+			constexpr uint32 DenormMagic = (((127u - 15) + (23 - 10) + 1) << 23);
+
+			uint32 u = FloatBits(x);
+			const uint32 sign = (u & 0x8000'0000u);
+			u ^= sign;
+
+			uint32 result;
+
+			if (F16Max <= u)
+			{
+				// 無限大または NaN
+				result = ((F32Infinity < u) ? 0x7E00u : 0x7C00u);
+			}
+			else if (u < (113u << 23))
+			{
+				// 非正規化数または 0 になる場合は、加算の丸めで仮数部を揃える
+				result = (FloatBits(std::bit_cast<float>(u) + std::bit_cast<float>(DenormMagic)) - DenormMagic);
+			}
+			else
+			{
+				const uint32 mantissaOdd = ((u >> 13) & 1);
+				result = ((u + (static_cast<uint32>(15 - 127) << 23) + 0xFFF + mantissaOdd) >> 13);
+			}
+
+			return static_cast<uint16>(result | (sign >> 16));
+		}
+
+		[[nodiscard]]
+		float HalfToFloat(const uint16 h) noexcept
+		{
+			constexpr uint32 ShiftedExponent = (0x7C00u << 13);
+			constexpr float Magic = std::bit_cast<float>(113u << 23);
+
+			uint32 u = ((h & 0x7FFFu) << 13);
+			const uint32 exponent = (ShiftedExponent & u);
+			u += (static_cast<uint32>(127 - 15) << 23);
+
+			if (exponent == ShiftedExponent)
+			{
+				// 無限大または NaN
+				u += (static_cast<uint32>(128 - 16) << 23);
+			}
+			else if (exponent == 0)
+			{
+				// 非正規化数
+				u = FloatBits(std::bit_cast<float>(u + (1u << 23)) - Magic);
+			}
+
+			return std::bit_cast<float>(u | ((h & 0x8000u) << 16));
+		}
+
+# if SIV3D_INTRINSIC(SSE)
+
+		/// @brief 4 つの値を double に変換して読み込む
+		void Load4(const float* src, __m128d& lo, __m128d& hi) noexcept
+		{
+			const __m128 x = _mm_loadu_ps(src);
+			lo = _mm_cvtps_pd(x);
+			hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+		}
+
+		void Load4(const double* src, __m128d& lo, __m128d& hi) noexcept
+		{
+			lo = _mm_loadu_pd(src);
+			hi = _mm_loadu_pd(src + 2);
+		}
+
+		void Store4(const __m128d lo, const __m128d hi, float* dst) noexcept
+		{
+			_mm_storeu_ps(dst, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+		}
+
+		void Store4(const __m128d lo, const __m128d hi, double* dst) noexcept
+		{
+			_mm_storeu_pd(dst, lo);
+			_mm_storeu_pd((dst + 2), hi);
+		}
+
+		/// @brief 4 つの float を 8 バイトの半精度浮動小数点数に変換する
+		[[nodiscard]]
+		__m128i FloatToHalf4(const __m128 x) noexcept
+		{
+			const __m128i infinity = _mm_set1_epi32(255 << 23);
+			const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+			__m128i u = _mm_castps_si128(x);
+			const __m128i sign = _mm_and_si128(u, _mm_set1_epi32(static_cast<int32>(0x8000'0000u)));
+			u = _mm_xor_si128(u, sign);
+
+			const __m128i infNaN = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi32(u, infinity), _mm_set1_epi32(0x7E00)),
+				_mm_andnot_si128(_mm_cmpgt_epi32(u, infinity), _mm_set1_epi32(0x7C00)));
+			const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u), _mm_castsi128_ps(denormMagic))), denormMagic);
+			const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+			const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, _mm_set1_epi32(((15 - 127) << 23) + 0xFFF)), mantissaOdd), 13);
+
+			const __m128i isInfNaN = _mm_cmpgt_epi32(u, _mm_set1_epi32(((127 + 16) << 23) - 1));
+			const __m128i isSubnormal = _mm_cmplt_epi32(u, _mm_set1_epi32(113 << 23));
+
+			__m128i result = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+			result = _mm_or_si128(_mm_and_si128(isInfNaN, infNaN), _mm_andnot_si128(isInfNaN, result));
+			result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+			// 符号拡張してから詰めると、飽和せずに下位 16 ビットがそのまま残る
+			result = _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+			return _mm_packs_epi32(result, result);
+		}
+
+		/// @brief 下位 16 ビットに半精度浮動小数点数が入った 4 つの値を float に変換する
+		[[nodiscard]]
+		__m128 HalfToFloat4(const __m128i h) noexcept
+		{
+			const __m128i exponentMantissa = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+			const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exponentMantissa), 16);
+			const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+			const __m128i wasInfNaN = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7BFF));
+			const __m128i infNaNExponent = _mm_and_si128(wasInfNaN, _mm_set1_epi32(255 << 23));
+			return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNaNExponent)));
+		}
+
+# endif
+
+		template <class Float>
+		void QuantizeFixedImpl(const Float* src, const size_t count, const detail::FixedQuantization& q, uint8* dst)
+		{
+			size_t i = 0;
+
+# if SIV3D_INTRINSIC(SSE)
+
+			const __m128d minValue = _mm_set1_pd(q.minValue);
+			const __m128d maxValue = _mm_set1_pd(q.maxValue);
+			const __m128d scale = _mm_set1_pd(1.0 / q.precision);
+			const __m128d maxStep = _mm_set1_pd(static_cast<double>(q.maxStep));
+
+			// 2^52 を足して引くと、現在の丸めモード（std::nearbyint() と同じ）で整数に丸められる
+			const __m128d roundMagic = _mm_set1_pd(4503599627370496.0);
+
+			// _mm_cvtpd_epi32 は符号付きなので、2^31 ずらして変換してから符号ビットを戻す。丸めた後なので、ずらしても端数は生じない
+			const __m128d bias = _mm_set1_pd(2147483648.0);
+			const __m128i signBit = _mm_set1_epi32(static_cast<int32>(0x8000'0000u));
+
+			const auto toFixed = [&](__m128d x)
+			{
+				// _mm_max_pd は NaN に対して第 2 引数を返すので、NaN は minValue になる
+				x = _mm_min_pd(_mm_max_pd(x, minValue), maxValue);
+				x = _mm_mul_pd(_mm_sub_pd(x, minValue), scale);
+				x = _mm_min_pd(_mm_sub_pd(_mm_add_pd(x, roundMagic), roundMagic), maxStep);
+				return _mm_cvtpd_epi32(_mm_sub_pd(x, bias));
+			};
+
+			for (; (i + 4) <= count; i += 4)
+			{
+				__m128d lo, hi;
+				Load4((src + i), lo, hi);
+
+				const __m128i steps = _mm_xor_si128(_mm_unpacklo_epi64(toFixed(lo), toFixed(hi)), signBit);
+				uint8* out = (dst + i * q.byteWidth);
+
+				if (q.byteWidth == 4)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out), steps);
+				}
+				else if (q.byteWidth == 2)
+				{
+					// 0 から 65535 の値を 32768 ずらして符号付きで詰め、符号ビットを戻す
+					const __m128i shifted = _mm_sub_epi32(steps, _mm_set1_epi32(0x8000));
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_xor_si128(_mm_packs_epi32(shifted, shifted), _mm_set1_epi16(static_cast<int16>(0x8000))));
+				}
+				else
+				{
+					const __m128i words = _mm_packs_epi32(steps, steps);
+					const int32 bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+					std::memcpy(out, &bytes, sizeof(bytes));
+				}
+			}
+
+# endif
+
+			for (; i < count; ++i)
+			{
+				StoreFixed(QuantizeOne(src[i], q), q.byteWidth, (dst + i * q.byteWidth));
+			}
+		}
+
+		template <class Float>
+		void DequantizeFixedImpl(const uint8* src, const size_t count, const detail::FixedQuantization& q, Float* dst)
+		{
+			size_t i = 0;
+
+# if SIV3D_INTRINSIC(SSE)
+
+			const __m128d minValue = _mm_set1_pd(q.minValue);
+			const __m128d maxValue = _mm_set1_pd(q.maxValue);
+			const __m128d precision = _mm_set1_pd(q.precision);
+			const __m128d bias = _mm_set1_pd(2147483648.0);
+			const __m128i signBit = _mm_set1_epi32(static_cast<int32>(0x8000'0000u));
+			const __m128i zero = _mm_setzero_si128();
+
+			const auto toFloat = [&](const __m128i steps)
+			{
+				const __m128d x = _mm_add_pd(_mm_cvtepi32_pd(steps), bias);
+				return _mm_min_pd(_mm_add_pd(minValue, _mm_mul_pd(x, precision)), maxValue);
+			};
+
+			for (; (i + 4) <= count; i += 4)
+			{
+				const uint8* in = (src + i * q.byteWidth);
+				__m128i steps;
+
+				if (q.byteWidth == 4)
+				{
+					steps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+				}
+				else if (q.byteWidth == 2)
+				{
+					steps = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)), zero);
+				}
+				else
+				{
+					int32 bytes;
+					std::memcpy(&bytes, in, sizeof(bytes));
+					steps = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+				}
+
+				// 符号付きとして変換できるように 2^31 ずらす
+				steps = _mm_xor_si128(steps, signBit);
+				Store4(toFloat(steps), toFloat(_mm_unpackhi_epi64(steps, steps)), (dst + i));
+			}
+
+# endif
+
+			for (; i < count; ++i)
+			{
+				dst[i] = static_cast<Float>(DequantizeOne(LoadFixed((src + i * q.byteWidth), q.byteWidth), q));
+			}
+		}
+
+		void EncodeHalfImpl(const float* src, const size_t count, uint8* dst)
+		{
+			size_t i = 0;
+
+# if SIV3D_INTRINSIC(SSE)
+
+			for (; (i + 4) <= count; i += 4)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * sizeof(uint16)), FloatToHalf4(_mm_loadu_ps(src + i)));
+			}
+
+# endif
+
+			for (; i < count; ++i)
+			{
+				const uint16 h = FloatToHalf(src[i]);
+				std::memcpy((dst + i * sizeof(uint16)), &h, sizeof(uint16));
+			}
+		}
+
+		void DecodeHalfImpl(const uint8* src, const size_t count, float* dst)
+		{
+			size_t i = 0;
+
+# if SIV3D_INTRINSIC(SSE)
+
+			for (; (i + 4) <= count; i += 4)
+			{
+				const __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i * sizeof(uint16))), _mm_setzero_si128());
+				_mm_storeu_ps((dst + i), HalfToFloat4(h));
+			}
+
+# endif
+
+			for (; i < count; ++i)
+			{
+				uint16 h;
+				std::memcpy(&h, (src + i * sizeof(uint16)), sizeof(uint16));
+				dst[i] = HalfToFloat(h);
+			}
+		}
+
+		/// @brief double の配列を半精度に変換するときに、一度に float に変換する要素の数
+		constexpr size_t HalfBlockSize = 256;
+	}
+
+	namespace detail
+	{
+		void QuantizeFixed(const float* src, const size_t count, const FixedQuantization& q, uint8* dst)
+		{
+			QuantizeFixedImpl(src, count, q, dst);
+		}
+
+		void QuantizeFixed(const double* src, const size_t count, const FixedQuantization& q, uint8* dst)
+		{
+			QuantizeFixedImpl(src, count, q, dst);
+		}
+
+		void DequantizeFixed(const uint8* src, const size_t count, const FixedQuantization& q, float* dst)
+		{
+			DequantizeFixedImpl(src, count, q, dst);
+		}
+
+		void DequantizeFixed(const uint8* src, const size_t count, const FixedQuantization& q, double* dst)
+		{
+			DequantizeFixedImpl(src, count, q, dst);
+		}
+
+		void EncodeHalf(const float* src, const size_t count, uint8* dst)
+		{
+			EncodeHalfImpl(src, count, dst);
+		}
+
+		void EncodeHalf(const double* src, const size_t count, uint8* dst)
+		{
+			std::array<float, HalfBlockSize> block;
+
+			for (size_t i = 0; i < count; i += HalfBlockSize)
+			{
+				const size_t n = Min(HalfBlockSize, (count - i));
+				std::transform((src + i), (src + i + n), block.begin(), [](const double x) { return static_cast<float>(x); });
+				EncodeHalfImpl(block.data(), n, (dst + i * sizeof(uint16)));
+			}
+		}
+
+		void DecodeHalf(const uint8* src, const size_t count, float* dst)
+		{
+			DecodeHalfImpl(src, count, dst);
+		}
+
+		void DecodeHalf(const uint8* src, const size_t count, double* dst)
+		{
+			std::array<float, HalfBlockSize> block;
+
+			for (size_t i = 0; i < count; i += HalfBlockSize)
+			{
+				const size_t n = Min(HalfBlockSize, (count - i));
+				DecodeHalfImpl((src + i * sizeof(uint16)), n, block.data());
+				std::copy_n(block.begin(), n, (dst + i));
+			}
+		}
+	}
+
+	void PackedWriter::clear() noexcept
+	{
+		m_bytes.clear();
+		m_pendingBits = 0;
+		m_numPendingBits = 0;
+	}
+
+	void PackedWriter::writeBits(uint64 value, const uint32 numBits)
+	{
+		assert(numBits <= 64);
+
+		if (numBits == 0)
+		{
+			return;
+		}
+
+		value &= LowBitMask(numBits);
+		m_pendingBits |= (value << m_numPendingBits);
+
+		if ((m_numPendingBits + numBits) < 64)
+		{
+			m_numPendingBits += numBits;
+			return;
+		}
+
+		// 64 ビットたまったら、リトルエンディアンのまま m_bytes に移す
+		const size_t offset = m_bytes.size();
+		m_bytes.resize(offset + sizeof(uint64));
+		std::memcpy((m_bytes.data() + offset), &m_pendingBits, sizeof(uint64));
+
+		const uint32 consumed = (64 - m_numPendingBits);
+		m_pendingBits = ((consumed < 64) ? (value >> consumed) : 0);
+		m_numPendingBits = (numBits - consumed);
+	}
+
+	void PackedWriter::writeVarint(uint64 value)
+	{
+		while (0x80 <= value)
+		{
+			writeBits(((value & 0x7F) | 0x80), 8);
+			value >>= 7;
+		}
+
+		writeBits(value, 8);
+	}
+
+	void PackedWriter::writeBytes(const void* data, const size_t size)
+	{
+		const uint8* p = static_cast<const uint8*>(data);
+
+		// バイト境界にある場合はまとめてコピーする
+		if ((m_numPendingBits % 8) == 0)
+		{
+			if (size)
+			{
+				std::memcpy(appendAlignedBytes(size), p, size);
+			}
+
+			return;
+		}
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			writeBits(p[i], 8);
+		}
+	}
+
+	uint8* PackedWriter::appendAlignedBytes(const size_t size)
+	{
+		// 端数のビットを 0 で埋めて m_bytes に移す
+		[[maybe_unused]] const auto& bytes = finish();
+
+		const size_t offset = m_bytes.size();
+		m_bytes.resize(offset + size);
+		return (m_bytes.data() + offset);
+	}
+
+	size_t PackedWriter::num_bits() const noexcept
+	{
+		return (m_bytes.size() * 8 + m_numPendingBits);
+	}
+
+	const Array<uint8>& PackedWriter::finish()
+	{
+		const size_t numBytes = ((m_numPendingBits + 7) / 8);
+
+		for (size_t i = 0; i < numBytes; ++i)
+		{
+			m_bytes << static_cast<uint8>(m_pendingBits >> (i * 8));
+		}
+
+		m_pendingBits = 0;
+		m_numPendingBits = 0;
+
+		return m_bytes;
+	}
+
+	PackedReader::PackedReader(const void* data, const size_t size) noexcept
+		: m_data{ static_cast<const uint8*>(data) }
+		, m_size{ size } {}
+
+	uint64 PackedReader::readBits(const uint32 numBits)
+	{
+		assert(numBits <= 64);
+
+		if (numBits == 0)
+		{
+			return 0;
+		}
+
+		if (num_remainingBits() < numBits)
+		{
+			setError();
+			return 0;
+		}
+
+		// 1 回の 8 バイトの読み込みで得られるのは 57 ビットまで
+		if (57 < numBits)
+		{
+			const uint64 low = readBits(32);
+			return (low | (readBits(numBits - 32) << 32));
+		}
+
+		const size_t byteIndex = (m_bitPos / 8);
+		uint64 word = 0;
+		std::memcpy(&word, (m_data + byteIndex), Min<size_t>(sizeof(uint64), (m_size - byteIndex)));
+
+		const uint64 value = ((word >> (m_bitPos % 8)) & LowBitMask(numBits));
+		m_bitPos += numBits;
+		return value;
+	}
+
+	uint64 PackedReader::readVarint()
+	{
+		uint64 value = 0;
+
+		for (uint32 shift = 0; shift < 64; shift += 7)
+		{
+			const uint64 group = readBits(8);
+			value |= ((group & 0x7F) << shift);
+
+			if ((group & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+
+		// 10 グループを超える値は書き込まれないので、不正なデータ
+		setError();
+		return 0;
+	}
+
+	bool PackedReader::readBytes(void* data, const size_t size)
+	{
+		if ((num_remainingBits() / 8) < size)
+		{
+			setError();
+			return false;
+		}
+
+		uint8* p = static_cast<uint8*>(data);
+
+		// バイト境界にある場合はまとめてコピーする
+		if ((m_bitPos % 8) == 0)
+		{
+			std::memcpy(p, (m_data + (m_bitPos / 8)), size);
+			m_bitPos += (size * 8);
+			return true;
+		}
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			p[i] = static_cast<uint8>(readBits(8));
+		}
+
+		return true;
+	}
+
+	const uint8* PackedReader::readAlignedBytes(const size_t size)
+	{
+		const size_t bytePos = ((m_bitPos + 7) / 8);
+
+		if ((m_size - bytePos) < size)
+		{
+			setError();
+			return nullptr;
+		}
+
+		m_bitPos = ((bytePos + size) * 8);
+		return (m_data + bytePos);
+	}
+
+	size_t PackedReader::num_remainingBits() const noexcept
+	{
+		return (m_size * 8 - m_bitPos);
+	}
+
+	bool PackedReader::hasError() const noexcept
+	{
+		return m_error;
+	}
+
+	void PackedReader::setError() noexcept
+	{
+		m_error = true;
+		m_bitPos = (m_size * 8);
+	}
+}
@@ -0,0 +1,890 @@
+﻿//-----------------------------------------------
+//	PackedArchive: 値をビット単位で詰めて書き込み・読み出す
+//-----------------------------------------------
+
+# pragma once
+# include <bit>
+# include <Siv3D.hpp>
+
+namespace s3d
+{
+	class PackedWriter;
+
+	class PackedReader;
+
+	namespace detail
+	{
+		template <class Type>
+		inline constexpr bool PackedAlwaysFalse = false;
+
+		/// @brief 0 から maxValue までの値を表すのに必要なビット数を返します。
+		[[nodiscard]]
+		constexpr uint32 PackedBitWidth(uint64 maxValue) noexcept
+		{
+			uint32 numBits = 0;
+
+			while (maxValue)
+			{
+				++numBits;
+				maxValue >>= 1;
+			}
+
+			return numBits;
+		}
+
+		/// @brief minValue から maxValue までを precision 刻みで量子化したときの最大の段階を返します。
+		[[nodiscard]]
+		constexpr uint64 PackedQuantizeSteps(const double minValue, const double maxValue, const double precision) noexcept
+		{
+			const double steps = ((maxValue - minValue) / precision);
+			const uint64 result = static_cast<uint64>(steps);
+			return ((static_cast<double>(result) < steps) ? (result + 1) : result);
+		}
+
+		/// @brief 0 以上の値を、最も近い整数に丸めます。ちょうど中間の場合は偶数に丸めます（既定の丸めモードの std::nearbyint() と同じ）
+		[[nodiscard]]
+		constexpr uint64 RoundHalfToEven(const double x) noexcept
+		{
+			const uint64 integer = static_cast<uint64>(x);
+			const double fraction = (x - static_cast<double>(integer));
+			return (((0.5 < fraction) || ((fraction == 0.5) && (integer & 1))) ? (integer + 1) : integer);
+		}
+
+		[[nodiscard]]
+		constexpr uint64 ZigZagEncode(const int64 value) noexcept
+		{
+			return ((static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63));
+		}
+
+		[[nodiscard]]
+		constexpr int64 ZigZagDecode(const uint64 value) noexcept
+		{
+			return static_cast<int64>((value >> 1) ^ (~(value & 1) + 1));
+		}
+
+		template <class Type>
+		struct IsPackedArray : std::false_type {};
+
+		template <class Type, class Allocator>
+		struct IsPackedArray<Array<Type, Allocator>> : std::true_type {};
+
+		template <class Type>
+		struct IsPackedOptional : std::false_type {};
+
+		template <class Type>
+		struct IsPackedOptional<Optional<Type>> : std::true_type {};
+
+		/// @brief 範囲や精度を指定するラッパー（Packed::Quantize() など）
+		template <class Type>
+		concept PackedWrapper = requires (const Type& value, PackedWriter& writer, PackedReader& reader)
+		{
+			value.writePacked(writer);
+			value.readPacked(reader);
+		};
+
+		/// @brief SIV3D_SERIALIZE メンバ関数を持つユーザ定義型
+		template <class Type>
+		concept PackedSerializable = requires (Type& value, PackedWriter& writer)
+		{
+			value.SIV3D_SERIALIZE(writer);
+		};
+
+		template <class Type>
+		inline constexpr bool IsPackedVector = (std::is_same_v<Type, Vec2> || std::is_same_v<Type, Float2> || std::is_same_v<Type, Vec3> || std::is_same_v<Type, Float3>);
+
+		// 配列はメモリ上の表現をそのままコピーするので、リトルエンディアンの環境でのみ使える
+		static_assert(std::endian::native == std::endian::little, "PackedArchive copies arrays as little-endian bytes");
+
+		/// @brief Array の要素のうち、リトルエンディアンのバイト列としてまとめてコピーする型
+		template <class Type>
+		inline constexpr bool IsPackedBulk = ((std::is_arithmetic_v<Type> && (not std::is_same_v<Type, bool>))
+			|| IsPackedVector<Type> || std::is_same_v<Type, Point> || std::is_same_v<Type, Color>);
+
+		/// @brief 浮動小数点数またはベクトルを、浮動小数点数の成分の並びとして扱うための情報
+		template <class Type>
+		struct PackedComponents
+		{
+			using value_type = Type;
+
+			static constexpr size_t Dimension = 1;
+		};
+
+		template <class Type>
+			requires IsPackedVector<Type>
+		struct PackedComponents<Type>
+		{
+			using value_type = typename Type::value_type;
+
+			static constexpr size_t Dimension = Type::Dimension;
+
+			static_assert((sizeof(Type) == (sizeof(value_type) * Dimension)), "vector components must be tightly packed");
+		};
+
+		template <class Type>
+		inline constexpr bool IsPackedFloatComponents = (std::is_floating_point_v<Type> || IsPackedVector<Type>);
+
+		/// @brief 浮動小数点数の配列を固定長の整数に量子化するときのパラメータ
+		struct FixedQuantization
+		{
+			double minValue = 0.0;
+
+			double maxValue = 0.0;
+
+			double precision = 0.0;
+
+			/// @brief 量子化した値の最大値
+			uint64 maxStep = 0;
+
+			/// @brief 量子化した 1 つの値のバイト数（1, 2, 4 のいずれか）
+			uint32 byteWidth = 0;
+		};
+
+		/// @brief count 個の値を量子化して、それぞれ q.byteWidth バイトのリトルエンディアンの整数として dst に書き込みます。
+		void QuantizeFixed(const float* src, size_t count, const FixedQuantization& q, uint8* dst);
+
+		void QuantizeFixed(const double* src, size_t count, const FixedQuantization& q, uint8* dst);
+
+		/// @brief QuantizeFixed() で書き込んだ count 個の値を dst に復元します。
+		void DequantizeFixed(const uint8* src, size_t count, const FixedQuantization& q, float* dst);
+
+		void DequantizeFixed(const uint8* src, size_t count, const FixedQuantization& q, double* dst);
+
+		/// @brief count 個の値を半精度浮動小数点数（最近接偶数への丸め）に変換して、リトルエンディアンで dst に書き込みます。
+		void EncodeHalf(const float* src, size_t count, uint8* dst);
+
+		void EncodeHalf(const double* src, size_t count, uint8* dst);
+
+		/// @brief EncodeHalf() で書き込んだ count 個の値を dst に復元します。
+		void DecodeHalf(const uint8* src, size_t count, float* dst);
+
+		void DecodeHalf(const uint8* src, size_t count, double* dst);
+	}
+
+	/// @brief 値をビット単位で詰めて書き込むアーカイブ
+	/// @remark SIV3D_SERIALIZE メンバ関数を持つ型は、メンバ関数の Archive としてこのクラスが渡されます。
+	/// @remark bool は 1 ビット、1 バイトの整数はそのまま、それより大きい整数は可変長（符号付きは ZigZag 符号化）、文字列は UTF-8 で書き込みます。
+	/// @remark Packed::Quantize() や Packed::Range() で範囲を指定した値は、範囲に必要なビット数だけで書き込みます。ビット数はコンパイル時に決まります。
+	/// @remark 算術型、Vec2, Float2, Vec3, Float3, Point, Color の Array は、バイト境界に揃えてからまとめてコピーします。
+	class PackedWriter
+	{
+	public:
+
+		SIV3D_NODISCARD_CXX20
+		PackedWriter() = default;
+
+		/// @brief 書き込んだデータを消去します。
+		void clear() noexcept;
+
+		/// @brief 値を順番に書き込みます。
+		/// @param args 書き込む値
+		/// @return *this
+		template <class... Args>
+		PackedWriter& operator()(const Args&... args);
+
+		/// @brief 値の下位のビットを書き込みます。
+		/// @param value 値
+		/// @param numBits ビット数（64 以下）
+		void writeBits(uint64 value, uint32 numBits);
+
+		/// @brief 符号なし整数を、7 ビットごとに続きがあるかを示す 1 ビットを付けた可変長で書き込みます。
+		/// @param value 値
+		void writeVarint(uint64 value);
+
+		/// @brief バイト列を書き込みます。
+		/// @param data バイト列の先頭
+		/// @param size バイト数
+		void writeBytes(const void* data, size_t size);
+
+		/// @brief バイト境界に揃えてから、末尾に size バイトの領域を追加します。
+		/// @param size バイト数
+		/// @return 追加した領域の先頭。次に書き込むまで有効です
+		[[nodiscard]]
+		uint8* appendAlignedBytes(size_t size);
+
+		/// @brief 書き込んだビット数を返します。
+		/// @return 書き込んだビット数
+		[[nodiscard]]
+		size_t num_bits() const noexcept;
+
+		/// @brief 最後のバイトの余ったビットを 0 で埋めて、書き込んだデータを返します。
+		/// @return 書き込んだデータ
+		/// @remark この後に書き込んだ値は、次のバイトの先頭から書き込まれます。
+		[[nodiscard]]
+		const Array<uint8>& finish();
+
+	private:
+
+		Array<uint8> m_bytes;
+
+		/// @brief まだ m_bytes に移していないビット
+		uint64 m_pendingBits = 0;
+
+		uint32 m_numPendingBits = 0;
+
+		template <class Type>
+		void write(const Type& value);
+	};
+
+	/// @brief PackedWriter で書き込んだデータを読み出すアーカイブ
+	/// @remark データが足りない場合や不正な場合は hasError() が true になり、以降は 0 や空の値が読み出されます。
+	class PackedReader
+	{
+	public:
+
+		/// @param data データの先頭
+		/// @param size データのバイト数
+		SIV3D_NODISCARD_CXX20
+		PackedReader(const void* data, size_t size) noexcept;
+
+		/// @brief 値を順番に読み出します。
+		/// @param args 読み出した値を格納する変数
+		/// @return *this
+		template <class... Args>
+		PackedReader& operator()(Args&&... args);
+
+		/// @brief ビットを読み出します。
+		/// @param numBits ビット数（64 以下）
+		/// @return 読み出した値
+		[[nodiscard]]
+		uint64 readBits(uint32 numBits);
+
+		/// @brief PackedWriter::writeVarint() で書き込んだ整数を読み出します。
+		/// @return 読み出した値
+		[[nodiscard]]
+		uint64 readVarint();
+
+		/// @brief バイト列を読み出します。
+		/// @param data 読み出したバイト列を格納する先
+		/// @param size バイト数
+		/// @return 読み出せた場合 true, それ以外の場合は false
+		bool readBytes(void* data, size_t size);
+
+		/// @brief バイト境界に揃えてから、size バイトを読み出します。
+		/// @param size バイト数
+		/// @return 読み出したバイト列の先頭。データが足りない場合は nullptr
+		[[nodiscard]]
+		const uint8* readAlignedBytes(size_t size);
+
+		/// @brief 読み出していない残りのビット数を返します。
+		/// @return 残りのビット数
+		[[nodiscard]]
+		size_t num_remainingBits() const noexcept;
+
+		/// @brief データが足りなかった、または不正だったかを返します。
+		/// @return データが足りなかった、または不正だった場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool hasError() const noexcept;
+
+		/// @brief データが不正であることを記録します。以降は 0 や空の値が読み出されます。
+		void setError() noexcept;
+
+	private:
+
+		const uint8* m_data = nullptr;
+
+		size_t m_size = 0;
+
+		size_t m_bitPos = 0;
+
+		bool m_error = false;
+
+		template <class Type>
+		void read(Type& value);
+	};
+
+	/// @brief PackedWriter / PackedReader で範囲や精度を指定するラッパー
+	/// @remark SIV3D_SERIALIZE メンバ関数の中で archive(Packed::Range<0, 4095>(pos)) のように使います。
+	/// @remark PackedWriter 以外のアーカイブ（Serializer など）では、ラッパーは何もせずに元の値をそのまま書き込みます。
+	namespace Packed
+	{
+		/// @brief MinValue から MaxValue までの浮動小数点数（またはベクトルの各成分）を Precision 刻みで量子化する値への参照
+		template <double MinValue, double MaxValue, double Precision, class Type>
+		struct QuantizedRef
+		{
+			static_assert((MinValue < MaxValue), "Packed::Quantize() requires MinValue < MaxValue");
+
+			static_assert((0.0 < Precision), "Packed::Quantize() requires 0 < Precision");
+
+			/// @brief 量子化した値の最大値
+			static constexpr uint64 MaxStep = detail::PackedQuantizeSteps(MinValue, MaxValue, Precision);
+
+			/// @brief 1 つの成分を書き込むビット数
+			static constexpr uint32 NumBits = detail::PackedBitWidth(MaxStep);
+
+			static_assert((NumBits <= 32), "Packed::Quantize() requires (MaxValue - MinValue) / Precision < 2^32");
+
+			/// @brief 配列の 1 つの成分を書き込むバイト数
+			static constexpr detail::FixedQuantization Fixed{ MinValue, MaxValue, Precision, MaxStep, ((NumBits <= 8) ? 1u : ((NumBits <= 16) ? 2u : 4u)) };
+
+			Type& value;
+
+			template <class Archive>
+			void SIV3D_SERIALIZE(Archive& archive)
+			{
+				archive(value);
+			}
+
+			void writePacked(PackedWriter& writer) const;
+
+			void readPacked(PackedReader& reader) const;
+
+			[[nodiscard]]
+			static constexpr uint64 Encode(const double x) noexcept
+			{
+				// NaN は MinValue として扱う
+				const double clamped = ((not (MinValue < x)) ? MinValue : ((MaxValue < x) ? MaxValue : x));
+				// 配列をまとめて量子化する場合と同じく、中間の値は偶数に丸める
+				const uint64 step = detail::RoundHalfToEven((clamped - MinValue) * (1.0 / Precision));
+				return ((MaxStep < step) ? MaxStep : step);
+			}
+
+			[[nodiscard]]
+			static constexpr double Decode(const uint64 step) noexcept
+			{
+				const double x = (MinValue + static_cast<double>(step) * Precision);
+				return ((MaxValue < x) ? MaxValue : x);
+			}
+		};
+
+		/// @brief MinValue から MaxValue までの整数（または Point の各成分）への参照
+		template <int64 MinValue, int64 MaxValue, class Type>
+		struct RangedRef
+		{
+			static_assert((MinValue < MaxValue), "Packed::Range() requires MinValue < MaxValue");
+
+			/// @brief 1 つの成分を書き込むビット数
+			static constexpr uint32 NumBits = detail::PackedBitWidth(static_cast<uint64>(MaxValue) - static_cast<uint64>(MinValue));
+
+			Type& value;
+
+			template <class Archive>
+			void SIV3D_SERIALIZE(Archive& archive)
+			{
+				archive(value);
+			}
+
+			void writePacked(PackedWriter& writer) const;
+
+			void readPacked(PackedReader& reader) const;
+
+			[[nodiscard]]
+			static constexpr uint64 Encode(const int64 x) noexcept
+			{
+				const int64 clamped = ((x < MinValue) ? MinValue : ((MaxValue < x) ? MaxValue : x));
+				return (static_cast<uint64>(clamped) - static_cast<uint64>(MinValue));
+			}
+
+			[[nodiscard]]
+			static constexpr int64 Decode(const uint64 step) noexcept
+			{
+				const int64 x = static_cast<int64>(static_cast<uint64>(MinValue) + step);
+				return ((MaxValue < x) ? MaxValue : x);
+			}
+		};
+
+		/// @brief 半精度浮動小数点数に変換する値への参照
+		template <class Type>
+		struct HalfRef
+		{
+			Type& value;
+
+			template <class Archive>
+			void SIV3D_SERIALIZE(Archive& archive)
+			{
+				archive(value);
+			}
+
+			void writePacked(PackedWriter& writer) const;
+
+			void readPacked(PackedReader& reader) const;
+		};
+
+		/// @brief 浮動小数点数（float, double）またはベクトル（Vec2, Float2, Vec3, Float3）を、範囲と精度を指定して量子化します。
+		/// @tparam MinValue 最小値
+		/// @tparam MaxValue 最大値
+		/// @tparam Precision 精度
+		/// @param value 値
+		/// @return 量子化する値への参照
+		/// @remark 範囲外の値は範囲内に丸められます。
+		/// @remark これらの型の Array も指定できます。配列は各成分を 1, 2, 4 バイトのいずれかの整数にまとめて量子化します。
+		template <double MinValue, double MaxValue, double Precision, class Type>
+		[[nodiscard]]
+		constexpr QuantizedRef<MinValue, MaxValue, Precision, Type> Quantize(Type& value) noexcept
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				static_assert(detail::IsPackedFloatComponents<typename Type::value_type>, "Packed::Quantize() supports Array of float, double, Vec2, Float2, Vec3 and Float3");
+			}
+			else
+			{
+				static_assert(detail::IsPackedFloatComponents<Type>, "Packed::Quantize() supports float, double, Vec2, Float2, Vec3 and Float3");
+			}
+
+			return{ value };
+		}
+
+		/// @brief 浮動小数点数（float, double）またはベクトル（Vec2, Float2, Vec3, Float3）、およびそれらの Array を、成分ごとに半精度浮動小数点数に変換して書き込みます。
+		/// @param value 値
+		/// @return 半精度浮動小数点数に変換する値への参照
+		/// @remark 範囲を決められない値を 16 ビットにする場合に使います。有効数字は約 3 桁で、絶対値が 65504 を超える値は無限大になります。
+		template <class Type>
+		[[nodiscard]]
+		constexpr HalfRef<Type> Half(Type& value) noexcept
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				static_assert(detail::IsPackedFloatComponents<typename Type::value_type>, "Packed::Half() supports Array of float, double, Vec2, Float2, Vec3 and Float3");
+			}
+			else
+			{
+				static_assert(detail::IsPackedFloatComponents<Type>, "Packed::Half() supports float, double, Vec2, Float2, Vec3 and Float3");
+			}
+
+			return{ value };
+		}
+
+		/// @brief 整数または Point を、範囲を指定して書き込みます。
+		/// @tparam MinValue 最小値
+		/// @tparam MaxValue 最大値
+		/// @param value 値
+		/// @return 範囲を指定した値への参照
+		/// @remark 範囲外の値は範囲内に丸められます。
+		template <int64 MinValue, int64 MaxValue, class Type>
+		[[nodiscard]]
+		constexpr RangedRef<MinValue, MaxValue, Type> Range(Type& value) noexcept
+		{
+			static_assert((std::is_integral_v<Type> || std::is_same_v<Type, Point>), "Packed::Range() supports integers and Point");
+			return{ value };
+		}
+	}
+
+	template <class... Args>
+	PackedWriter& PackedWriter::operator()(const Args&... args)
+	{
+		(write(args), ...);
+		return *this;
+	}
+
+	template <class Type>
+	void PackedWriter::write(const Type& value)
+	{
+		if constexpr (detail::PackedWrapper<Type>)
+		{
+			value.writePacked(*this);
+		}
+		else if constexpr (std::is_same_v<Type, bool>)
+		{
+			writeBits(value, 1);
+		}
+		else if constexpr (std::is_enum_v<Type>)
+		{
+			write(static_cast<std::underlying_type_t<Type>>(value));
+		}
+		else if constexpr (std::is_integral_v<Type>)
+		{
+			if constexpr (sizeof(Type) == 1)
+			{
+				writeBits(static_cast<uint8>(value), 8);
+			}
+			else if constexpr (std::is_signed_v<Type>)
+			{
+				writeVarint(detail::ZigZagEncode(value));
+			}
+			else
+			{
+				writeVarint(value);
+			}
+		}
+		else if constexpr (std::is_same_v<Type, float>)
+		{
+			writeBits(std::bit_cast<uint32>(value), 32);
+		}
+		else if constexpr (std::is_same_v<Type, double>)
+		{
+			writeBits(std::bit_cast<uint64>(value), 64);
+		}
+		else if constexpr (std::is_same_v<Type, Point>)
+		{
+			write(value.x);
+			write(value.y);
+		}
+		else if constexpr (detail::IsPackedVector<Type>)
+		{
+			write(value.x);
+			write(value.y);
+
+			if constexpr (Type::Dimension == 3)
+			{
+				write(value.z);
+			}
+		}
+		else if constexpr (std::is_same_v<Type, Color>)
+		{
+			writeBits((value.r | (value.g << 8) | (value.b << 16) | (static_cast<uint32>(value.a) << 24)), 32);
+		}
+		else if constexpr (std::is_same_v<Type, String>)
+		{
+			const std::string utf8 = value.toUTF8();
+			writeVarint(utf8.size());
+			writeBytes(utf8.data(), utf8.size());
+		}
+		else if constexpr (detail::IsPackedArray<Type>::value)
+		{
+			writeVarint(value.size());
+
+			if constexpr (detail::IsPackedBulk<typename Type::value_type>)
+			{
+				if (const size_t size = (value.size() * sizeof(typename Type::value_type)))
+				{
+					std::memcpy(appendAlignedBytes(size), value.data(), size);
+				}
+			}
+			else
+			{
+				for (const auto& element : value)
+				{
+					write(element);
+				}
+			}
+		}
+		else if constexpr (detail::IsPackedOptional<Type>::value)
+		{
+			writeBits(value.has_value(), 1);
+
+			if (value)
+			{
+				write(*value);
+			}
+		}
+		else if constexpr (detail::PackedSerializable<Type>)
+		{
+			const_cast<Type&>(value).SIV3D_SERIALIZE(*this);
+		}
+		else
+		{
+			static_assert(detail::PackedAlwaysFalse<Type>, "PackedWriter does not support this type");
+		}
+	}
+
+	template <class... Args>
+	PackedReader& PackedReader::operator()(Args&&... args)
+	{
+		(read(args), ...);
+		return *this;
+	}
+
+	template <class Type>
+	void PackedReader::read(Type& value)
+	{
+		if constexpr (detail::PackedWrapper<Type>)
+		{
+			value.readPacked(*this);
+		}
+		else if constexpr (std::is_same_v<Type, bool>)
+		{
+			value = (readBits(1) != 0);
+		}
+		else if constexpr (std::is_enum_v<Type>)
+		{
+			std::underlying_type_t<Type> underlying{};
+			read(underlying);
+			value = static_cast<Type>(underlying);
+		}
+		else if constexpr (std::is_integral_v<Type>)
+		{
+			if constexpr (sizeof(Type) == 1)
+			{
+				value = static_cast<Type>(readBits(8));
+			}
+			else if constexpr (std::is_signed_v<Type>)
+			{
+				value = static_cast<Type>(detail::ZigZagDecode(readVarint()));
+			}
+			else
+			{
+				value = static_cast<Type>(readVarint());
+			}
+		}
+		else if constexpr (std::is_same_v<Type, float>)
+		{
+			value = std::bit_cast<float>(static_cast<uint32>(readBits(32)));
+		}
+		else if constexpr (std::is_same_v<Type, double>)
+		{
+			value = std::bit_cast<double>(readBits(64));
+		}
+		else if constexpr (std::is_same_v<Type, Point>)
+		{
+			read(value.x);
+			read(value.y);
+		}
+		else if constexpr (detail::IsPackedVector<Type>)
+		{
+			read(value.x);
+			read(value.y);
+
+			if constexpr (Type::Dimension == 3)
+			{
+				read(value.z);
+			}
+		}
+		else if constexpr (std::is_same_v<Type, Color>)
+		{
+			const uint32 rgba = static_cast<uint32>(readBits(32));
+			value = Color{ static_cast<uint8>(rgba), static_cast<uint8>(rgba >> 8), static_cast<uint8>(rgba >> 16), static_cast<uint8>(rgba >> 24) };
+		}
+		else if constexpr (std::is_same_v<Type, String>)
+		{
+			const uint64 size = readVarint();
+
+			if ((num_remainingBits() / 8) < size)
+			{
+				setError();
+				value.clear();
+				return;
+			}
+
+			std::string utf8(static_cast<size_t>(size), '\0');
+			readBytes(utf8.data(), utf8.size());
+			value = Unicode::FromUTF8(utf8);
+		}
+		else if constexpr (detail::IsPackedArray<Type>::value)
+		{
+			const uint64 size = readVarint();
+
+			// 不正なデータで巨大な配列を確保しないように、残りのビット数を上限にする
+			if (num_remainingBits() < size)
+			{
+				setError();
+				value.clear();
+				return;
+			}
+
+			if constexpr (detail::IsPackedBulk<typename Type::value_type>)
+			{
+				using value_type = typename Type::value_type;
+
+				if ((num_remainingBits() / 8 / sizeof(value_type)) < size)
+				{
+					setError();
+					value.clear();
+					return;
+				}
+
+				value.resize(static_cast<size_t>(size));
+
+				// 空の配列は書き込むときにバイト境界に揃えていない
+				if (value.isEmpty())
+				{
+					return;
+				}
+
+				if (const uint8* bytes = readAlignedBytes(value.size() * sizeof(value_type)))
+				{
+					std::memcpy(value.data(), bytes, (value.size() * sizeof(value_type)));
+				}
+			}
+			else
+			{
+				value.resize(static_cast<size_t>(size));
+
+				for (auto& element : value)
+				{
+					read(element);
+				}
+			}
+		}
+		else if constexpr (detail::IsPackedOptional<Type>::value)
+		{
+			if (readBits(1))
+			{
+				typename Type::value_type element{};
+				read(element);
+				value = std::move(element);
+			}
+			else
+			{
+				value.reset();
+			}
+		}
+		else if constexpr (detail::PackedSerializable<Type>)
+		{
+			value.SIV3D_SERIALIZE(*this);
+		}
+		else
+		{
+			static_assert(detail::PackedAlwaysFalse<Type>, "PackedReader does not support this type");
+		}
+	}
+
+	namespace Packed
+	{
+		template <double MinValue, double MaxValue, double Precision, class Type>
+		void QuantizedRef<MinValue, MaxValue, Precision, Type>::writePacked(PackedWriter& writer) const
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				using Components = detail::PackedComponents<typename Type::value_type>;
+				const size_t count = (value.size() * Components::Dimension);
+
+				writer.writeVarint(value.size());
+
+				if (count)
+				{
+					detail::QuantizeFixed(reinterpret_cast<const typename Components::value_type*>(value.data()), count, Fixed, writer.appendAlignedBytes(count * Fixed.byteWidth));
+				}
+			}
+			else if constexpr (std::is_floating_point_v<Type>)
+			{
+				writer.writeBits(Encode(value), NumBits);
+			}
+			else
+			{
+				writer.writeBits(Encode(value.x), NumBits);
+				writer.writeBits(Encode(value.y), NumBits);
+
+				if constexpr (Type::Dimension == 3)
+				{
+					writer.writeBits(Encode(value.z), NumBits);
+				}
+			}
+		}
+
+		template <double MinValue, double MaxValue, double Precision, class Type>
+		void QuantizedRef<MinValue, MaxValue, Precision, Type>::readPacked(PackedReader& reader) const
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				using Components = detail::PackedComponents<typename Type::value_type>;
+				const uint64 size = reader.readVarint();
+
+				if (((reader.num_remainingBits() / 8 / Fixed.byteWidth) / Components::Dimension) < size)
+				{
+					reader.setError();
+					value.clear();
+					return;
+				}
+
+				value.resize(static_cast<size_t>(size));
+				const size_t count = (value.size() * Components::Dimension);
+
+				if (count == 0)
+				{
+					return;
+				}
+
+				if (const uint8* bytes = reader.readAlignedBytes(count * Fixed.byteWidth))
+				{
+					detail::DequantizeFixed(bytes, count, Fixed, reinterpret_cast<typename Components::value_type*>(value.data()));
+				}
+			}
+			else if constexpr (std::is_floating_point_v<Type>)
+			{
+				value = static_cast<Type>(Decode(reader.readBits(NumBits)));
+			}
+			else
+			{
+				using value_type = typename Type::value_type;
+				value.x = static_cast<value_type>(Decode(reader.readBits(NumBits)));
+				value.y = static_cast<value_type>(Decode(reader.readBits(NumBits)));
+
+				if constexpr (Type::Dimension == 3)
+				{
+					value.z = static_cast<value_type>(Decode(reader.readBits(NumBits)));
+				}
+			}
+		}
+
+		template <int64 MinValue, int64 MaxValue, class Type>
+		void RangedRef<MinValue, MaxValue, Type>::writePacked(PackedWriter& writer) const
+		{
+			if constexpr (std::is_same_v<Type, Point>)
+			{
+				writer.writeBits(Encode(value.x), NumBits);
+				writer.writeBits(Encode(value.y), NumBits);
+			}
+			else
+			{
+				writer.writeBits(Encode(static_cast<int64>(value)), NumBits);
+			}
+		}
+
+		template <int64 MinValue, int64 MaxValue, class Type>
+		void RangedRef<MinValue, MaxValue, Type>::readPacked(PackedReader& reader) const
+		{
+			if constexpr (std::is_same_v<Type, Point>)
+			{
+				value.x = static_cast<Point::value_type>(Decode(reader.readBits(NumBits)));
+				value.y = static_cast<Point::value_type>(Decode(reader.readBits(NumBits)));
+			}
+			else
+			{
+				value = static_cast<Type>(Decode(reader.readBits(NumBits)));
+			}
+		}
+
+		template <class Type>
+		void HalfRef<Type>::writePacked(PackedWriter& writer) const
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				using Components = detail::PackedComponents<typename Type::value_type>;
+				const size_t count = (value.size() * Components::Dimension);
+
+				writer.writeVarint(value.size());
+
+				if (count)
+				{
+					detail::EncodeHalf(reinterpret_cast<const typename Components::value_type*>(value.data()), count, writer.appendAlignedBytes(count * sizeof(uint16)));
+				}
+			}
+			else
+			{
+				using Components = detail::PackedComponents<Type>;
+				uint8 bytes[sizeof(uint16) * Components::Dimension];
+				detail::EncodeHalf(reinterpret_cast<const typename Components::value_type*>(&value), Components::Dimension, bytes);
+				writer.writeBytes(bytes, sizeof(bytes));
+			}
+		}
+
+		template <class Type>
+		void HalfRef<Type>::readPacked(PackedReader& reader) const
+		{
+			if constexpr (detail::IsPackedArray<Type>::value)
+			{
+				using Components = detail::PackedComponents<typename Type::value_type>;
+				const uint64 size = reader.readVarint();
+
+				if (((reader.num_remainingBits() / 8 / sizeof(uint16)) / Components::Dimension) < size)
+				{
+					reader.setError();
+					value.clear();
+					return;
+				}
+
+				value.resize(static_cast<size_t>(size));
+				const size_t count = (value.size() * Components::Dimension);
+
+				if (count == 0)
+				{
+					return;
+				}
+
+				if (const uint8* bytes = reader.readAlignedBytes(count * sizeof(uint16)))
+				{
+					detail::DecodeHalf(bytes, count, reinterpret_cast<typename Components::value_type*>(value.data()));
+				}
+			}
+			else
+			{
+				using Components = detail::PackedComponents<Type>;
+				uint8 bytes[sizeof(uint16) * Components::Dimension]{};
+
+				if (reader.readBytes(bytes, sizeof(bytes)))
+				{
+					detail::DecodeHalf(bytes, Components::Dimension, reinterpret_cast<typename Components::value_type*>(&value));
+				}
+			}
+		}
+	}
+}
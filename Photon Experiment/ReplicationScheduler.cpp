@@ -0,0 +1,282 @@
+﻿//-----------------------------------------------
+//	ReplicationScheduler: 送信量の上限の中で、優先度の高いエンティティから状態を送信する
+//-----------------------------------------------
+
+# include "ReplicationScheduler.hpp"
+
+namespace s3d
+{
+	namespace
+	{
+		/// @brief 追加された直後や markUrgent() されたエンティティの優先度
+		constexpr double UrgentPriority = 1e9;
+
+		/// @brief 見積もりより大きな状態のエンティティがあっても上限まで使えるように、候補を多めに選ぶ割合
+		constexpr double CandidateMargin = 1.5;
+	}
+
+	ReplicationScheduler::ReplicationScheduler(const MultiplayerEvent& event, const size_t bytesPerUpdate)
+		: m_event{ event }
+		, m_bytesPerUpdate{ bytesPerUpdate } {}
+
+	void ReplicationScheduler::add(const EntityID id)
+	{
+		if (m_indices.contains(id))
+		{
+			return;
+		}
+
+		m_indices.emplace(id, m_entities.size());
+		m_entities << Entity{ .id = id, .priority = UrgentPriority };
+	}
+
+	void ReplicationScheduler::remove(const EntityID id)
+	{
+		const auto it = m_indices.find(id);
+
+		if (it == m_indices.end())
+		{
+			return;
+		}
+
+		const size_t index = it->second;
+		m_indices.erase(it);
+
+		if (index != (m_entities.size() - 1))
+		{
+			m_entities[index] = m_entities.back();
+			m_indices[m_entities[index].id] = index;
+		}
+
+		m_entities.pop_back();
+	}
+
+	bool ReplicationScheduler::contains(const EntityID id) const
+	{
+		return m_indices.contains(id);
+	}
+
+	size_t ReplicationScheduler::num_entities() const noexcept
+	{
+		return m_entities.size();
+	}
+
+	void ReplicationScheduler::markUrgent(const EntityID id)
+	{
+		if (const auto it = m_indices.find(id); it != m_indices.end())
+		{
+			m_entities[it->second].priority = Max(m_entities[it->second].priority, UrgentPriority);
+		}
+	}
+
+	void ReplicationScheduler::setRelevanceFunction(RelevanceFunction relevance)
+	{
+		m_relevance = std::move(relevance);
+	}
+
+	void ReplicationScheduler::setBytesPerUpdate(const size_t bytesPerUpdate)
+	{
+		m_bytesPerUpdate = bytesPerUpdate;
+	}
+
+	void ReplicationScheduler::setMaxEventSize(const size_t maxEventSize)
+	{
+		m_maxEventSize = Max<size_t>(maxEventSize, 1);
+	}
+
+	ReplicationStats ReplicationScheduler::update(Multiplayer_Photon& network, const WriteFunction& write)
+	{
+		ReplicationStats stats;
+
+		if (m_entities.isEmpty())
+		{
+			return stats;
+		}
+
+		// 送信されなかった update() ごとに、関連度の分だけ優先度を上げる
+		if (m_relevance)
+		{
+			for (auto& entity : m_entities)
+			{
+				entity.priority += Max(m_relevance(entity.id), 0.0);
+			}
+		}
+		else
+		{
+			for (auto& entity : m_entities)
+			{
+				entity.priority += 1.0;
+			}
+		}
+
+		// 上限に収まりそうな数だけを候補にして、全体を並べ替えずに選ぶ
+		const size_t numEntities = m_entities.size();
+		const size_t numCandidates = Min(numEntities, static_cast<size_t>(m_bytesPerUpdate / Max(m_averageEntitySize, 1.0) * CandidateMargin) + 1);
+
+		m_order.resize(numEntities);
+
+		for (size_t i = 0; i < numEntities; ++i)
+		{
+			m_order[i] = static_cast<uint32>(i);
+		}
+
+		const auto higherPriority = [this](const uint32 a, const uint32 b) { return (m_entities[b].priority < m_entities[a].priority); };
+
+		if (numCandidates < numEntities)
+		{
+			std::nth_element(m_order.begin(), (m_order.begin() + numCandidates), m_order.end(), higherPriority);
+		}
+
+		std::sort(m_order.begin(), (m_order.begin() + numCandidates), higherPriority);
+
+		m_entriesWriter->clear();
+		m_numEntries = 0;
+		size_t entriesSize = sizeof(uint32);
+		size_t totalSize = 0;
+		size_t sizeSum = 0;
+
+		for (size_t i = 0; i < numCandidates; ++i)
+		{
+			Entity& entity = m_entities[m_order[i]];
+
+			m_entityWriter->clear();
+			write(entity.id, m_entityWriter);
+
+			const auto& blob = m_entityWriter->getBlob();
+			const size_t entrySize = (sizeof(EntityID) + sizeof(uint32) + blob.size());
+
+			// 上限を超える場合は次の update() に持ち越す。ただし 1 つも送信できない状態にはしない
+			if ((m_bytesPerUpdate < (totalSize + entrySize)) && (stats.sentEntities != 0))
+			{
+				break;
+			}
+
+			if (m_numEntries && (m_maxEventSize < (entriesSize + entrySize)))
+			{
+				flush(network, stats);
+				entriesSize = sizeof(uint32);
+			}
+
+			m_entriesWriter(entity.id, static_cast<uint32>(blob.size()));
+			m_entriesWriter->write(blob.data(), static_cast<int64>(blob.size()));
+			++m_numEntries;
+
+			entriesSize += entrySize;
+			totalSize += entrySize;
+			sizeSum += blob.size();
+			entity.priority = 0.0;
+			++stats.sentEntities;
+		}
+
+		flush(network, stats);
+
+		if (stats.sentEntities)
+		{
+			m_averageEntitySize = (m_averageEntitySize * 0.75 + (static_cast<double>(sizeSum) / stats.sentEntities) * 0.25);
+		}
+
+		stats.deferredEntities = (numEntities - stats.sentEntities);
+		return stats;
+	}
+
+	ReplicationScheduler::EntityReader::EntityReader(const MemoryViewReader* source, const int64 begin, const int64 size) noexcept
+		: m_source{ source }
+		, m_begin{ begin }
+		, m_size{ size } {}
+
+	bool ReplicationScheduler::EntityReader::supportsLookahead() const noexcept
+	{
+		return true;
+	}
+
+	bool ReplicationScheduler::EntityReader::isOpen() const noexcept
+	{
+		return m_source->isOpen();
+	}
+
+	int64 ReplicationScheduler::EntityReader::size() const
+	{
+		return m_size;
+	}
+
+	int64 ReplicationScheduler::EntityReader::getPos() const
+	{
+		return m_pos;
+	}
+
+	bool ReplicationScheduler::EntityReader::setPos(const int64 pos)
+	{
+		if (not InRange<int64>(pos, 0, m_size))
+		{
+			return false;
+		}
+
+		m_pos = pos;
+		return true;
+	}
+
+	int64 ReplicationScheduler::EntityReader::skip(const int64 offset)
+	{
+		m_pos = Clamp<int64>((m_pos + offset), 0, m_size);
+		return m_pos;
+	}
+
+	int64 ReplicationScheduler::EntityReader::read(void* dst, const int64 size)
+	{
+		const int64 readSize = lookahead(dst, m_pos, size);
+		m_pos += readSize;
+		return readSize;
+	}
+
+	int64 ReplicationScheduler::EntityReader::read(void* dst, const int64 pos, const int64 size)
+	{
+		const int64 readSize = lookahead(dst, pos, size);
+		m_pos = (pos + readSize);
+		return readSize;
+	}
+
+	int64 ReplicationScheduler::EntityReader::lookahead(void* dst, const int64 size) const
+	{
+		return lookahead(dst, m_pos, size);
+	}
+
+	int64 ReplicationScheduler::EntityReader::lookahead(void* dst, const int64 pos, const int64 size) const
+	{
+		if (not InRange<int64>(pos, 0, m_size))
+		{
+			return 0;
+		}
+
+		// 状態の範囲を超えて読み出さない
+		const int64 readSize = Clamp<int64>(size, 0, (m_size - pos));
+
+		if (readSize == 0)
+		{
+			return 0;
+		}
+
+		return m_source->lookahead(dst, (m_begin + pos), readSize);
+	}
+
+	void ReplicationScheduler::flush(Multiplayer_Photon& network, ReplicationStats& stats)
+	{
+		if (m_numEntries == 0)
+		{
+			return;
+		}
+
+		const auto& entries = m_entriesWriter->getBlob();
+
+		m_eventWriter->clear();
+		m_eventWriter(m_numEntries);
+		m_eventWriter->write(entries.data(), static_cast<int64>(entries.size()));
+
+		network.sendEvent(m_event, m_eventWriter);
+
+		stats.sentBytes += m_eventWriter->getBlob().size();
+		++stats.sentEvents;
+
+		m_entriesWriter->clear();
+		m_numEntries = 0;
+	}
+}
@@ -0,0 +1,222 @@
+﻿//-----------------------------------------------
+//	ReplicationScheduler: 送信量の上限の中で、優先度の高いエンティティから状態を送信する
+//-----------------------------------------------
+
+# pragma once
+# include <Siv3D.hpp>
+# include "Multiplayer_Photon.hpp"
+
+namespace s3d
+{
+	/// @brief ReplicationScheduler::update() の結果
+	struct ReplicationStats
+	{
+		/// @brief 送信したエンティティの数
+		size_t sentEntities = 0;
+
+		/// @brief 送信したデータのサイズ（バイト）
+		size_t sentBytes = 0;
+
+		/// @brief 送信したイベントの数
+		size_t sentEvents = 0;
+
+		/// @brief 送信できなかったエンティティの数
+		size_t deferredEntities = 0;
+	};
+
+	/// @brief 帯域が足りないときに、優先度の高いエンティティから決まったバイト数までの状態を送信するスケジューラ
+	/// @remark 各エンティティの優先度は、送信されなかった update() ごとに関連度の分だけ上がり、送信されると 0 に戻ります。
+	/// @remark 選ばれたエンティティの状態は、なるべく少ない数のイベントにまとめて送信されます。受信側では ReadEntities() で読み出します。
+	class ReplicationScheduler
+	{
+	public:
+
+		using EntityID = uint32;
+
+		/// @brief エンティティの状態を書き込む関数
+		using WriteFunction = std::function<void(EntityID, Serializer<MemoryWriter>&)>;
+
+		/// @brief エンティティの関連度（0 以上）を返す関数。距離が近いエンティティほど大きな値を返すなどして使います
+		using RelevanceFunction = std::function<double(EntityID)>;
+
+		/// @param event 状態を送信するイベントの送信オプション
+		/// @param bytesPerUpdate 1 回の update() で送信するデータのサイズの上限（バイト）
+		SIV3D_NODISCARD_CXX20
+		ReplicationScheduler(const MultiplayerEvent& event, size_t bytesPerUpdate);
+
+		/// @brief エンティティを追加します。
+		/// @param id エンティティの ID
+		/// @remark 追加したエンティティは、次の update() で優先的に送信されます。
+		void add(EntityID id);
+
+		/// @brief エンティティを削除します。
+		/// @param id エンティティの ID
+		void remove(EntityID id);
+
+		/// @brief エンティティが追加されているかを返します。
+		/// @param id エンティティの ID
+		/// @return 追加されている場合 true, それ以外の場合は false
+		[[nodiscard]]
+		bool contains(EntityID id) const;
+
+		/// @brief 追加されているエンティティの数を返します。
+		/// @return 追加されているエンティティの数
+		[[nodiscard]]
+		size_t num_entities() const noexcept;
+
+		/// @brief エンティティの優先度を上げて、次の update() で優先的に送信されるようにします。
+		/// @param id エンティティの ID
+		void markUrgent(EntityID id);
+
+		/// @brief エンティティの関連度を返す関数を設定します。設定しない場合、すべてのエンティティの関連度は 1.0 です。
+		/// @param relevance エンティティの関連度を返す関数
+		void setRelevanceFunction(RelevanceFunction relevance);
+
+		/// @brief 1 回の update() で送信するデータのサイズの上限を設定します。
+		/// @param bytesPerUpdate 1 回の update() で送信するデータのサイズの上限（バイト）
+		void setBytesPerUpdate(size_t bytesPerUpdate);
+
+		/// @brief 1 つのイベントにまとめるデータのサイズの上限を設定します。
+		/// @param maxEventSize 1 つのイベントにまとめるデータのサイズの上限（バイト）
+		void setMaxEventSize(size_t maxEventSize);
+
+		/// @brief 優先度を更新し、優先度の高いエンティティから上限まで状態を書き込んで送信します。
+		/// @param network 送信に使う Multiplayer_Photon
+		/// @param write エンティティの状態を書き込む関数
+		/// @return 送信の結果
+		ReplicationStats update(Multiplayer_Photon& network, const WriteFunction& write);
+
+		/// @brief 受信したイベントのデータのうち、1 つのエンティティの状態の範囲だけを読み出すリーダー
+		/// @remark データはコピーせず、元の MemoryViewReader から読み出します。
+		class EntityReader : public IReader
+		{
+		public:
+
+			using IReader::read;
+
+			using IReader::lookahead;
+
+			/// @param source 受信したイベントのデータ。EntityReader より長く有効である必要があります
+			/// @param begin source の中での状態の開始位置
+			/// @param size 状態のサイズ（バイト）
+			SIV3D_NODISCARD_CXX20
+			EntityReader(const MemoryViewReader* source, int64 begin, int64 size) noexcept;
+
+			[[nodiscard]]
+			bool supportsLookahead() const noexcept override;
+
+			[[nodiscard]]
+			bool isOpen() const noexcept override;
+
+			[[nodiscard]]
+			int64 size() const override;
+
+			[[nodiscard]]
+			int64 getPos() const override;
+
+			bool setPos(int64 pos) override;
+
+			int64 skip(int64 offset) override;
+
+			int64 read(void* dst, int64 size) override;
+
+			int64 read(void* dst, int64 pos, int64 size) override;
+
+			int64 lookahead(void* dst, int64 size) const override;
+
+			int64 lookahead(void* dst, int64 pos, int64 size) const override;
+
+		private:
+
+			const MemoryViewReader* m_source = nullptr;
+
+			int64 m_begin = 0;
+
+			int64 m_size = 0;
+
+			int64 m_pos = 0;
+		};
+
+		/// @brief ReplicationScheduler が送信したイベントから、エンティティの状態を読み出します。
+		/// @param reader 受信したイベントのデータ
+		/// @param read エンティティごとに呼ばれる関数。エンティティの ID と、そのエンティティの状態だけを読み出せるデシリアライザ（Deserializer<EntityReader>&）を受け取ります
+		/// @return データが正しい形式であった場合 true, それ以外の場合は false
+		template <class Function>
+		static bool ReadEntities(Deserializer<MemoryViewReader>& reader, Function read);
+
+	private:
+
+		struct Entity
+		{
+			EntityID id = 0;
+
+			double priority = 0.0;
+		};
+
+		MultiplayerEvent m_event;
+
+		size_t m_bytesPerUpdate = 0;
+
+		size_t m_maxEventSize = 1024;
+
+		RelevanceFunction m_relevance;
+
+		/// @brief 削除するときに末尾の要素と入れ替えるので、順番は保たれない
+		Array<Entity> m_entities;
+
+		/// @brief エンティティの ID から m_entities のインデックスへの表
+		HashTable<EntityID, size_t> m_indices;
+
+		/// @brief エンティティの状態のサイズの移動平均。1 回の update() で候補にするエンティティの数の見積もりに使う
+		double m_averageEntitySize = 64.0;
+
+		/// @brief 優先度で並べ替える m_entities のインデックス（容量を使い回す）
+		Array<uint32> m_order;
+
+		/// @brief 1 つのエンティティの状態を書き込む
+		Serializer<MemoryWriter> m_entityWriter;
+
+		/// @brief 1 つのイベントにまとめるエンティティの状態
+		Serializer<MemoryWriter> m_entriesWriter;
+
+		Serializer<MemoryWriter> m_eventWriter;
+
+		/// @brief m_entriesWriter に書き込んだエンティティの数
+		uint32 m_numEntries = 0;
+
+		/// @brief m_entriesWriter に書き込んだエンティティの状態をイベントとして送信します。
+		void flush(Multiplayer_Photon& network, ReplicationStats& stats);
+	};
+
+	template <class Function>
+	bool ReplicationScheduler::ReadEntities(Deserializer<MemoryViewReader>& reader, Function read)
+	{
+		uint32 count = 0;
+		reader(count);
+
+		for (uint32 i = 0; i < count; ++i)
+		{
+			if (reader->size() < (reader->getPos() + static_cast<int64>(sizeof(EntityID) + sizeof(uint32))))
+			{
+				return false;
+			}
+
+			EntityID id = 0;
+			uint32 size = 0;
+			reader(id, size);
+
+			if ((reader->size() - reader->getPos()) < size)
+			{
+				return false;
+			}
+
+			// エンティティごとに読み出せる範囲を、コピーせずに状態の範囲に限る
+			Deserializer<EntityReader> entityReader{ reader.operator->(), reader->getPos(), static_cast<int64>(size) };
+			read(id, entityReader);
+
+			reader->skip(size);
+		}
+
+		return true;
+	}
+}